@@ -22,7 +22,9 @@
 #include <linux/buffer_head.h>
 #include <linux/device.h>
 #include <linux/genhd.h>
+#include <linux/hash.h>
 #include <linux/highmem.h>
+#include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
 #include <linux/string.h>
@@ -38,6 +40,7 @@ static struct ramzswap *devices;
 
 /* Module params (documentation at end) */
 static unsigned int num_devices;
+static int dedup = 1;
 
 static int rzs_test_flag(struct ramzswap *rzs, u32 index,
 			enum rzs_pageflags flag)
@@ -154,18 +157,80 @@ static void ramzswap_ioctl_get_stats(struct ramzswap *rzs,
 	s->orig_data_size = rs->pages_stored << PAGE_SHIFT;
 	s->compr_data_size = rs->compr_size;
 	s->mem_used_total = mem_used;
+	s->memlimit = rzs->memlimit;
+	s->pages_dedup = rs->pages_dedup;
+	s->pages_backed = rs->pages_backed;
 	}
 #endif /* CONFIG_RAMZSWAP_STATS */
 }
 
-static void ramzswap_free_page(struct ramzswap *rzs, size_t index)
+static struct rzs_dedup *rzs_find_dedup(struct ramzswap *rzs, size_t index)
+{
+	struct rzs_dedup *node;
+	struct hlist_node *pos;
+	u32 checksum = rzs->table[index].checksum;
+
+	hlist_for_each_entry(node, pos,
+			&rzs->dedup_hash[hash_32(checksum, dedup_hash_bits)],
+			hash) {
+		if (node->page == rzs->table[index].page &&
+				node->offset == rzs->table[index].offset)
+			return node;
+	}
+
+	return NULL;
+}
+
+/*
+ * Free a compressed object and take it out of the stats.
+ * Called with rzs->lock held.
+ */
+static void ramzswap_free_obj(struct ramzswap *rzs, struct page *page,
+			u32 offset)
 {
 	u32 clen;
 	void *obj;
 
+	obj = kmap_atomic(page, KM_USER0) + offset;
+	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
+	kunmap_atomic(obj, KM_USER0);
+
+	xv_free(rzs->mem_pool, page, offset);
+
+	rzs->mem_used -= xv_get_alloc_size(clen + sizeof(struct zobj_header));
+	rzs->stats.compr_size -= clen;
+	if (clen <= PAGE_SIZE / 2)
+		rzs_stat_dec(&rzs->stats.good_compress);
+}
+
+/*
+ * Drop a reference to a dedup node, freeing the object with the last one.
+ * Called with rzs->lock held.
+ */
+static void rzs_dedup_put(struct ramzswap *rzs, struct rzs_dedup *node)
+{
+	if (--node->refcount)
+		return;
+
+	hlist_del(&node->hash);
+	ramzswap_free_obj(rzs, node->page, node->offset);
+	kfree(node);
+}
+
+/*
+ * Drop whatever is stored at index. Called with rzs->lock held.
+ */
+static void ramzswap_free_page(struct ramzswap *rzs, size_t index)
+{
 	struct page *page = rzs->table[index].page;
 	u32 offset = rzs->table[index].offset;
 
+	if (unlikely(rzs_test_flag(rzs, index, RZS_BACKED))) {
+		rzs_clear_flag(rzs, index, RZS_BACKED);
+		rzs_stat_dec(&rzs->stats.pages_backed);
+		return;
+	}
+
 	if (unlikely(!page)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -179,23 +244,24 @@ static void ramzswap_free_page(struct ramzswap *rzs, size_t index)
 	}
 
 	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED))) {
-		clen = PAGE_SIZE;
 		__free_page(page);
 		rzs_clear_flag(rzs, index, RZS_UNCOMPRESSED);
 		rzs_stat_dec(&rzs->stats.pages_expand);
-		goto out;
+		rzs->mem_used -= PAGE_SIZE;
+		rzs->stats.compr_size -= PAGE_SIZE;
+	} else if (rzs_test_flag(rzs, index, RZS_DEDUP)) {
+		struct rzs_dedup *node = rzs_find_dedup(rzs, index);
+
+		rzs_clear_flag(rzs, index, RZS_DEDUP);
+		BUG_ON(!node);
+		if (node->refcount > 1)
+			/* Object is still used by other pages */
+			rzs_stat_dec(&rzs->stats.pages_dedup);
+		rzs_dedup_put(rzs, node);
+	} else {
+		ramzswap_free_obj(rzs, page, offset);
 	}
 
-	obj = kmap_atomic(page, KM_USER0) + offset;
-	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
-	kunmap_atomic(obj, KM_USER0);
-
-	xv_free(rzs->mem_pool, page, offset);
-	if (clen <= PAGE_SIZE / 2)
-		rzs_stat_dec(&rzs->stats.good_compress);
-
-out:
-	rzs->stats.compr_size -= clen;
 	rzs_stat_dec(&rzs->stats.pages_stored);
 
 	rzs->table[index].page = NULL;
@@ -218,6 +284,10 @@ static int handle_zero_page(struct bio *bio)
 	return 0;
 }
 
+/*
+ * Called with rzs->lock held, so that a concurrent write cannot free
+ * the stored page under us. The lock is dropped once the page is copied.
+ */
 static int handle_uncompressed_page(struct ramzswap *rzs, struct bio *bio)
 {
 	u32 index;
@@ -234,6 +304,7 @@ static int handle_uncompressed_page(struct ramzswap *rzs, struct bio *bio)
 	memcpy(user_mem, cmem, PAGE_SIZE);
 	kunmap_atomic(user_mem, KM_USER0);
 	kunmap_atomic(cmem, KM_USER1);
+	spin_unlock(&rzs->lock);
 
 	flush_dcache_page(page);
 
@@ -246,7 +317,8 @@ static int handle_uncompressed_page(struct ramzswap *rzs, struct bio *bio)
  * Called when request page is not present in ramzswap.
  * This is an attempt to read before any previous write
  * to this location - this happens due to readahead when
- * swap device is read from user-space (e.g. during swapon)
+ * swap device is read from user-space (e.g. during swapon),
+ * or when a filesystem reads a block it never wrote.
  */
 static int handle_ramzswap_fault(struct ramzswap *rzs, struct bio *bio)
 {
@@ -255,19 +327,162 @@ static int handle_ramzswap_fault(struct ramzswap *rzs, struct bio *bio)
 		(ulong)(bio->bi_sector), bio->bi_size,
 		bio->bi_io_vec[0].bv_offset);
 
-	/* Do nothing. Just return success */
-	set_bit(BIO_UPTODATE, &bio->bi_flags);
-	bio_endio(bio, 0);
+	/* Unwritten blocks read back as zeros */
+	return handle_zero_page(bio);
+}
+
+/*
+ * Redirect the bio to the backing device. Sectors map one to one.
+ * Returning non-zero from make_request makes the block layer resubmit it.
+ */
+static int handle_backed_page(struct ramzswap *rzs, struct bio *bio)
+{
+	bio->bi_bdev = rzs->backing_bdev;
+	return 1;
+}
+
+static struct rzs_stream *rzs_stream_get(struct ramzswap *rzs)
+{
+	struct rzs_stream *stream;
+
+	for (;;) {
+		spin_lock(&rzs->streams_lock);
+		if (!list_empty(&rzs->streams)) {
+			stream = list_first_entry(&rzs->streams,
+					struct rzs_stream, list);
+			list_del(&stream->list);
+			spin_unlock(&rzs->streams_lock);
+			return stream;
+		}
+		spin_unlock(&rzs->streams_lock);
+
+		wait_event(rzs->streams_wait, !list_empty(&rzs->streams));
+	}
+}
+
+static void rzs_stream_put(struct ramzswap *rzs, struct rzs_stream *stream)
+{
+	spin_lock(&rzs->streams_lock);
+	list_add(&stream->list, &rzs->streams);
+	spin_unlock(&rzs->streams_lock);
+
+	wake_up(&rzs->streams_wait);
+}
+
+static void rzs_stream_free(struct rzs_stream *stream)
+{
+	kfree(stream->workmem);
+	free_pages((unsigned long)stream->buffer, 1);
+	kfree(stream);
+}
+
+static struct rzs_stream *rzs_stream_alloc(void)
+{
+	struct rzs_stream *stream;
+
+	stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+	if (!stream)
+		return NULL;
+
+	stream->workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	stream->buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
+	if (!stream->workmem || !stream->buffer) {
+		rzs_stream_free(stream);
+		return NULL;
+	}
+
+	return stream;
+}
+
+/*
+ * Check whether the compressed object of a dedup node holds exactly
+ * the contents of page. buffer is scratch space for decompression.
+ */
+static int rzs_dedup_match(struct rzs_dedup *node, struct page *page,
+			void *buffer)
+{
+	int ret;
+	size_t clen = PAGE_SIZE;
+	unsigned char *user_mem, *cmem;
+
+	cmem = kmap_atomic(node->page, KM_USER1) + node->offset;
+	ret = lzo1x_decompress_safe(cmem + sizeof(struct zobj_header),
+			xv_get_object_size(cmem) - sizeof(struct zobj_header),
+			buffer, &clen);
+	kunmap_atomic(cmem, KM_USER1);
+
+	if (ret != LZO_E_OK || clen != PAGE_SIZE)
+		return 0;
+
+	user_mem = kmap_atomic(page, KM_USER0);
+	ret = !memcmp(user_mem, buffer, PAGE_SIZE);
+	kunmap_atomic(user_mem, KM_USER0);
+
+	return ret;
+}
+
+/*
+ * Point index at an already stored object with the same contents as page,
+ * if there is one. Returns 1 if the page was merged.
+ *
+ * The candidate is pinned with a reference under rzs->lock and compared
+ * outside it, so the decompression does not stall other I/O.
+ */
+static int ramzswap_dedup_page(struct ramzswap *rzs, struct rzs_stream *stream,
+			u32 index, struct page *page, u32 checksum)
+{
+	int match;
+	struct rzs_dedup *node;
+	struct hlist_node *pos;
+
+	spin_lock(&rzs->lock);
+	hlist_for_each_entry(node, pos,
+			&rzs->dedup_hash[hash_32(checksum, dedup_hash_bits)],
+			hash) {
+		if (node->checksum == checksum)
+			goto found;
+	}
+	spin_unlock(&rzs->lock);
 	return 0;
+
+found:
+	node->refcount++;
+	spin_unlock(&rzs->lock);
+
+	match = rzs_dedup_match(node, page, stream->buffer);
+
+	spin_lock(&rzs->lock);
+	if (!match) {
+		/* Its last user left while pinned and was counted as shared */
+		if (node->refcount == 1)
+			rzs_stat_inc(&rzs->stats.pages_dedup);
+		rzs_dedup_put(rzs, node);
+		spin_unlock(&rzs->lock);
+		return 0;
+	}
+
+	/* The pin becomes the reference of index */
+	ramzswap_free_page(rzs, index);
+
+	rzs->table[index].page = node->page;
+	rzs->table[index].offset = node->offset;
+	rzs->table[index].checksum = checksum;
+	rzs_set_flag(rzs, index, RZS_DEDUP);
+	rzs_stat_inc(&rzs->stats.pages_stored);
+	rzs_stat_inc(&rzs->stats.pages_dedup);
+	spin_unlock(&rzs->lock);
+
+	return 1;
 }
 
 static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
 {
 	int ret;
 	u32 index;
-	size_t clen;
+	size_t clen, zlen;
 	struct page *page;
 	struct zobj_header *zheader;
+	struct rzs_stream *stream = NULL;
 	unsigned char *user_mem, *cmem;
 
 	rzs_stat64_inc(rzs, &rzs->stats.num_reads);
@@ -275,30 +490,63 @@ static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
 	page = bio->bi_io_vec[0].bv_page;
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 
-	if (rzs_test_flag(rzs, index, RZS_ZERO))
-		return handle_zero_page(bio);
+	/*
+	 * A compressed object is copied out under rzs->lock and
+	 * decompressed from the stream buffer, so grab a stream now if
+	 * this looks like one. The flags are rechecked under the lock.
+	 */
+	if (rzs->table[index].page && !(rzs->table[index].flags &
+			(BIT(RZS_ZERO) | BIT(RZS_BACKED) | BIT(RZS_UNCOMPRESSED))))
+		stream = rzs_stream_get(rzs);
+
+again:
+	spin_lock(&rzs->lock);
+	if (rzs_test_flag(rzs, index, RZS_ZERO)) {
+		spin_unlock(&rzs->lock);
+		ret = handle_zero_page(bio);
+		goto out_stream;
+	}
+
+	if (rzs_test_flag(rzs, index, RZS_BACKED)) {
+		spin_unlock(&rzs->lock);
+		ret = handle_backed_page(rzs, bio);
+		goto out_stream;
+	}
 
 	/* Requested page is not present in compressed area */
-	if (!rzs->table[index].page)
-		return handle_ramzswap_fault(rzs, bio);
+	if (!rzs->table[index].page) {
+		spin_unlock(&rzs->lock);
+		ret = handle_ramzswap_fault(rzs, bio);
+		goto out_stream;
+	}
 
 	/* Page is stored uncompressed since it's incompressible */
-	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-		return handle_uncompressed_page(rzs, bio);
+	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED))) {
+		ret = handle_uncompressed_page(rzs, bio);
+		goto out_stream;
+	}
 
-	user_mem = kmap_atomic(page, KM_USER0);
-	clen = PAGE_SIZE;
+	if (unlikely(!stream)) {
+		/* Raced with a write: cannot sleep under the lock */
+		spin_unlock(&rzs->lock);
+		stream = rzs_stream_get(rzs);
+		goto again;
+	}
 
 	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
 			rzs->table[index].offset;
+	zlen = xv_get_object_size(cmem) - sizeof(*zheader);
+	memcpy(stream->buffer, cmem + sizeof(*zheader), zlen);
+	kunmap_atomic(cmem, KM_USER1);
+	spin_unlock(&rzs->lock);
 
-	ret = lzo1x_decompress_safe(
-		cmem + sizeof(*zheader),
-		xv_get_object_size(cmem) - sizeof(*zheader),
-		user_mem, &clen);
+	user_mem = kmap_atomic(page, KM_USER0);
+	clen = PAGE_SIZE;
+
+	ret = lzo1x_decompress_safe(stream->buffer, zlen, user_mem, &clen);
 
 	kunmap_atomic(user_mem, KM_USER0);
-	kunmap_atomic(cmem, KM_USER1);
+	rzs_stream_put(rzs, stream);
 
 	/* should NEVER happen */
 	if (unlikely(ret != LZO_E_OK)) {
@@ -317,15 +565,22 @@ static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
 out:
 	bio_io_error(bio);
 	return 0;
+
+out_stream:
+	if (stream)
+		rzs_stream_put(rzs, stream);
+	return ret;
 }
 
 static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 {
 	int ret;
-	u32 offset, index;
-	size_t clen;
+	u32 offset, index, checksum = 0;
+	size_t clen, size;
 	struct zobj_header *zheader;
 	struct page *page, *page_store;
+	struct rzs_stream *stream;
+	struct rzs_dedup *node = NULL;
 	unsigned char *user_mem, *cmem, *src;
 
 	rzs_stat64_inc(rzs, &rzs->stats.num_writes);
@@ -333,77 +588,119 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 	page = bio->bi_io_vec[0].bv_page;
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 
-	src = rzs->compress_buffer;
-
-	mutex_lock(&rzs->lock);
-
 	user_mem = kmap_atomic(page, KM_USER0);
 	if (page_zero_filled(user_mem)) {
 		kunmap_atomic(user_mem, KM_USER0);
-		mutex_unlock(&rzs->lock);
+		spin_lock(&rzs->lock);
+		ramzswap_free_page(rzs, index);
 		rzs_stat_inc(&rzs->stats.pages_zero);
 		rzs_set_flag(rzs, index, RZS_ZERO);
+		spin_unlock(&rzs->lock);
 
 		set_bit(BIO_UPTODATE, &bio->bi_flags);
 		bio_endio(bio, 0);
 		return 0;
 	}
+	if (rzs->dedup)
+		checksum = jhash2((u32 *)user_mem, PAGE_SIZE / sizeof(u32), 0);
+	kunmap_atomic(user_mem, KM_USER0);
 
-	ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
-				rzs->compress_workmem);
+	stream = rzs_stream_get(rzs);
+
+	if (rzs->dedup &&
+		ramzswap_dedup_page(rzs, stream, index, page, checksum)) {
+		rzs_stream_put(rzs, stream);
+
+		set_bit(BIO_UPTODATE, &bio->bi_flags);
+		bio_endio(bio, 0);
+		return 0;
+	}
 
+	src = stream->buffer;
+	user_mem = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
+				stream->workmem);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	if (unlikely(ret != LZO_E_OK)) {
-		mutex_unlock(&rzs->lock);
+		rzs_stream_put(rzs, stream);
 		pr_err("Compression failed! err=%d\n", ret);
 		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
 		goto out;
 	}
 
+	if (unlikely(clen > max_zpage_size))
+		clen = PAGE_SIZE;
+
+	/*
+	 * Charge what the allocator will really use against memlimit
+	 * before allocating; it is given back if the allocation fails.
+	 * Over the limit the page goes to the backing device.
+	 */
+	if (clen == PAGE_SIZE)
+		size = PAGE_SIZE;
+	else
+		size = xv_get_alloc_size(clen + sizeof(*zheader));
+
+	spin_lock(&rzs->lock);
+	if (rzs->memlimit && rzs->mem_used + size > rzs->memlimit) {
+		if (!rzs->backing_bdev) {
+			spin_unlock(&rzs->lock);
+			rzs_stream_put(rzs, stream);
+			rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
+			goto out;
+		}
+
+		ramzswap_free_page(rzs, index);
+		rzs_set_flag(rzs, index, RZS_BACKED);
+		rzs_stat_inc(&rzs->stats.pages_backed);
+		spin_unlock(&rzs->lock);
+		rzs_stream_put(rzs, stream);
+
+		return handle_backed_page(rzs, bio);
+	}
+	rzs->mem_used += size;
+	spin_unlock(&rzs->lock);
+
 	/*
 	 * Page is incompressible. Store it as-is (uncompressed)
 	 * since we do not want to return too many swap write
 	 * errors which has side effect of hanging the system.
 	 */
-	if (unlikely(clen > max_zpage_size)) {
-		clen = PAGE_SIZE;
+	if (unlikely(clen == PAGE_SIZE)) {
 		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 		if (unlikely(!page_store)) {
-			mutex_unlock(&rzs->lock);
+			rzs_stream_put(rzs, stream);
 			pr_info("Error allocating memory for incompressible "
 				"page: %u\n", index);
 			rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
-			goto out;
+			goto out_unreserve;
 		}
 
 		offset = 0;
-		rzs_set_flag(rzs, index, RZS_UNCOMPRESSED);
-		rzs_stat_inc(&rzs->stats.pages_expand);
-		rzs->table[index].page = page_store;
 		src = kmap_atomic(page, KM_USER0);
 		goto memstore;
 	}
 
 	if (xv_malloc(rzs->mem_pool, clen + sizeof(*zheader),
-			&rzs->table[index].page, &offset,
+			&page_store, &offset,
 			GFP_NOIO | __GFP_HIGHMEM)) {
-		mutex_unlock(&rzs->lock);
+		rzs_stream_put(rzs, stream);
 		pr_info("Error allocating memory for compressed "
 			"page: %u, size=%zu\n", index, clen);
 		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
-		goto out;
+		goto out_unreserve;
 	}
 
-memstore:
-	rzs->table[index].offset = offset;
+	if (rzs->dedup)
+		node = kmalloc(sizeof(*node), GFP_NOIO);
 
-	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
-			rzs->table[index].offset;
+memstore:
+	cmem = kmap_atomic(page_store, KM_USER1) + offset;
 
 #if 0
 	/* Back-reference needed for memory defragmentation */
-	if (!rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)) {
+	if (clen != PAGE_SIZE) {
 		zheader = (struct zobj_header *)cmem;
 		zheader->table_idx = index;
 		cmem += sizeof(*zheader);
@@ -413,21 +710,46 @@ memstore:
 	memcpy(cmem, src, clen);
 
 	kunmap_atomic(cmem, KM_USER1);
-	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
+	if (unlikely(clen == PAGE_SIZE))
 		kunmap_atomic(src, KM_USER0);
 
+	rzs_stream_put(rzs, stream);
+
+	spin_lock(&rzs->lock);
+	ramzswap_free_page(rzs, index);
+
+	rzs->table[index].page = page_store;
+	rzs->table[index].offset = offset;
+	if (unlikely(clen == PAGE_SIZE)) {
+		rzs_set_flag(rzs, index, RZS_UNCOMPRESSED);
+		rzs_stat_inc(&rzs->stats.pages_expand);
+	} else if (node) {
+		node->checksum = checksum;
+		node->refcount = 1;
+		node->page = page_store;
+		node->offset = offset;
+		hlist_add_head(&node->hash,
+			&rzs->dedup_hash[hash_32(checksum, dedup_hash_bits)]);
+		rzs->table[index].checksum = checksum;
+		rzs_set_flag(rzs, index, RZS_DEDUP);
+	}
+
 	/* Update stats */
 	rzs->stats.compr_size += clen;
 	rzs_stat_inc(&rzs->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		rzs_stat_inc(&rzs->stats.good_compress);
 
-	mutex_unlock(&rzs->lock);
+	spin_unlock(&rzs->lock);
 
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
 	return 0;
 
+out_unreserve:
+	spin_lock(&rzs->lock);
+	rzs->mem_used -= size;
+	spin_unlock(&rzs->lock);
 out:
 	bio_io_error(bio);
 	return 0;
@@ -435,6 +757,8 @@ out:
 
 /*
  * Check if request is within bounds and page aligned.
+ * The queue limits every bio to a single page, so this also holds
+ * when the device is used as a generic block device.
  */
 static inline int valid_swap_request(struct ramzswap *rzs, struct bio *bio)
 {
@@ -487,49 +811,84 @@ static int ramzswap_make_request(struct request_queue *queue, struct bio *bio)
 static void reset_device(struct ramzswap *rzs)
 {
 	size_t index;
+	struct rzs_stream *stream, *tmp;
 
 	/* Do not accept any new I/O request */
 	rzs->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(rzs->compress_workmem);
-	free_pages((unsigned long)rzs->compress_buffer, 1);
-
-	rzs->compress_workmem = NULL;
-	rzs->compress_buffer = NULL;
-
-	/* Free all pages that are still in this ramzswap device */
-	for (index = 0; index < rzs->disksize >> PAGE_SHIFT; index++) {
-		struct page *page;
-		u16 offset;
-
-		page = rzs->table[index].page;
-		offset = rzs->table[index].offset;
-
-		if (!page)
-			continue;
+	/* Free the compression streams */
+	list_for_each_entry_safe(stream, tmp, &rzs->streams, list) {
+		list_del(&stream->list);
+		rzs_stream_free(stream);
+	}
 
-		if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-			__free_page(page);
-		else
-			xv_free(rzs->mem_pool, page, offset);
+	/*
+	 * Free all pages that are still in this ramzswap device.
+	 * Shared objects are freed when their last user goes.
+	 */
+	if (rzs->table) {
+		spin_lock(&rzs->lock);
+		for (index = 0; index < rzs->disksize >> PAGE_SHIFT; index++)
+			ramzswap_free_page(rzs, index);
+		spin_unlock(&rzs->lock);
 	}
 
 	vfree(rzs->table);
 	rzs->table = NULL;
 
-	xv_destroy_pool(rzs->mem_pool);
+	vfree(rzs->dedup_hash);
+	rzs->dedup_hash = NULL;
+
+	if (rzs->mem_pool)
+		xv_destroy_pool(rzs->mem_pool);
 	rzs->mem_pool = NULL;
 
+	if (rzs->backing_bdev)
+		close_bdev_exclusive(rzs->backing_bdev,
+				FMODE_READ | FMODE_WRITE);
+	rzs->backing_bdev = NULL;
+
 	/* Reset stats */
 	memset(&rzs->stats, 0, sizeof(rzs->stats));
 
 	rzs->disksize = 0;
+	rzs->memlimit = 0;
+	rzs->mem_used = 0;
+	rzs->backing_name[0] = '\0';
+}
+
+static int ramzswap_init_backing_device(struct ramzswap *rzs)
+{
+	size_t backing_size;
+
+	rzs->backing_bdev = open_bdev_exclusive(rzs->backing_name,
+				FMODE_READ | FMODE_WRITE, rzs);
+	if (IS_ERR(rzs->backing_bdev)) {
+		int ret = PTR_ERR(rzs->backing_bdev);
+
+		pr_err("Error opening backing device %s: %d\n",
+			rzs->backing_name, ret);
+		rzs->backing_bdev = NULL;
+		return ret;
+	}
+
+	backing_size = i_size_read(rzs->backing_bdev->bd_inode) & PAGE_MASK;
+	if (!rzs->disksize) {
+		rzs->disksize = backing_size;
+	} else if (rzs->disksize > backing_size) {
+		pr_err("Backing device %s (%zu kB) is smaller than the "
+			"disk (%zu kB)\n", rzs->backing_name,
+			backing_size >> 10, rzs->disksize >> 10);
+		return -EINVAL;
+	}
+
+	pr_info("Using %s as backing device\n", rzs->backing_name);
+	return 0;
 }
 
 static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 {
-	int ret;
+	int ret, i;
 	size_t num_pages;
 	struct page *page;
 	union swap_header *swap_header;
@@ -539,20 +898,36 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 		return -EBUSY;
 	}
 
+	if (rzs->backing_name[0]) {
+		ret = ramzswap_init_backing_device(rzs);
+		if (ret)
+			goto fail;
+	}
+
 	ramzswap_set_disksize(rzs, totalram_pages << PAGE_SHIFT);
 
-	rzs->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!rzs->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail;
+	for (i = 0; i < num_online_cpus(); i++) {
+		struct rzs_stream *stream = rzs_stream_alloc();
+
+		if (!stream) {
+			pr_err("Error allocating compression stream\n");
+			ret = -ENOMEM;
+			goto fail;
+		}
+		list_add(&stream->list, &rzs->streams);
 	}
 
-	rzs->compress_buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
-	if (!rzs->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
-		goto fail;
+	rzs->dedup = dedup;
+	if (rzs->dedup) {
+		rzs->dedup_hash = vmalloc(sizeof(*rzs->dedup_hash) <<
+					dedup_hash_bits);
+		if (!rzs->dedup_hash) {
+			pr_err("Error allocating dedup hash\n");
+			ret = -ENOMEM;
+			goto fail;
+		}
+		for (i = 0; i < 1 << dedup_hash_bits; i++)
+			INIT_HLIST_HEAD(&rzs->dedup_hash[i]);
 	}
 
 	num_pages = rzs->disksize >> PAGE_SHIFT;
@@ -634,6 +1009,37 @@ static int ramzswap_ioctl(struct block_device *bdev, fmode_t mode,
 		pr_info("Disk size set to %zu kB\n", disksize_kb);
 		break;
 
+	case RZSIO_SET_MEMLIMIT_KB:
+	{
+		size_t memlimit_kb;
+
+		if (rzs->init_done) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (copy_from_user(&memlimit_kb, (void *)arg,
+						_IOC_SIZE(cmd))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		rzs->memlimit = memlimit_kb << 10;
+		pr_info("Memory limit set to %zu kB\n", memlimit_kb);
+		break;
+	}
+
+	case RZSIO_SET_BACKING_DEV:
+		if (rzs->init_done) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (copy_from_user(rzs->backing_name, (void *)arg,
+						MAX_BACKING_NAME_LEN)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		rzs->backing_name[MAX_BACKING_NAME_LEN - 1] = '\0';
+		break;
+
 	case RZSIO_GET_STATS:
 	{
 		struct ramzswap_ioctl_stats *stats;
@@ -687,7 +1093,9 @@ void ramzswap_slot_free_notify(struct block_device *bdev, unsigned long index)
 	struct ramzswap *rzs;
 
 	rzs = bdev->bd_disk->private_data;
+	spin_lock(&rzs->lock);
 	ramzswap_free_page(rzs, index);
+	spin_unlock(&rzs->lock);
 	rzs_stat64_inc(rzs, &rzs->stats.notify_free);
 
 	return;
@@ -703,8 +1111,11 @@ static int create_device(struct ramzswap *rzs, int device_id)
 {
 	int ret = 0;
 
-	mutex_init(&rzs->lock);
+	spin_lock_init(&rzs->lock);
 	spin_lock_init(&rzs->stat64_lock);
+	spin_lock_init(&rzs->streams_lock);
+	INIT_LIST_HEAD(&rzs->streams);
+	init_waitqueue_head(&rzs->streams_wait);
 
 	rzs->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!rzs->queue) {
@@ -739,6 +1150,8 @@ static int create_device(struct ramzswap *rzs, int device_id)
 
 	blk_queue_physical_block_size(rzs->disk->queue, PAGE_SIZE);
 	blk_queue_logical_block_size(rzs->disk->queue, PAGE_SIZE);
+	/* One page per bio, also for filesystem (non-swap) use */
+	blk_queue_max_hw_sectors(rzs->disk->queue, SECTORS_PER_PAGE);
 
 	add_disk(rzs->disk);
 
@@ -828,6 +1241,8 @@ static void __exit ramzswap_exit(void)
 
 module_param(num_devices, uint, 0);
 MODULE_PARM_DESC(num_devices, "Number of ramzswap devices");
+module_param(dedup, bool, 0);
+MODULE_PARM_DESC(dedup, "Store identical pages only once (default: 1)");
 
 module_init(ramzswap_init);
 module_exit(ramzswap_exit);
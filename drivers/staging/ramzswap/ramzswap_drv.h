@@ -16,7 +16,8 @@
 #define _RAMZSWAP_DRV_H_
 
 #include <linux/spinlock.h>
-#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/wait.h>
 
 #include "ramzswap_ioctl.h"
 #include "xvmalloc.h"
@@ -56,6 +57,9 @@ static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
  * otherwise, xv_malloc() would always return failure.
  */
 
+/* Buckets in the same-page (dedup) hash: 1 << dedup_hash_bits */
+static const unsigned dedup_hash_bits = 12;
+
 /*-- End of configurable params */
 
 #define SECTOR_SHIFT		9
@@ -71,6 +75,12 @@ enum rzs_pageflags {
 	/* Page consists entirely of zeros */
 	RZS_ZERO,
 
+	/* Compressed object is tracked in the dedup hash (may be shared) */
+	RZS_DEDUP,
+
+	/* Page overflowed memlimit and lives on the backing device */
+	RZS_BACKED,
+
 	__NR_RZS_PAGEFLAGS,
 };
 
@@ -85,8 +95,31 @@ struct table {
 	u16 offset;
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
+	u32 checksum;	/* content hash, valid if RZS_DEDUP */
 } __attribute__((aligned(4)));
 
+/*
+ * One for each distinct compressed object when dedup is enabled.
+ * Table entries holding identical pages all point to the same object.
+ */
+struct rzs_dedup {
+	struct hlist_node hash;
+	u32 checksum;
+	u32 refcount;
+	struct page *page;
+	u16 offset;
+};
+
+/*
+ * Compression stream: LZO working memory and a two page buffer.
+ * There is one per online CPU so that writes compress concurrently.
+ */
+struct rzs_stream {
+	struct list_head list;
+	void *workmem;
+	void *buffer;
+};
+
 struct ramzswap_stats {
 	/* basic stats */
 	size_t compr_size;	/* compressed size of pages stored -
@@ -103,19 +136,26 @@ struct ramzswap_stats {
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_dedup;	/* no. of pages sharing another's object */
+	u32 pages_backed;	/* no. of pages on the backing device */
 #endif
 };
 
 struct ramzswap {
 	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
 	struct table *table;
+	struct hlist_head *dedup_hash;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct mutex lock;
+	spinlock_t lock;	/* protect table, dedup hash and 32-bit stats */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
+	int dedup;		/* merge identical pages */
+
+	/* Idle compression streams */
+	struct list_head streams;
+	spinlock_t streams_lock;
+	wait_queue_head_t streams_wait;
 	/*
 	 * This is limit on amount of *uncompressed* worth of data
 	 * we can hold. When backing swap device is provided, it is
@@ -123,6 +163,15 @@ struct ramzswap {
 	 */
 	size_t disksize;	/* bytes */
 
+	/*
+	 * Limit on compressed data held in memory. Pages written past
+	 * it go to the backing device, or fail if there is none.
+	 */
+	size_t memlimit;	/* bytes, 0 for no limit */
+	size_t mem_used;	/* allocator bytes charged against memlimit */
+	struct block_device *backing_bdev;
+	char backing_name[MAX_BACKING_NAME_LEN];
+
 	struct ramzswap_stats stats;
 };
 
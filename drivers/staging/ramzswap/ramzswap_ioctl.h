@@ -15,6 +15,8 @@
 #ifndef _RAMZSWAP_IOCTL_H_
 #define _RAMZSWAP_IOCTL_H_
 
+#define MAX_BACKING_NAME_LEN 128
+
 struct ramzswap_ioctl_stats {
 	u64 disksize;		/* user specified or equal to backing swap
 				 * size (if present) */
@@ -32,11 +34,16 @@ struct ramzswap_ioctl_stats {
 	u64 orig_data_size;
 	u64 compr_data_size;
 	u64 mem_used_total;
+	u64 memlimit;		/* 0 if not limited */
+	u32 pages_dedup;	/* pages sharing another page's object */
+	u32 pages_backed;	/* pages written out to backing device */
 } __attribute__ ((packed, aligned(4)));
 
 #define RZSIO_SET_DISKSIZE_KB	_IOW('z', 0, size_t)
 #define RZSIO_GET_STATS		_IOR('z', 1, struct ramzswap_ioctl_stats)
 #define RZSIO_INIT		_IO('z', 2)
 #define RZSIO_RESET		_IO('z', 3)
+#define RZSIO_SET_MEMLIMIT_KB	_IOW('z', 4, size_t)
+#define RZSIO_SET_BACKING_DEV	_IOW('z', 5, unsigned char[MAX_BACKING_NAME_LEN])
 
 #endif
@@ -498,6 +498,15 @@ u32 xv_get_object_size(void *obj)
 	return blk->size;
 }
 
+/*
+ * Returns memory taken from the pool by an object of the given size,
+ * including its block header.
+ */
+u32 xv_get_alloc_size(u32 size)
+{
+	return ALIGN(size, XV_ALIGN) + XV_ALIGN;
+}
+
 /*
  * Returns total memory used by allocator (userdata + metadata)
  */
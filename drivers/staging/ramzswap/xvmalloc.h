@@ -25,6 +25,7 @@ int xv_malloc(struct xv_pool *pool, u32 size, struct page **page,
 void xv_free(struct xv_pool *pool, struct page *page, u32 offset);
 
 u32 xv_get_object_size(void *obj);
+u32 xv_get_alloc_size(u32 size);
 u64 xv_get_total_size_bytes(struct xv_pool *pool);
 
 #endif
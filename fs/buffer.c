@@ -886,16 +886,21 @@ int remove_inode_buffers(struct inode *inode)
 struct buffer_head *alloc_page_buffers(struct page *page, unsigned long size,
 		int retry)
 {
-	struct buffer_head *bh, *head;
+	struct buffer_head *bh, *head, *bhs[MAX_BUF_PER_PAGE];
+	int nr = PAGE_SIZE / size;
 	long offset;
+	int i;
 
+	BUG_ON(nr > MAX_BUF_PER_PAGE);
 try_again:
 	head = NULL;
+	if (!alloc_buffer_heads(GFP_NOFS, nr, bhs))
+		goto no_grow;
+
 	offset = PAGE_SIZE;
-	while ((offset -= size) >= 0) {
-		bh = alloc_buffer_head(GFP_NOFS);
-		if (!bh)
-			goto no_grow;
+	for (i = 0; i < nr; i++) {
+		offset -= size;
+		bh = bhs[i];
 
 		bh->b_bdev = NULL;
 		bh->b_this_page = head;
@@ -913,18 +918,8 @@ try_again:
 		init_buffer(bh, NULL, NULL);
 	}
 	return head;
-/*
- * In case anything failed, we just free everything we got.
- */
-no_grow:
-	if (head) {
-		do {
-			bh = head;
-			head = head->b_this_page;
-			free_buffer_head(bh);
-		} while (head);
-	}
 
+no_grow:
 	/*
 	 * Return failure for non-async IO requests.  Async IO requests
 	 * are not allowed to fail, so we have to wait until buffer heads
@@ -3256,12 +3251,14 @@ int try_to_free_buffers(struct page *page)
 out:
 	if (buffers_to_free) {
 		struct buffer_head *bh = buffers_to_free;
+		struct buffer_head *bhs[MAX_BUF_PER_PAGE];
+		int nr = 0;
 
 		do {
-			struct buffer_head *next = bh->b_this_page;
-			free_buffer_head(bh);
-			bh = next;
+			bhs[nr++] = bh;
+			bh = bh->b_this_page;
 		} while (bh != buffers_to_free);
+		free_buffer_heads(nr, bhs);
 	}
 	return ret;
 }
@@ -3361,6 +3358,39 @@ void free_buffer_head(struct buffer_head *bh)
 }
 EXPORT_SYMBOL(free_buffer_head);
 
+/*
+ * Allocate nr zeroed buffer_heads into bhs with one bulk slab call.
+ * Returns nr, or 0 with nothing allocated.
+ */
+int alloc_buffer_heads(gfp_t gfp_flags, int nr, struct buffer_head **bhs)
+{
+	int i;
+
+	if (!kmem_cache_alloc_bulk(bh_cachep, gfp_flags | __GFP_ZERO,
+				   nr, (void **)bhs))
+		return 0;
+	for (i = 0; i < nr; i++)
+		INIT_LIST_HEAD(&bhs[i]->b_assoc_buffers);
+	get_cpu_var(bh_accounting).nr += nr;
+	recalc_bh_state();
+	put_cpu_var(bh_accounting);
+	return nr;
+}
+EXPORT_SYMBOL(alloc_buffer_heads);
+
+void free_buffer_heads(int nr, struct buffer_head **bhs)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		BUG_ON(!list_empty(&bhs[i]->b_assoc_buffers));
+	kmem_cache_free_bulk(bh_cachep, nr, (void **)bhs);
+	get_cpu_var(bh_accounting).nr -= nr;
+	recalc_bh_state();
+	put_cpu_var(bh_accounting);
+}
+EXPORT_SYMBOL(free_buffer_heads);
+
 static void buffer_exit_cpu(int cpu)
 {
 	int i;
@@ -1431,6 +1431,79 @@ next:
  	return found;
 }
 
+/**
+ * __d_lookup_rcu - search for a dentry without locking or referencing it
+ * @parent: parent dentry
+ * @name: qstr of name we wish to find
+ *
+ * Like __d_lookup(), but takes neither d_lock nor a reference on the
+ * dentry found, for the lockless part of path walk.  The caller must
+ * hold rcu_read_lock() across the call and any use of the result, and
+ * must have sampled rename_lock beforehand: a concurrent d_move() can
+ * make this miss a dentry or return one that no longer matches, so the
+ * result means nothing until d_rcu_walk_get() has confirmed it.
+ */
+struct dentry *__d_lookup_rcu(struct dentry *parent, struct qstr *name)
+{
+	unsigned int len = name->len;
+	unsigned int hash = name->hash;
+	const unsigned char *str = name->name;
+	struct hlist_head *head = d_hash(parent,hash);
+	struct hlist_node *node;
+	struct dentry *dentry;
+
+	hlist_for_each_entry_rcu(dentry, node, head, d_hash) {
+		struct qstr *qstr;
+
+		if (dentry->d_name.hash != hash)
+			continue;
+		if (dentry->d_parent != parent)
+			continue;
+		if (d_unhashed(dentry))
+			continue;
+
+		qstr = &dentry->d_name;
+		if (parent->d_op && parent->d_op->d_compare) {
+			if (parent->d_op->d_compare(parent, qstr, name))
+				continue;
+		} else {
+			if (qstr->len != len)
+				continue;
+			if (memcmp(qstr->name, str, len))
+				continue;
+		}
+		return dentry;
+	}
+	return NULL;
+}
+
+/**
+ * d_rcu_walk_get - take a reference on a dentry found by __d_lookup_rcu
+ * @dentry: dentry the lockless walk stopped at
+ * @inode: inode the walk saw attached to @dentry
+ * @seq: rename_lock sequence sampled before the walk
+ *
+ * Returns 1 and takes a reference if @dentry is still hashed, still has
+ * @inode and nothing has been renamed since @seq, so that the path the
+ * walk followed to reach it is still valid.  Returns 0 otherwise.
+ *
+ * The dentry may have no references left and be sitting on the unused
+ * list; it is picked up under d_lock as __d_lookup() does.
+ */
+int d_rcu_walk_get(struct dentry *dentry, struct inode *inode, unsigned seq)
+{
+	int ret = 0;
+
+	spin_lock(&dentry->d_lock);
+	if (!d_unhashed(dentry) && dentry->d_inode == inode &&
+	    !read_seqretry(&rename_lock, seq)) {
+		atomic_inc(&dentry->d_count);
+		ret = 1;
+	}
+	spin_unlock(&dentry->d_lock);
+	return ret;
+}
+
 /**
  * d_hash_and_lookup - hash the qstr then search for a dentry
  * @dir: Directory to search in
@@ -838,6 +838,12 @@ struct ext4_inode_info {
 	 */
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+
+	/*
+	 * Transaction in which the inode was changed in a way a fast
+	 * commit cannot replay.
+	 */
+	tid_t i_fc_ineligible_tid;
 };
 
 /*
@@ -883,6 +889,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
 #define EXT4_MOUNT_I_VERSION            0x2000000 /* i_version support */
+#define EXT4_MOUNT_JOURNAL_FAST_COMMIT	0x4000000 /* fsync with fast commits */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1072,6 +1079,11 @@ struct ext4_sb_info {
 	u32 s_max_batch_time;
 	u32 s_min_batch_time;
 	struct block_device *journal_bdev;
+
+	/* Fast commits [JBD2_FAST_COMMIT_ONGOING] */
+	tid_t s_fc_ineligible_tid;	/* no fast commits in this transaction */
+	unsigned int s_fc_commits;	/* fsyncs done with a fast commit */
+	unsigned int s_fc_fallbacks;	/* fsyncs that needed a full commit */
 #ifdef CONFIG_JBD2_DEBUG
 	struct timer_list turn_ro_timer;	/* For turning read-only (crash simulation) */
 	wait_queue_head_t ro_wait_queue;	/* For people waiting for the fs to go read-only */
@@ -1520,6 +1532,11 @@ extern int ext4_htree_store_dirent(struct file *dir_file, __u32 hash,
 				    struct ext4_dir_entry_2 *dirent);
 extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
+/* fast_commit.c */
+extern int ext4_fc_commit(struct inode *inode, tid_t tid);
+extern int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+			  int off, tid_t expected_tid);
+
 /* fsync.c */
 extern int ext4_sync_file(struct file *, int);
 
@@ -262,6 +262,28 @@ static inline void ext4_update_inode_fsync_trans(handle_t *handle,
 	}
 }
 
+/*
+ * The running transaction changes @inode in a way that a fast commit,
+ * which only logs the raw inode, cannot replay: fsync has to commit the
+ * transaction.
+ */
+static inline void ext4_fc_mark_ineligible(handle_t *handle,
+					   struct inode *inode)
+{
+	if (ext4_handle_valid(handle))
+		EXT4_I(inode)->i_fc_ineligible_tid =
+			handle->h_transaction->t_tid;
+}
+
+/* As above, for a change to the filesystem as a whole. */
+static inline void ext4_fc_mark_sb_ineligible(handle_t *handle,
+					      struct super_block *sb)
+{
+	if (ext4_handle_valid(handle))
+		EXT4_SB(sb)->s_fc_ineligible_tid =
+			handle->h_transaction->t_tid;
+}
+
 /* super.c */
 int ext4_force_commit(struct super_block *sb);
 
@@ -0,0 +1,328 @@
+/*
+ *  linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits: fsync without a full journal commit.
+ *
+ * An fsync normally commits the whole running transaction: descriptor
+ * blocks, a copy of every metadata block it touched, a commit block and
+ * cache flushes, even when all the file needed was a one block append.
+ * When the changes the running transaction made to a regular file are
+ * confined to its inode (size, times, and an extent tree that still
+ * fits in i_block), the raw inode alone describes them.  A fast commit
+ * writes just that to the jbd2 fast commit area, one block per fsync.
+ *
+ * Recovery replays the log as usual and then hands each fast commit of
+ * the next transaction back to ext4_fc_replay(), which copies the raw
+ * inode into the inode table and marks its extents in use in the block
+ * bitmaps.  Blocks are never freed by an eligible change, since anything
+ * that frees blocks or touches other metadata of the inode (truncate,
+ * xattrs, links, a deeper extent tree, ...) marks it ineligible for the
+ * transaction with ext4_fc_mark_ineligible(), and its fsync falls back
+ * to a full commit.
+ */
+
+#include <linux/time.h>
+#include <linux/fs.h>
+#include <linux/jbd2.h>
+#include <linux/crc32.h>
+#include <linux/quotaops.h>
+#include <linux/buffer_head.h>
+#include <linux/slab.h>
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+#include "fast_commit.h"
+
+/*
+ * A raw inode stands for all of a file's metadata when its extent tree
+ * lives entirely in i_block.
+ */
+static int ext4_fc_raw_inode_ok(struct ext4_inode *raw)
+{
+	struct ext4_extent_header *eh;
+
+	if (!S_ISREG(le16_to_cpu(raw->i_mode)) || !raw->i_links_count)
+		return 0;
+	if (!(le32_to_cpu(raw->i_flags) & EXT4_EXTENTS_FL))
+		return 0;
+	eh = (struct ext4_extent_header *)raw->i_block;
+	return eh->eh_magic == EXT4_EXT_MAGIC && eh->eh_depth == 0 &&
+	       le16_to_cpu(eh->eh_entries) <= le16_to_cpu(eh->eh_max) &&
+	       le16_to_cpu(eh->eh_max) <= (sizeof(raw->i_block) -
+				sizeof(*eh)) / sizeof(struct ext4_extent);
+}
+
+/*
+ * Whether @tid may be made durable for @inode by a fast commit.  Checked
+ * before taking the updates barrier, so that fsync of a quota file, whose
+ * i_mutex a handle in ext4_quota_write() may be waiting for, never takes
+ * it.  The ineligible tids are checked again under the barrier.
+ */
+static int ext4_fc_eligible(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_inode_info *ei = EXT4_I(inode);
+
+	return ei->i_fc_ineligible_tid != tid &&
+	       EXT4_SB(sb)->s_fc_ineligible_tid != tid &&
+	       list_empty(&ei->i_orphan) && !sb_any_quota_loaded(sb);
+}
+
+/*
+ * Copy the raw inode.  The caller has locked out journal updates, so no
+ * handle is halfway through changing it.  Returns 0 if @tid can be made
+ * durable for @inode by a fast commit of the copy.
+ */
+static int ext4_fc_snapshot(struct inode *inode, tid_t tid,
+			    struct ext4_inode *raw)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_iloc iloc;
+	int err;
+
+	/* A handle may have made @tid ineligible since the first check */
+	if (ei->i_fc_ineligible_tid == tid ||
+	    EXT4_SB(sb)->s_fc_ineligible_tid == tid)
+		return -EINVAL;
+
+	err = ext4_get_inode_loc(inode, &iloc);
+	if (err)
+		return err;
+	memcpy(raw, ext4_raw_inode(&iloc), EXT4_INODE_SIZE(sb));
+	brelse(iloc.bh);
+
+	if (!ext4_fc_raw_inode_ok(raw))
+		return -EINVAL;
+	return 0;
+}
+
+static __u32 ext4_fc_csum(struct buffer_head *bh, struct ext4_fc_tail *tail)
+{
+	return crc32_be(~0, bh->b_data, (char *)&tail->fc_crc - bh->b_data);
+}
+
+static int ext4_fc_write(journal_t *journal, tid_t tid, unsigned long ino,
+			 struct ext4_inode *raw, int inode_size)
+{
+	struct ext4_fc_tl *tl;
+	struct ext4_fc_inode *fc_inode;
+	struct ext4_fc_tail *tail;
+	struct buffer_head *bh;
+	int err;
+
+	err = jbd2_fc_get_buf(journal, &bh);
+	if (err)
+		return err;
+
+	memset(bh->b_data, 0, bh->b_size);
+	tl = (struct ext4_fc_tl *)bh->b_data;
+	tl->fc_tag = cpu_to_le16(EXT4_FC_TAG_INODE);
+	tl->fc_len = cpu_to_le16(sizeof(*fc_inode) + inode_size);
+	fc_inode = (struct ext4_fc_inode *)(tl + 1);
+	fc_inode->fc_ino = cpu_to_le32(ino);
+	memcpy(fc_inode->fc_raw_inode, raw, inode_size);
+
+	tl = (struct ext4_fc_tl *)(fc_inode->fc_raw_inode + inode_size);
+	tl->fc_tag = cpu_to_le16(EXT4_FC_TAG_TAIL);
+	tl->fc_len = cpu_to_le16(sizeof(*tail));
+	tail = (struct ext4_fc_tail *)(tl + 1);
+	tail->fc_tid = cpu_to_le32(tid);
+	tail->fc_crc = cpu_to_le32(ext4_fc_csum(bh, tail));
+
+	err = jbd2_fc_write_buf(journal, bh);
+	brelse(bh);
+	return err;
+}
+
+/*
+ * Make @inode's changes in transaction @tid durable with a fast commit.
+ * The file data has already been written.  Returns 0 on success; on any
+ * error the caller must commit @tid the usual way.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+	int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_inode *raw;
+	int err;
+
+	if (!S_ISREG(inode->i_mode) ||
+	    inode_size + EXT4_FC_OVERHEAD > sb->s_blocksize)
+		return -EINVAL;
+
+	if (!ext4_fc_eligible(inode, tid)) {
+		sbi->s_fc_fallbacks++;
+		return -EINVAL;
+	}
+
+	raw = kmalloc(inode_size, GFP_NOFS);
+	if (!raw)
+		return -ENOMEM;
+
+	err = jbd2_fc_begin_commit(journal, tid);
+	if (err)
+		goto out;
+
+	jbd2_journal_lock_updates(journal);
+	err = ext4_fc_snapshot(inode, tid, raw);
+	jbd2_journal_unlock_updates(journal);
+	if (err) {
+		sbi->s_fc_fallbacks++;
+		jbd2_fc_end_commit(journal);
+		goto out;
+	}
+
+	err = ext4_fc_write(journal, tid, inode->i_ino, raw, inode_size);
+	if (err) {
+		sbi->s_fc_fallbacks++;
+		jbd2_fc_end_commit_fallback(journal);
+		goto out;
+	}
+	sbi->s_fc_commits++;
+	jbd2_fc_end_commit(journal);
+out:
+	kfree(raw);
+	return err;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb, unsigned long ino,
+				struct ext4_inode *raw)
+{
+	int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	ext4_group_t group;
+	unsigned long offset;
+	ext4_fsblk_t block;
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EIO;
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * inode_size;
+	block = ext4_inode_table(sb, gdp) +
+		(offset >> EXT4_BLOCK_SIZE_BITS(sb));
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+
+	lock_buffer(bh);
+	memcpy(bh->b_data + (offset & (sb->s_blocksize - 1)), raw,
+	       inode_size);
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
+/* Mark @count blocks from @block in use, if they are not already. */
+static int ext4_fc_replay_mark_used(struct super_block *sb,
+				    ext4_fsblk_t block, unsigned int count)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct buffer_head *bitmap_bh, *gdp_bh;
+	struct ext4_group_desc *gdp;
+	ext4_group_t group;
+	ext4_grpblk_t bit;
+	unsigned int i, n, used;
+
+	while (count) {
+		ext4_get_group_no_and_offset(sb, block, &group, &bit);
+		n = min_t(unsigned int, count,
+			  EXT4_BLOCKS_PER_GROUP(sb) - bit);
+		gdp = ext4_get_group_desc(sb, group, &gdp_bh);
+		if (!gdp)
+			return -EIO;
+		bitmap_bh = ext4_read_block_bitmap(sb, group);
+		if (!bitmap_bh)
+			return -EIO;
+
+		ext4_lock_group(sb, group);
+		for (i = 0, used = 0; i < n; i++)
+			if (!ext4_set_bit(bit + i, bitmap_bh->b_data))
+				used++;
+		gdp->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+		ext4_free_blks_set(sb, gdp,
+				   ext4_free_blks_count(sb, gdp) - used);
+		gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
+		ext4_unlock_group(sb, group);
+
+		mark_buffer_dirty(bitmap_bh);
+		mark_buffer_dirty(gdp_bh);
+		brelse(bitmap_bh);
+		block += n;
+		count -= n;
+	}
+	return 0;
+}
+
+/*
+ * Recovery callback for each block of the fast commit area, once the
+ * log has been replayed.  A block belongs to the valid fast commits if
+ * it checks out and was written for @expected_tid, the transaction
+ * following the last one found in the log; the first block that does
+ * not ends them.
+ */
+int ext4_fc_replay(journal_t *journal, struct buffer_head *bh, int off,
+		   tid_t expected_tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_super_block *es = EXT4_SB(sb)->s_es;
+	int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_fc_tl *tl = (struct ext4_fc_tl *)bh->b_data;
+	struct ext4_fc_inode *fc_inode;
+	struct ext4_fc_tail *tail;
+	struct ext4_extent_header *eh;
+	struct ext4_extent *ex;
+	struct ext4_inode *raw;
+	unsigned long ino;
+	ext4_fsblk_t start;
+	unsigned int len;
+	int i, err;
+
+	if (inode_size + EXT4_FC_OVERHEAD > bh->b_size ||
+	    le16_to_cpu(tl->fc_tag) != EXT4_FC_TAG_INODE ||
+	    le16_to_cpu(tl->fc_len) != sizeof(*fc_inode) + inode_size)
+		return JBD2_FC_REPLAY_STOP;
+	fc_inode = (struct ext4_fc_inode *)(tl + 1);
+	tl = (struct ext4_fc_tl *)(fc_inode->fc_raw_inode + inode_size);
+	tail = (struct ext4_fc_tail *)(tl + 1);
+	if (le16_to_cpu(tl->fc_tag) != EXT4_FC_TAG_TAIL ||
+	    le16_to_cpu(tl->fc_len) != sizeof(*tail) ||
+	    le32_to_cpu(tail->fc_tid) != expected_tid ||
+	    le32_to_cpu(tail->fc_crc) != ext4_fc_csum(bh, tail))
+		return JBD2_FC_REPLAY_STOP;
+
+	ino = le32_to_cpu(fc_inode->fc_ino);
+	raw = (struct ext4_inode *)fc_inode->fc_raw_inode;
+	if (ino < EXT4_FIRST_INO(sb) || ino > le32_to_cpu(es->s_inodes_count) ||
+	    !ext4_fc_raw_inode_ok(raw))
+		goto corrupt;
+
+	eh = (struct ext4_extent_header *)raw->i_block;
+	ex = EXT_FIRST_EXTENT(eh);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		start = ext_pblock(ex);
+		len = ext4_ext_get_actual_len(ex);
+		if (start < le32_to_cpu(es->s_first_data_block) ||
+		    start + len > ext4_blocks_count(es) || start + len < start)
+			goto corrupt;
+	}
+
+	ex = EXT_FIRST_EXTENT(eh);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		err = ext4_fc_replay_mark_used(sb, ext_pblock(ex),
+					       ext4_ext_get_actual_len(ex));
+		if (err)
+			return err;
+	}
+	return ext4_fc_replay_inode(sb, ino, raw);
+
+corrupt:
+	ext4_msg(sb, KERN_ERR, "fast commit %d for inode %lu is corrupt, "
+		 "ignoring it and the ones after it", off, ino);
+	return JBD2_FC_REPLAY_STOP;
+}
@@ -0,0 +1,44 @@
+/*
+ *  linux/fs/ext4/fast_commit.h
+ *
+ * On-disk format of ext4 fast commits.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _EXT4_FAST_COMMIT_H
+#define _EXT4_FAST_COMMIT_H
+
+/*
+ * Each fast commit fills one block of the jbd2 fast commit area with a
+ * sequence of tag-length-value records: an inode record carrying the
+ * raw on-disk inode, then a tail record that names the transaction the
+ * fast commit belongs to and checksums the block up to the checksum
+ * itself.  The rest of the block is zero.
+ */
+#define EXT4_FC_TAG_INODE	0x0006
+#define EXT4_FC_TAG_TAIL	0x0008
+
+struct ext4_fc_tl {
+	__le16	fc_tag;
+	__le16	fc_len;		/* length of the value that follows */
+};
+
+struct ext4_fc_inode {
+	__le32	fc_ino;
+	__u8	fc_raw_inode[0];
+};
+
+struct ext4_fc_tail {
+	__le32	fc_tid;
+	__le32	fc_crc;		/* crc32_be(~0) of the block up to here */
+};
+
+/* Space taken in a fast commit block by everything but the raw inode */
+#define EXT4_FC_OVERHEAD	(2 * sizeof(struct ext4_fc_tl) +	\
+				 sizeof(struct ext4_fc_inode) +		\
+				 sizeof(struct ext4_fc_tail))
+
+#endif	/* _EXT4_FAST_COMMIT_H */
@@ -114,7 +114,15 @@ int ext4_sync_file(struct file *file, int datasync)
 	if (ext4_should_journal_data(inode))
 		return ext4_force_commit(inode->i_sb);
 
+	/*
+	 * If only this inode's own fields changed, a fast commit of the
+	 * raw inode saves committing the whole transaction.
+	 */
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
+	if (test_opt(inode->i_sb, JOURNAL_FAST_COMMIT) &&
+	    !ext4_fc_commit(inode, commit_tid))
+		return 0;
+
 	if (jbd2_log_start_commit(journal, commit_tid)) {
 		/*
 		 * When the journal is on a different device than the
@@ -1039,6 +1039,7 @@ got:
 		}
 	}
 
+	ext4_fc_mark_ineligible(handle, inode);
 	err = ext4_mark_inode_dirty(handle, inode);
 	if (err) {
 		ext4_std_error(sb, err);
@@ -5095,6 +5095,11 @@ struct inode *ext4_iget(struct super_block *sb, unsigned long ino)
 		spin_unlock(&journal->j_state_lock);
 		ei->i_sync_tid = tid;
 		ei->i_datasync_tid = tid;
+		/*
+		 * Whatever the transaction did to the inode before it was
+		 * evicted is not known: keep it out of fast commits.
+		 */
+		ei->i_fc_ineligible_tid = tid;
 	}
 
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE) {
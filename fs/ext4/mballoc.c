@@ -4524,6 +4524,9 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 	ext4_debug("freeing block %llu\n", block);
 	trace_ext4_free_blocks(inode, block, count, flags);
 
+	/* Fast commit replay only ever marks blocks in use */
+	ext4_fc_mark_ineligible(handle, inode);
+
 	if (flags & EXT4_FREE_BLOCKS_FORGET) {
 		struct buffer_head *tbh = bh;
 		int i;
@@ -4639,6 +4642,13 @@ do_more:
 		mb_clear_bits(bitmap_bh->b_data, bit, count);
 		ext4_mb_free_metadata(handle, &e4b, new_entry);
 	} else {
+		/*
+		 * Data blocks are reusable at once, so another inode can
+		 * pick them up in this transaction; a fast commit of that
+		 * inode would cross-link the two files after replay.
+		 */
+		ext4_fc_mark_sb_ineligible(handle, sb);
+
 		/* need to update group_info->bb_free and bitmap
 		 * with group lock held. generate_buddy look at
 		 * them with group lock_held
@@ -1990,6 +1990,7 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	if (!ext4_handle_valid(handle))
 		return 0;
 
+	ext4_fc_mark_ineligible(handle, inode);
 	mutex_lock(&EXT4_SB(sb)->s_orphan_lock);
 	if (!list_empty(&EXT4_I(inode)->i_orphan))
 		goto out_unlock;
@@ -2072,6 +2073,7 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 	if (handle && !ext4_handle_valid(handle))
 		return 0;
 
+	ext4_fc_mark_ineligible(handle, inode);
 	mutex_lock(&EXT4_SB(inode->i_sb)->s_orphan_lock);
 	if (list_empty(&ei->i_orphan))
 		goto out;
@@ -2236,6 +2238,7 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 	dir->i_ctime = dir->i_mtime = ext4_current_time(dir);
 	ext4_update_dx_flag(dir);
 	ext4_mark_inode_dirty(handle, dir);
+	ext4_fc_mark_ineligible(handle, inode);
 	drop_nlink(inode);
 	if (!inode->i_nlink)
 		ext4_orphan_add(handle, inode);
@@ -2339,6 +2342,7 @@ retry:
 		ext4_handle_sync(handle);
 
 	inode->i_ctime = ext4_current_time(inode);
+	ext4_fc_mark_ineligible(handle, inode);
 	ext4_inc_count(handle, inode);
 	atomic_inc(&inode->i_count);
 
@@ -2403,6 +2407,9 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 		goto end_rename;
 
 	new_inode = new_dentry->d_inode;
+	ext4_fc_mark_ineligible(handle, old_inode);
+	if (new_inode)
+		ext4_fc_mark_ineligible(handle, new_inode);
 	new_bh = ext4_find_entry(new_dir, &new_dentry->d_name, &new_de);
 	if (new_bh) {
 		if (!new_inode) {
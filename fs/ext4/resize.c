@@ -790,6 +790,7 @@ int ext4_group_add(struct super_block *sb, struct ext4_new_group_data *input)
 		goto exit_put;
 	}
 
+	ext4_fc_mark_sb_ineligible(handle, sb);
 	mutex_lock(&sbi->s_resize_lock);
 	if (input->group != sbi->s_groups_count) {
 		ext4_warning(sb, "multiple resizers run on filesystem!");
@@ -1028,6 +1029,7 @@ int ext4_group_extend(struct super_block *sb, struct ext4_super_block *es,
 		goto exit_put;
 	}
 
+	ext4_fc_mark_sb_ineligible(handle, sb);
 	mutex_lock(&EXT4_SB(sb)->s_resize_lock);
 	if (o_blocks_count != ext4_blocks_count(es)) {
 		ext4_warning(sb, "multiple resizers run on filesystem!");
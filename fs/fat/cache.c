@@ -13,11 +13,27 @@
 #include <linux/buffer_head.h>
 #include "fat.h"
 
+/*
+ * Each cache is an extent of the cluster chain: nr_contig + 1 clusters
+ * that are contiguous both in the file and on disk.  Small files keep up
+ * to FAT_MAX_CACHE of them; larger ones get one per 2^FAT_CACHE_SHIFT
+ * clusters of file size, up to FAT_MAX_CACHE_LARGE, so that seeking in a
+ * fragmented multi-GB file finds a nearby extent instead of walking the
+ * chain from the start.  The caches are on an LRU list for replacement
+ * and in an rbtree by file cluster for lookup.
+ */
+
 /* this must be > 0. */
-#define FAT_MAX_CACHE	8
+#define FAT_MAX_CACHE		8
+#define FAT_MAX_CACHE_LARGE	1024
+#define FAT_CACHE_SHIFT		6
+
+/* walk length above which the FAT is read ahead along the chain */
+#define FAT_CHAIN_READA_MIN	128
 
 struct fat_cache {
 	struct list_head cache_list;
+	struct rb_node cache_node;
 	int nr_contig;	/* number of contiguous clusters */
 	int fcluster;	/* cluster number in the file. */
 	int dcluster;	/* cluster number on disk. */
@@ -32,7 +48,11 @@ struct fat_cache_id {
 
 static inline int fat_max_cache(struct inode *inode)
 {
-	return FAT_MAX_CACHE;
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+	loff_t nr;
+
+	nr = i_size_read(inode) >> (sbi->cluster_bits + FAT_CACHE_SHIFT);
+	return clamp_t(loff_t, nr, FAT_MAX_CACHE, FAT_MAX_CACHE_LARGE);
 }
 
 static struct kmem_cache *fat_cache_cachep;
@@ -78,29 +98,56 @@ static inline void fat_cache_update_lru(struct inode *inode,
 		list_move(&cache->cache_list, &MSDOS_I(inode)->cache_lru);
 }
 
+/* Find the cache with the largest fcluster not above "fclus". */
+static struct fat_cache *fat_cache_find(struct inode *inode, int fclus)
+{
+	struct rb_node *n = MSDOS_I(inode)->cache_tree.rb_node;
+	struct fat_cache *p, *hit = NULL;
+
+	while (n) {
+		p = rb_entry(n, struct fat_cache, cache_node);
+		if (p->fcluster <= fclus) {
+			hit = p;
+			n = n->rb_right;
+		} else
+			n = n->rb_left;
+	}
+	return hit;
+}
+
+static void fat_cache_insert(struct inode *inode, struct fat_cache *cache)
+{
+	struct rb_root *root = &MSDOS_I(inode)->cache_tree;
+	struct rb_node **p = &root->rb_node, *parent = NULL;
+
+	while (*p) {
+		parent = *p;
+		if (cache->fcluster <
+		    rb_entry(parent, struct fat_cache, cache_node)->fcluster)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+	rb_link_node(&cache->cache_node, parent, p);
+	rb_insert_color(&cache->cache_node, root);
+}
+
 static int fat_cache_lookup(struct inode *inode, int fclus,
 			    struct fat_cache_id *cid,
 			    int *cached_fclus, int *cached_dclus)
 {
-	static struct fat_cache nohit = { .fcluster = 0, };
-
-	struct fat_cache *hit = &nohit, *p;
+	struct fat_cache *hit;
 	int offset = -1;
 
 	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the cache of "fclus" or nearest cache. */
-		if (p->fcluster <= fclus && hit->fcluster < p->fcluster) {
-			hit = p;
-			if ((hit->fcluster + hit->nr_contig) < fclus) {
-				offset = hit->nr_contig;
-			} else {
-				offset = fclus - hit->fcluster;
-				break;
-			}
-		}
-	}
-	if (hit != &nohit) {
+	/* Find the cache of "fclus" or nearest cache. */
+	hit = fat_cache_find(inode, fclus);
+	if (hit) {
+		if ((hit->fcluster + hit->nr_contig) < fclus)
+			offset = hit->nr_contig;
+		else
+			offset = fclus - hit->fcluster;
+
 		fat_cache_update_lru(inode, hit);
 
 		cid->id = MSDOS_I(inode)->cache_valid_id;
@@ -120,14 +167,13 @@ static struct fat_cache *fat_cache_merge(struct inode *inode,
 {
 	struct fat_cache *p;
 
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the same part as "new" in cluster-chain. */
-		if (p->fcluster == new->fcluster) {
-			BUG_ON(p->dcluster != new->dcluster);
-			if (new->nr_contig > p->nr_contig)
-				p->nr_contig = new->nr_contig;
-			return p;
-		}
+	/* Find the same part as "new" in cluster-chain. */
+	p = fat_cache_find(inode, new->fcluster);
+	if (p && p->fcluster == new->fcluster) {
+		BUG_ON(p->dcluster != new->dcluster);
+		if (new->nr_contig > p->nr_contig)
+			p->nr_contig = new->nr_contig;
+		return p;
 	}
 	return NULL;
 }
@@ -162,10 +208,12 @@ static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
 		} else {
 			struct list_head *p = MSDOS_I(inode)->cache_lru.prev;
 			cache = list_entry(p, struct fat_cache, cache_list);
+			rb_erase(&cache->cache_node, &MSDOS_I(inode)->cache_tree);
 		}
 		cache->fcluster = new->fcluster;
 		cache->dcluster = new->dcluster;
 		cache->nr_contig = new->nr_contig;
+		fat_cache_insert(inode, cache);
 	}
 out_update_lru:
 	fat_cache_update_lru(inode, cache);
@@ -188,6 +236,7 @@ static void __fat_cache_inval_inode(struct inode *inode)
 		i->nr_caches--;
 		fat_cache_free(cache);
 	}
+	i->cache_tree = RB_ROOT;
 	/* Update. The copy of caches before this id is discarded. */
 	i->cache_valid_id++;
 	if (i->cache_valid_id == FAT_CACHE_VALID)
@@ -203,8 +252,10 @@ void fat_cache_inval_inode(struct inode *inode)
 
 static inline int cache_contiguous(struct fat_cache_id *cid, int dclus)
 {
+	if ((cid->dcluster + cid->nr_contig + 1) != dclus)
+		return 0;
 	cid->nr_contig++;
-	return ((cid->dcluster + cid->nr_contig) == dclus);
+	return 1;
 }
 
 static inline void cache_init(struct fat_cache_id *cid, int fclus, int dclus)
@@ -221,6 +272,7 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 	const int limit = sb->s_maxbytes >> MSDOS_SB(sb)->cluster_bits;
 	struct fat_entry fatent;
 	struct fat_cache_id cid;
+	sector_t ra_start = 0, ra_end = 0;
 	int nr;
 
 	BUG_ON(MSDOS_I(inode)->i_start == 0);
@@ -250,6 +302,9 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 			goto out;
 		}
 
+		if (cluster - *fclus > FAT_CHAIN_READA_MIN)
+			fat_ent_reada_chain(sb, *dclus, &ra_start, &ra_end);
+
 		nr = fat_ent_read(inode, &fatent, *dclus);
 		if (nr < 0)
 			goto out;
@@ -265,8 +320,11 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		}
 		(*fclus)++;
 		*dclus = nr;
-		if (!cache_contiguous(&cid, *dclus))
+		if (!cache_contiguous(&cid, *dclus)) {
+			/* keep every extent passed, not only the last one */
+			fat_cache_add(inode, &cid);
 			cache_init(&cid, *fclus, *dclus);
+		}
 	}
 	nr = 0;
 	fat_cache_add(inode, &cid);
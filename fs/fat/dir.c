@@ -18,6 +18,8 @@
 #include <linux/time.h>
 #include <linux/buffer_head.h>
 #include <linux/compat.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 #include <asm/uaccess.h>
 #include <linux/kernel.h>
 #include "fat.h"
@@ -28,6 +30,7 @@
  * For msdos style, ['.' (hidden) + MSDOS_NAME + '.' + nul]
  */
 #define FAT_MAX_SHORT_SIZE	((MSDOS_NAME + 1) * NLS_MAX_CHARSET_SIZE + 1)
+
 /*
  * Maximum buffer size of unicode chars from slots.
  * [(max longname slots * 13 (size in a slot) + nul) * sizeof(wchar_t)]
@@ -67,6 +70,8 @@ static inline void fat_dir_readahead(struct inode *dir, sector_t iblock,
 	brelse(bh);
 }
 
+static void fat_dcache_io_error(struct inode *dir);
+
 /* Returns the inode number of the directory entry at offset pos. If bh is
    non-NULL, it is brelse'd before. Pos is incremented. The buffer header is
    returned in bh.
@@ -85,8 +90,10 @@ static int fat__get_entry(struct inode *dir, loff_t *pos,
 	unsigned long mapped_blocks;
 	int err, offset;
 #if 1	//Gaoping merge 20101215 if card is remove or read error ,donn't read any more
-	if(mmc_blk_check_valid(sb->s_bdev) != 0)		
-		return -1;	
+	if(mmc_blk_check_valid(sb->s_bdev) != 0) {
+		fat_dcache_io_error(dir);
+		return -1;
+	}
 #endif
 next:
 	if (*bh)
@@ -95,8 +102,11 @@ next:
 	*bh = NULL;
 	iblock = *pos >> sb->s_blocksize_bits;
 	err = fat_bmap(dir, iblock, &phys, &mapped_blocks, 0);
-	if (err || !phys)
+	if (err || !phys) {
+		if (err)
+			fat_dcache_io_error(dir);
 		return -1;	/* beyond EOF or error */
+	}
 
 	fat_dir_readahead(dir, iblock, phys);
 
@@ -104,6 +114,7 @@ next:
 	if (*bh == NULL) {
 		printk(KERN_ERR "FAT: Directory bread(block %llu) failed\n",
 		       (llu)phys);
+		fat_dcache_io_error(dir);
 		/* skip this block */
 		*pos = (iblock + 1) << sb->s_blocksize_bits;
 #if 1	//Gaoping merge 20101215 if card is remove or read error ,donn't read any more
@@ -342,11 +353,191 @@ parse_long:
 }
 
 /*
- * Return values: negative -> error, 0 -> not found, positive -> found,
- * value is the total amount of slots, including the shortname entry.
+ * Name cache of a large directory.
+ *
+ * Looking up a long name means decoding every record of the directory,
+ * and adding one means scanning it for free slots, which gets slow for
+ * directories of thousands of files such as a camera's DCIM folders.  So
+ * the first lookup in a directory of FAT_DCACHE_MIN_ENTRIES entries or more
+ * scans it once, hashing the short and the long name of every record,
+ * and noting which slots are free.  A lookup then only decodes the
+ * records whose hash matches, and fat_add_entries() starts at a run of
+ * free slots long enough for the new record.
+ *
+ * The raw 11-byte short names are hashed as well, so that picking a free
+ * short alias for a new long name does not need a scan of its own.
+ *
+ * fat_add_entries() and fat_remove_entries() keep the cache up to date,
+ * under lock_super() like its users.  If that fails, the cache is dropped
+ * and rebuilt by a later lookup.  So it is if a directory block could not
+ * be read, as the cache could then miss names.
  */
-int fat_search_long(struct inode *inode, const unsigned char *name,
-		    int name_len, struct fat_slot_info *sinfo)
+#define FAT_DCACHE_MIN_ENTRIES	256
+#define FAT_DCACHE_MAX_HASH	4096
+
+struct fat_dcache_name {
+	struct hlist_node node;
+	unsigned int hash;
+	unsigned short slot;		/* first slot of the record */
+	unsigned char nr_slots;		/* slots in the record */
+};
+
+struct fat_dcache_short {
+	struct hlist_node node;
+	unsigned short slot;		/* slot of the short entry */
+	unsigned char name[MSDOS_NAME];	/* as on disk */
+};
+
+struct fat_dcache {
+	unsigned int hash_mask;
+	int io_error;			/* a directory block was unreadable */
+	struct hlist_head *short_hash;	/* hash_mask + 1 heads after hash */
+	/* bit set: the slot is free */
+	unsigned long free_map[BITS_TO_LONGS(FAT_MAX_DIR_ENTRIES)];
+	struct hlist_head hash[0];
+};
+
+static struct kmem_cache *fat_dcache_cachep;
+static struct kmem_cache *fat_dcache_short_cachep;
+
+int __init fat_dcache_init(void)
+{
+	fat_dcache_cachep = kmem_cache_create("fat_dcache_name",
+				sizeof(struct fat_dcache_name),
+				0, SLAB_RECLAIM_ACCOUNT|SLAB_MEM_SPREAD,
+				NULL);
+	if (fat_dcache_cachep == NULL)
+		return -ENOMEM;
+	fat_dcache_short_cachep = kmem_cache_create("fat_dcache_short",
+				sizeof(struct fat_dcache_short),
+				0, SLAB_RECLAIM_ACCOUNT|SLAB_MEM_SPREAD,
+				NULL);
+	if (fat_dcache_short_cachep == NULL) {
+		kmem_cache_destroy(fat_dcache_cachep);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+void fat_dcache_destroy(void)
+{
+	kmem_cache_destroy(fat_dcache_short_cachep);
+	kmem_cache_destroy(fat_dcache_cachep);
+}
+
+static void fat_dcache_io_error(struct inode *dir)
+{
+	struct fat_dcache *dc = MSDOS_I(dir)->i_dcache;
+
+	if (dc)
+		dc->io_error = 1;
+}
+
+/* Must give equal hashes to the names fat_name_match() finds equal. */
+static unsigned int fat_dcache_hash(struct msdos_sb_info *sbi,
+				    const unsigned char *name, int len)
+{
+	unsigned long hash = init_name_hash();
+
+	if (sbi->options.name_check != 's') {
+		while (len--)
+			hash = partial_name_hash(nls_tolower(sbi->nls_io,
+							     *name++), hash);
+	} else {
+		while (len--)
+			hash = partial_name_hash(*name++, hash);
+	}
+	return end_name_hash(hash);
+}
+
+static int fat_dcache_record(struct inode *dir, struct fat_dcache *dc,
+			     int add, const unsigned char *name, int len,
+			     unsigned int slot, unsigned char nr_slots)
+{
+	unsigned int hash = fat_dcache_hash(MSDOS_SB(dir->i_sb), name, len);
+	struct hlist_head *head = &dc->hash[hash & dc->hash_mask];
+	struct fat_dcache_name *p;
+	struct hlist_node *pos;
+
+	if (!add) {
+		hlist_for_each_entry(p, pos, head, node) {
+			if (p->hash == hash && p->slot == slot) {
+				hlist_del(&p->node);
+				kmem_cache_free(fat_dcache_cachep, p);
+				break;
+			}
+		}
+		return 0;
+	}
+
+	p = kmem_cache_alloc(fat_dcache_cachep, GFP_NOFS);
+	if (!p)
+		return -ENOMEM;
+	p->hash = hash;
+	p->slot = slot;
+	p->nr_slots = nr_slots;
+	hlist_add_head(&p->node, head);
+	return 0;
+}
+
+/* Add or delete the short entry in @slot, whose raw name is @name. */
+static int fat_dcache_short(struct fat_dcache *dc, int add,
+			    const unsigned char *name, unsigned int slot)
+{
+	unsigned int hash = full_name_hash(name, MSDOS_NAME);
+	struct hlist_head *head = &dc->short_hash[hash & dc->hash_mask];
+	struct fat_dcache_short *p;
+	struct hlist_node *pos;
+
+	if (!add) {
+		hlist_for_each_entry(p, pos, head, node) {
+			if (p->slot == slot) {
+				hlist_del(&p->node);
+				kmem_cache_free(fat_dcache_short_cachep, p);
+				break;
+			}
+		}
+		return 0;
+	}
+
+	p = kmem_cache_alloc(fat_dcache_short_cachep, GFP_NOFS);
+	if (!p)
+		return -ENOMEM;
+	p->slot = slot;
+	memcpy(p->name, name, MSDOS_NAME);
+	hlist_add_head(&p->node, head);
+	return 0;
+}
+
+void fat_dcache_free(struct inode *dir)
+{
+	struct fat_dcache *dc = MSDOS_I(dir)->i_dcache;
+	struct fat_dcache_name *p;
+	struct fat_dcache_short *sp;
+	struct hlist_node *pos, *n;
+	unsigned int i;
+
+	if (!dc)
+		return;
+	MSDOS_I(dir)->i_dcache = NULL;
+	for (i = 0; i <= dc->hash_mask; i++) {
+		hlist_for_each_entry_safe(p, pos, n, &dc->hash[i], node)
+			kmem_cache_free(fat_dcache_cachep, p);
+		hlist_for_each_entry_safe(sp, pos, n, &dc->short_hash[i], node)
+			kmem_cache_free(fat_dcache_short_cachep, sp);
+	}
+	vfree(dc);
+}
+
+/*
+ * Walk the records in [cpos, end) of the directory.  Without @dc, look
+ * for @name: return values as for fat_search_long().  With @dc, add (@add)
+ * or delete the names of all those records in the name cache instead.
+ */
+static int fat_search_range(struct inode *inode, loff_t cpos, loff_t end,
+			    const unsigned char *name, int name_len,
+			    struct fat_slot_info *sinfo,
+			    struct fat_dcache *dc, int add)
 {
 	struct super_block *sb = inode->i_sb;
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -359,11 +550,11 @@ int fat_search_long(struct inode *inode, const unsigned char *name,
 	unsigned char work[MSDOS_NAME];
 	unsigned char bufname[FAT_MAX_SHORT_SIZE];
 	unsigned short opt_shortname = sbi->options.shortname;
-	loff_t cpos = 0;
+	unsigned int slot;
 	int chl, i, j, last_u, err, len;
 
-	err = -ENOENT;
-	while (1) {
+	err = dc ? 0 : -ENOENT;
+	while (cpos < end) {
 		if (fat_get_entry(inode, &cpos, &bh, &de) == -1)
 			goto end_of_dir;
 parse_record:
@@ -387,7 +578,6 @@ parse_record:
 			else if (status == PARSE_EOF)
 				goto end_of_dir;
 		}
-
 		memcpy(work, de->name, sizeof(de->name));
 		/* see namei.c, msdos_format_name */
 		if (work[0] == 0x05)
@@ -429,7 +619,13 @@ parse_record:
 		/* Compare shortname */
 		bufuname[last_u] = 0x0000;
 		len = fat_uni_to_x8(sbi, bufuname, bufname, sizeof(bufname));
-		if (fat_name_match(sbi, name, name_len, bufname, len))
+		slot = (cpos >> MSDOS_DIR_BITS) - (nr_slots + 1);
+		if (dc) {
+			err = fat_dcache_record(inode, dc, add, bufname, len,
+						slot, nr_slots + 1);
+			if (err)
+				break;
+		} else if (fat_name_match(sbi, name, name_len, bufname, len))
 			goto found;
 
 		if (nr_slots) {
@@ -438,10 +634,20 @@ parse_record:
 
 			/* Compare longname */
 			len = fat_uni_to_x8(sbi, unicode, longname, size);
-			if (fat_name_match(sbi, name, name_len, longname, len))
+			if (dc) {
+				err = fat_dcache_record(inode, dc, add,
+							longname, len, slot,
+							nr_slots + 1);
+				if (err)
+					break;
+			} else if (fat_name_match(sbi, name, name_len,
+						  longname, len))
 				goto found;
 		}
 	}
+	/* reached the end of the range */
+	brelse(bh);
+	goto end_of_dir;
 
 found:
 	nr_slots++;	/* include the de */
@@ -458,6 +664,216 @@ end_of_dir:
 	return err;
 }
 
+/*
+ * Return the name cache of the directory, building it if it is worth it.
+ * Returns NULL if there is none, or ERR_PTR(-EIO) if the directory could
+ * not be read in full.
+ */
+static struct fat_dcache *fat_dcache_get(struct inode *dir)
+{
+	struct fat_dcache *dc = MSDOS_I(dir)->i_dcache;
+	struct buffer_head *bh = NULL;
+	struct msdos_dir_entry *de;
+	unsigned int nr_entries, nr_hash, i, slot;
+	loff_t pos;
+	int err;
+
+	if (dc && !dc->io_error)
+		return dc;
+	fat_dcache_free(dir);
+
+	nr_entries = dir->i_size >> MSDOS_DIR_BITS;
+	if (nr_entries < FAT_DCACHE_MIN_ENTRIES ||
+	    dir->i_size > FAT_MAX_DIR_SIZE)
+		return NULL;
+
+	nr_hash = min_t(unsigned int, roundup_pow_of_two(nr_entries / 2),
+			FAT_DCACHE_MAX_HASH);
+	dc = vmalloc(sizeof(*dc) + 2 * nr_hash * sizeof(struct hlist_head));
+	if (!dc)
+		return NULL;
+	memset(dc->free_map, 0, sizeof(dc->free_map));
+	dc->hash_mask = nr_hash - 1;
+	dc->io_error = 0;
+	dc->short_hash = dc->hash + nr_hash;
+	for (i = 0; i < 2 * nr_hash; i++)
+		INIT_HLIST_HEAD(&dc->hash[i]);
+	MSDOS_I(dir)->i_dcache = dc;
+
+	err = 0;
+	pos = 0;
+	while (fat_get_entry(dir, &pos, &bh, &de) > -1) {
+		slot = (pos >> MSDOS_DIR_BITS) - 1;
+		if (IS_FREE(de->name))
+			__set_bit(slot, dc->free_map);
+		else if (!(de->attr & ATTR_VOLUME)) {
+			/* the entries fat_scan() looks at */
+			err = fat_dcache_short(dc, 1, de->name, slot);
+			if (err)
+				break;
+		}
+	}
+	brelse(bh);
+
+	if (!err)
+		err = fat_search_range(dir, 0, FAT_MAX_DIR_SIZE, NULL, 0,
+				       NULL, dc, 1);
+	if (!err && dc->io_error)
+		err = -EIO;
+	if (err) {
+		fat_dcache_free(dir);
+		return err == -EIO ? ERR_PTR(err) : NULL;
+	}
+	return dc;
+}
+
+/*
+ * Return whether @dir has a short entry named @name, like fat_scan() but
+ * from the name cache if there is a valid one.
+ */
+int fat_short_name_exists(struct inode *dir, const unsigned char *name)
+{
+	struct fat_dcache *dc = MSDOS_I(dir)->i_dcache;
+	struct fat_slot_info sinfo;
+	struct fat_dcache_short *p;
+	struct hlist_node *pos;
+	unsigned int hash;
+
+	if (!dc || dc->io_error) {
+		if (fat_scan(dir, name, &sinfo))
+			return 0;
+		brelse(sinfo.bh);
+		return 1;
+	}
+
+	hash = full_name_hash(name, MSDOS_NAME);
+	hlist_for_each_entry(p, pos, &dc->short_hash[hash & dc->hash_mask],
+			     node) {
+		if (!memcmp(p->name, name, MSDOS_NAME))
+			return 1;
+	}
+	return 0;
+}
+
+EXPORT_SYMBOL_GPL(fat_short_name_exists);
+
+static int fat_dcache_search(struct inode *dir, struct fat_dcache *dc,
+			     const unsigned char *name, int name_len,
+			     struct fat_slot_info *sinfo)
+{
+	unsigned int hash = fat_dcache_hash(MSDOS_SB(dir->i_sb), name, name_len);
+	struct fat_dcache_name *p;
+	struct hlist_node *pos;
+	loff_t start;
+	int err;
+
+	hlist_for_each_entry(p, pos, &dc->hash[hash & dc->hash_mask], node) {
+		if (p->hash != hash)
+			continue;
+
+		start = (loff_t)p->slot << MSDOS_DIR_BITS;
+		err = fat_search_range(dir, start,
+				       start + (p->nr_slots << MSDOS_DIR_BITS),
+				       name, name_len, sinfo, NULL, 0);
+		if (err == -ENOENT)
+			continue;
+		else if (err)
+			return err;
+		/* it must be the very record which was cached */
+		if (sinfo->slot_off == start && sinfo->nr_slots == p->nr_slots)
+			return 0;
+		brelse(sinfo->bh);
+	}
+	return -ENOENT;
+}
+
+/*
+ * Return where fat_add_entries() should start looking for @nr_slots free
+ * slots: the first run of them, or else the run which ends the directory,
+ * or else its last slot, to be followed by new clusters.
+ */
+static loff_t fat_dcache_find_free(struct inode *dir, struct fat_dcache *dc,
+				   int nr_slots)
+{
+	unsigned long nr_entries = dir->i_size >> MSDOS_DIR_BITS;
+	unsigned long start = 0, end = 0;
+
+	while ((start = find_next_bit(dc->free_map, nr_entries, start))
+	       < nr_entries) {
+		end = find_next_zero_bit(dc->free_map, nr_entries, start);
+		if (end - start >= nr_slots || end == nr_entries)
+			return (loff_t)start << MSDOS_DIR_BITS;
+		start = end;
+	}
+	return (loff_t)(nr_entries - 1) << MSDOS_DIR_BITS;
+}
+
+/*
+ * Slots [pos, pos + nr_slots) now hold a new record, whose short entry is
+ * @de, and the directory may have grown from old_size.
+ */
+static void fat_dcache_added(struct inode *dir, loff_t pos, int nr_slots,
+			     struct msdos_dir_entry *de, loff_t old_size)
+{
+	struct fat_dcache *dc = MSDOS_I(dir)->i_dcache;
+	unsigned long slot;
+
+	if (dir->i_size > FAT_MAX_DIR_SIZE) {
+		fat_dcache_free(dir);
+		return;
+	}
+	for (slot = old_size >> MSDOS_DIR_BITS;
+	     slot < (dir->i_size >> MSDOS_DIR_BITS); slot++)
+		__set_bit(slot, dc->free_map);
+	for (slot = pos >> MSDOS_DIR_BITS;
+	     slot < (pos >> MSDOS_DIR_BITS) + nr_slots; slot++)
+		__clear_bit(slot, dc->free_map);
+
+	if (fat_dcache_short(dc, 1, de->name, slot - 1) ||
+	    fat_search_range(dir, pos, pos + (nr_slots << MSDOS_DIR_BITS),
+			     NULL, 0, NULL, dc, 1))
+		fat_dcache_free(dir);
+}
+
+/*
+ * The record in slots [pos, pos + nr_slots), whose short entry is @de,
+ * is about to be removed.
+ */
+static void fat_dcache_removed(struct inode *dir, loff_t pos, int nr_slots,
+			       struct msdos_dir_entry *de)
+{
+	struct fat_dcache *dc = MSDOS_I(dir)->i_dcache;
+	unsigned long slot;
+
+	fat_dcache_short(dc, 0, de->name,
+			 (pos >> MSDOS_DIR_BITS) + nr_slots - 1);
+	if (fat_search_range(dir, pos, pos + (nr_slots << MSDOS_DIR_BITS),
+			     NULL, 0, NULL, dc, 0)) {
+		fat_dcache_free(dir);
+		return;
+	}
+	for (slot = pos >> MSDOS_DIR_BITS;
+	     slot < (pos >> MSDOS_DIR_BITS) + nr_slots; slot++)
+		__set_bit(slot, dc->free_map);
+}
+
+/*
+ * Return values: negative -> error, 0 -> not found, positive -> found,
+ * value is the total amount of slots, including the shortname entry.
+ */
+int fat_search_long(struct inode *inode, const unsigned char *name,
+		    int name_len, struct fat_slot_info *sinfo)
+{
+	struct fat_dcache *dc = fat_dcache_get(inode);
+
+	if (IS_ERR(dc))
+		return PTR_ERR(dc);
+	if (dc)
+		return fat_dcache_search(inode, dc, name, name_len, sinfo);
+	return fat_search_range(inode, 0, LLONG_MAX, name, name_len,
+				sinfo, NULL, 0);
+}
+
 EXPORT_SYMBOL_GPL(fat_search_long);
 
 struct fat_ioctl_filldir_callback {
@@ -1001,6 +1417,10 @@ int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo)
 	struct buffer_head *bh;
 	int err = 0, nr_slots;
 
+	if (MSDOS_I(dir)->i_dcache)
+		fat_dcache_removed(dir, sinfo->slot_off, sinfo->nr_slots,
+				   sinfo->de);
+
 	/*
 	 * First stage: Remove the shortname. By this, the directory
 	 * entry is removed.
@@ -1248,15 +1668,16 @@ int fat_add_entries(struct inode *dir, void *slots, int nr_slots,
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 	struct buffer_head *bh, *prev, *bhs[3]; /* 32*slots (672bytes) */
 	struct msdos_dir_entry *de;
+	struct fat_dcache *dc = MSDOS_I(dir)->i_dcache;
 	int err, free_slots, i, nr_bhs;
-	loff_t pos, i_pos;
+	loff_t pos, i_pos, old_size = dir->i_size;
 
 	sinfo->nr_slots = nr_slots;
 
 	/* First stage: search free direcotry entries */
 	free_slots = nr_bhs = 0;
 	bh = prev = NULL;
-	pos = 0;
+	pos = dc ? fat_dcache_find_free(dir, dc, nr_slots) : 0;
 	err = -ENOSPC;
 	while (fat_get_entry(dir, &pos, &bh, &de) > -1) {
 		/* check the maximum size of directory */
@@ -1360,6 +1781,10 @@ found:
 	sinfo->bh = bh;
 	sinfo->i_pos = fat_make_i_pos(sb, sinfo->bh, sinfo->de);
 
+	if (dc)
+		fat_dcache_added(dir, pos, sinfo->nr_slots, sinfo->de,
+				 old_size);
+
 	return 0;
 
 error:
@@ -1369,6 +1794,7 @@ error:
 	return err;
 
 error_remove:
+	fat_dcache_free(dir);
 	brelse(bh);
 	if (free_slots)
 		__fat_remove_entries(dir, pos, free_slots);
@@ -6,6 +6,8 @@
 #include <linux/nls.h>
 #include <linux/fs.h>
 #include <linux/mutex.h>
+#include <linux/completion.h>
+#include <linux/rbtree.h>
 #include <linux/ratelimit.h>
 #include <linux/msdos_fs.h>
 
@@ -46,7 +48,8 @@ struct fat_mount_options {
 		 usefree:1,	  /* Use free_clusters for FAT32 */
 		 tz_utc:1,	  /* Filesystem timestamps are in UTC */
 		 rodir:1,	  /* allow ATTR_RO for directory */
-		 discard:1;	  /* Issue discard requests on deletions */
+		 discard:1,	  /* Issue discard requests on deletions */
+		 freemap:1;	  /* Keep a bitmap of free clusters in memory */
 };
 
 #define FAT_HASH_BITS	8
@@ -72,6 +75,11 @@ struct msdos_sb_info {
 	unsigned int prev_free;      /* previously allocated cluster number */
 	unsigned int free_clusters;  /* -1 if undefined */
 	unsigned int free_clus_valid; /* is free_clusters valid? */
+	unsigned long *free_map;     /* bitmap of free clusters, or NULL */
+	unsigned int free_map_scanned; /* free_map is valid below this */
+	unsigned int free_map_count; /* free clusters below free_map_scanned */
+	int free_map_stop;	     /* ask the free_map builder to stop */
+	struct completion free_map_done; /* free_map builder has finished */
 	struct fat_mount_options options;
 	struct nls_table *nls_disk;  /* Codepage used on disk */
 	struct nls_table *nls_io;    /* Charset used for input and display */
@@ -98,6 +106,7 @@ struct msdos_sb_info {
 struct msdos_inode_info {
 	spinlock_t cache_lru_lock;
 	struct list_head cache_lru;
+	struct rb_root cache_tree;	/* the same caches, by file cluster */
 	int nr_caches;
 	/* for avoiding the race between fat_free() and fat_get_cluster() */
 	unsigned int cache_valid_id;
@@ -105,6 +114,8 @@ struct msdos_inode_info {
 	/* NOTE: mmu_private is 64bits, so must hold ->i_mutex to access */
 	loff_t mmu_private;	/* physically allocated size */
 
+	int i_alloc_hint;	/* last cluster allocated to this file or 0 */
+	struct fat_dcache *i_dcache;	/* name cache of a large directory */
 	int i_start;		/* first cluster or 0 */
 	int i_logstart;		/* logical first cluster */
 	int i_attrs;		/* unused attribute bits */
@@ -251,6 +262,11 @@ extern int fat_alloc_new_dir(struct inode *dir, struct timespec *ts);
 extern int fat_add_entries(struct inode *dir, void *slots, int nr_slots,
 			   struct fat_slot_info *sinfo);
 extern int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo);
+extern void fat_dcache_free(struct inode *dir);
+extern int fat_short_name_exists(struct inode *dir,
+				 const unsigned char *name);
+extern int fat_dcache_init(void);
+extern void fat_dcache_destroy(void);
 
 /* fat/fatent.c */
 struct fat_entry {
@@ -296,10 +312,14 @@ extern int fat_ent_read(struct inode *inode, struct fat_entry *fatent,
 			int entry);
 extern int fat_ent_write(struct inode *inode, struct fat_entry *fatent,
 			 int new, int wait);
+extern void fat_ent_reada_chain(struct super_block *sb, int entry,
+				sector_t *ra_start, sector_t *ra_end);
 extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+extern void fat_free_map_start(struct super_block *sb);
+extern void fat_free_map_stop(struct super_block *sb);
 
 /* fat/file.c */
 extern long fat_generic_ioctl(struct file *filp, unsigned int cmd,
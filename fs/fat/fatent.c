@@ -7,6 +7,8 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/kthread.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -452,6 +454,80 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/*
+ * With the "freemap" mount option, a bitmap of free clusters is kept in
+ * memory: bit n is set while cluster n is free.  It is filled in by a
+ * kernel thread started at mount time, and the part of it below
+ * ->free_map_scanned is kept up to date under lock_fat().  Allocation
+ * uses it only once it covers the whole FAT.
+ */
+static inline int fat_free_map_ready(struct msdos_sb_info *sbi)
+{
+	return sbi->free_map && sbi->free_map_scanned >= sbi->max_cluster;
+}
+
+static inline void fat_free_map_update(struct msdos_sb_info *sbi,
+				       int entry, int free)
+{
+	if (!sbi->free_map || entry >= sbi->free_map_scanned)
+		return;
+	if (free) {
+		__set_bit(entry, sbi->free_map);
+		sbi->free_map_count++;
+	} else {
+		__clear_bit(entry, sbi->free_map);
+		sbi->free_map_count--;
+	}
+}
+
+/* Free clusters in a row wanted when a growing file has to jump */
+#define FAT_EXTENT_MIN		16
+
+/*
+ * Choose the next cluster to allocate from the free map.  A file being
+ * extended carries on right after its last cluster if that is free;
+ * failing that, it moves to the first run of at least FAT_EXTENT_MIN free
+ * clusters, so that large writes are laid out in long extents rather than
+ * filling single-cluster holes.  A file's first cluster is simply the next
+ * free one after prev_free, which keeps small files packed together.
+ * Returns -1 if there is no free cluster at all.
+ */
+static int fat_free_map_pick(struct msdos_sb_info *sbi, int goal)
+{
+	unsigned long start, limit, pos, end;
+	int first = -1, wrapped = 0;
+
+	if (goal >= FAT_START_ENT && goal < sbi->max_cluster &&
+	    test_bit(goal, sbi->free_map))
+		return goal;
+
+	start = sbi->prev_free + 1;
+	if (start < FAT_START_ENT || start >= sbi->max_cluster)
+		start = FAT_START_ENT;
+	limit = sbi->max_cluster;
+	pos = start;
+	for (;;) {
+		pos = find_next_bit(sbi->free_map, limit, pos);
+		if (pos >= limit) {
+			if (wrapped)
+				break;
+			wrapped = 1;
+			limit = start;
+			pos = FAT_START_ENT;
+			continue;
+		}
+		if (first < 0)
+			first = pos;
+		if (!goal)
+			break;
+		end = find_next_zero_bit(sbi->free_map, limit, pos);
+		if (end - pos >= FAT_EXTENT_MIN)
+			return pos;
+		pos = end;
+	}
+	return first;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -474,6 +550,50 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
+
+	if (fat_free_map_ready(sbi)) {
+		int goal = MSDOS_I(inode)->i_alloc_hint;
+
+		if (goal)
+			goal++;
+		while (idx_clus < nr_cluster) {
+			int entry = fat_free_map_pick(sbi, goal);
+
+			if (entry < 0)
+				goto nospc;
+			fatent_set_entry(&fatent, entry);
+			err = fat_ent_read_block(sb, &fatent);
+			if (err)
+				goto out;
+
+			fat_free_map_update(sbi, entry, 0);
+			if (ops->ent_get(&fatent) != FAT_ENT_FREE) {
+				/* out of step with the disk: skip it */
+				goal = entry + 1;
+				continue;
+			}
+
+			ops->ent_put(&fatent, FAT_ENT_EOF);
+			if (prev_ent.nr_bhs)
+				ops->ent_put(&prev_ent, entry);
+
+			fat_collect_bhs(bhs, &nr_bhs, &fatent);
+
+			sbi->prev_free = entry;
+			if (sbi->free_clusters != -1)
+				sbi->free_clusters--;
+			sb->s_dirt = 1;
+
+			cluster[idx_clus] = entry;
+			idx_clus++;
+			MSDOS_I(inode)->i_alloc_hint = entry;
+			goal = entry + 1;
+
+			prev_ent = fatent;
+		}
+		goto out;
+	}
+
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -494,6 +614,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 					ops->ent_put(&prev_ent, entry);
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
+				fat_free_map_update(sbi, entry, 0);
 
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
@@ -517,6 +638,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
@@ -584,6 +706,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_update(sbi, fatent.entry, 1);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -638,6 +761,39 @@ static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
 		sb_breadahead(sb, blocknr + i);
 }
 
+/* FAT read ahead at a time while following a cluster chain */
+#define FAT_CHAIN_READA_SIZE	(32 * 1024)
+
+/*
+ * Read ahead the FAT blocks starting at the one holding @entry, unless it
+ * is already within [*ra_start, *ra_end), the window read ahead last time.
+ * A long cluster chain mostly moves forward through the FAT, so this lets
+ * its walk be served by a few large reads instead of one read per block.
+ */
+void fat_ent_reada_chain(struct super_block *sb, int entry,
+			 sector_t *ra_start, sector_t *ra_end)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	sector_t blocknr, fat_end;
+	unsigned long nr, i;
+	int offset;
+
+	sbi->fatent_ops->ent_blocknr(sb, entry, &offset, &blocknr);
+	if (blocknr >= *ra_start && blocknr < *ra_end)
+		return;
+
+	fat_end = sbi->fat_start + sbi->fat_length;
+	if (blocknr >= fat_end)
+		return;
+	nr = min_t(sector_t, FAT_CHAIN_READA_SIZE >> sb->s_blocksize_bits,
+		   fat_end - blocknr);
+	for (i = 0; i < nr; i++)
+		sb_breadahead(sb, blocknr + i);
+
+	*ra_start = blocknr;
+	*ra_end = blocknr + nr;
+}
+
 int fat_count_free_clusters(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -646,6 +802,10 @@ int fat_count_free_clusters(struct super_block *sb)
 	unsigned long reada_blocks, reada_mask, cur_block;
 	int err = 0, free;
 
+	/* the free map builder is counting them already */
+	if (sbi->free_map)
+		wait_for_completion(&sbi->free_map_done);
+
 	lock_fat(sbi);
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
@@ -682,3 +842,106 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+static int fat_free_map_thread(void *data)
+{
+	struct super_block *sb = data;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, reada_mask, cur_block;
+	int err = 0;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster && !sbi->free_map_stop) {
+		/* readahead of fat blocks */
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		/* one block at a time, so that allocation is not held up */
+		lock_fat(sbi);
+		err = fat_ent_read_block(sb, &fatent);
+		if (err) {
+			unlock_fat(sbi);
+			break;
+		}
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
+				__set_bit(fatent.entry, sbi->free_map);
+				sbi->free_map_count++;
+			}
+		} while (fat_ent_next(sbi, &fatent));
+		sbi->free_map_scanned = min_t(unsigned int, fatent.entry,
+					      sbi->max_cluster);
+		unlock_fat(sbi);
+
+		cond_resched();
+	}
+	fatent_brelse(&fatent);
+
+	lock_fat(sbi);
+	if (fat_free_map_ready(sbi)) {
+		sbi->free_clusters = sbi->free_map_count;
+		sbi->free_clus_valid = 1;
+		sb->s_dirt = 1;
+	} else if (err)
+		printk(KERN_WARNING "FAT: free cluster map of %s unavailable "
+		       "(error %d)\n", sb->s_id, err);
+	unlock_fat(sbi);
+
+	complete_all(&sbi->free_map_done);
+	return 0;
+}
+
+/*
+ * Start building the free cluster map in the background.  If that cannot
+ * be done, the filesystem simply works without one.
+ */
+void fat_free_map_start(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct task_struct *task;
+	size_t size;
+
+	size = BITS_TO_LONGS(sbi->max_cluster) * sizeof(long);
+	sbi->free_map = vmalloc(size);
+	if (!sbi->free_map)
+		goto fail;
+	memset(sbi->free_map, 0, size);
+	sbi->free_map_scanned = FAT_START_ENT;
+	sbi->free_map_count = 0;
+	sbi->free_map_stop = 0;
+	init_completion(&sbi->free_map_done);
+
+	task = kthread_run(fat_free_map_thread, sb, "fatmap-%s", sb->s_id);
+	if (IS_ERR(task)) {
+		vfree(sbi->free_map);
+		sbi->free_map = NULL;
+		goto fail;
+	}
+	return;
+
+fail:
+	printk(KERN_WARNING "FAT: not enough memory for the free cluster map"
+	       " of %s\n", sb->s_id);
+}
+
+void fat_free_map_stop(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	if (!sbi->free_map)
+		return;
+	sbi->free_map_stop = 1;
+	wait_for_completion(&sbi->free_map_done);
+	vfree(sbi->free_map);
+	sbi->free_map = NULL;
+}
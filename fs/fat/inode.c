@@ -459,6 +459,7 @@ static void fat_delete_inode(struct inode *inode)
 static void fat_clear_inode(struct inode *inode)
 {
 	fat_cache_inval_inode(inode);
+	fat_dcache_free(inode);
 	fat_detach(inode);
 }
 
@@ -492,6 +493,8 @@ static void fat_put_super(struct super_block *sb)
 
 	lock_kernel();
 
+	fat_free_map_stop(sb);
+
 	if (sb->s_dirt)
 		fat_write_super(sb);
 
@@ -517,14 +520,22 @@ static struct inode *fat_alloc_inode(struct super_block *sb)
 	ei = kmem_cache_alloc(fat_inode_cachep, GFP_NOFS);
 	if (!ei)
 		return NULL;
+	ei->i_alloc_hint = 0;
+	ei->i_dcache = NULL;
 	return &ei->vfs_inode;
 }
 
-static void fat_destroy_inode(struct inode *inode)
+static void fat_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
 	kmem_cache_free(fat_inode_cachep, MSDOS_I(inode));
 }
 
+static void fat_destroy_inode(struct inode *inode)
+{
+	call_rcu(&inode->i_rcu, fat_i_callback);
+}
+
 static void init_once(void *foo)
 {
 	struct msdos_inode_info *ei = (struct msdos_inode_info *)foo;
@@ -533,6 +544,7 @@ static void init_once(void *foo)
 	ei->nr_caches = 0;
 	ei->cache_valid_id = FAT_CACHE_VALID + 1;
 	INIT_LIST_HEAD(&ei->cache_lru);
+	ei->cache_tree = RB_ROOT;
 	INIT_HLIST_NODE(&ei->i_fat_hash);
 	inode_init_once(&ei->vfs_inode);
 }
@@ -551,6 +563,7 @@ static int __init fat_init_inodecache(void)
 
 static void __exit fat_destroy_inodecache(void)
 {
+	rcu_barrier();
 	kmem_cache_destroy(fat_inode_cachep);
 }
 
@@ -888,6 +901,8 @@ static int fat_show_options(struct seq_file *m, struct vfsmount *mnt)
 		seq_puts(m, ",errors=remount-ro");
 	if (opts->discard)
 		seq_puts(m, ",discard");
+	if (opts->freemap)
+		seq_puts(m, ",freemap");
 
 	return 0;
 }
@@ -901,7 +916,7 @@ enum {
 	Opt_shortname_winnt, Opt_shortname_mixed, Opt_utf8_no, Opt_utf8_yes,
 	Opt_uni_xl_no, Opt_uni_xl_yes, Opt_nonumtail_no, Opt_nonumtail_yes,
 	Opt_obsolate, Opt_flush, Opt_tz_utc, Opt_rodir, Opt_err_cont,
-	Opt_err_panic, Opt_err_ro, Opt_discard, Opt_err,
+	Opt_err_panic, Opt_err_ro, Opt_discard, Opt_freemap, Opt_err,
 };
 
 static const match_table_t fat_tokens = {
@@ -930,6 +945,7 @@ static const match_table_t fat_tokens = {
 	{Opt_err_panic, "errors=panic"},
 	{Opt_err_ro, "errors=remount-ro"},
 	{Opt_discard, "discard"},
+	{Opt_freemap, "freemap"},
 	{Opt_obsolate, "conv=binary"},
 	{Opt_obsolate, "conv=text"},
 	{Opt_obsolate, "conv=auto"},
@@ -1170,6 +1186,9 @@ static int parse_options(char *options, int is_vfat, int silent, int *debug,
 		case Opt_discard:
 			opts->discard = 1;
 			break;
+		case Opt_freemap:
+			opts->freemap = 1;
+			break;
 
 		/* obsolete mount options */
 		case Opt_obsolate:
@@ -1518,6 +1537,9 @@ int fat_fill_super(struct super_block *sb, void *data, int silent,
 		goto out_fail;
 	}
 
+	if (sbi->options.freemap)
+		fat_free_map_start(sb);
+
 	return 0;
 
 out_invalid:
@@ -1600,12 +1622,18 @@ static int __init init_fat_fs(void)
 	if (err)
 		return err;
 
-	err = fat_init_inodecache();
+	err = fat_dcache_init();
 	if (err)
 		goto failed;
 
+	err = fat_init_inodecache();
+	if (err)
+		goto failed_dcache;
+
 	return 0;
 
+failed_dcache:
+	fat_dcache_destroy();
 failed:
 	fat_cache_destroy();
 	return err;
@@ -1614,6 +1642,7 @@ failed:
 static void __exit exit_fat_fs(void)
 {
 	fat_cache_destroy();
+	fat_dcache_destroy();
 	fat_destroy_inodecache();
 }
 
@@ -114,7 +114,7 @@ static int vfat_hash(struct dentry *dentry, struct qstr *qstr)
  */
 static int vfat_hashi(struct dentry *dentry, struct qstr *qstr)
 {
-	struct nls_table *t = MSDOS_SB(dentry->d_inode->i_sb)->nls_io;
+	struct nls_table *t = MSDOS_SB(dentry->d_sb)->nls_io;
 	const unsigned char *name;
 	unsigned int len;
 	unsigned long hash;
@@ -135,7 +135,7 @@ static int vfat_hashi(struct dentry *dentry, struct qstr *qstr)
  */
 static int vfat_cmpi(struct dentry *dentry, struct qstr *a, struct qstr *b)
 {
-	struct nls_table *t = MSDOS_SB(dentry->d_inode->i_sb)->nls_io;
+	struct nls_table *t = MSDOS_SB(dentry->d_sb)->nls_io;
 	unsigned int alen, blen;
 
 	/* A filename cannot end in '.' or we treat it like it has none */
@@ -214,11 +214,8 @@ static inline int vfat_is_used_badchars(const wchar_t *s, int len)
 
 static int vfat_find_form(struct inode *dir, unsigned char *name)
 {
-	struct fat_slot_info sinfo;
-	int err = fat_scan(dir, name, &sinfo);
-	if (err)
+	if (!fat_short_name_exists(dir, name))
 		return -ENOENT;
-	brelse(sinfo.bh);
 	return 0;
 }
 
@@ -1080,7 +1077,7 @@ static struct file_system_type vfat_fs_type = {
 	.name		= "vfat",
 	.get_sb		= vfat_get_sb,
 	.kill_sb	= kill_block_super,
-	.fs_flags	= FS_REQUIRES_DEV,
+	.fs_flags	= FS_REQUIRES_DEV | FS_RCU_WALK,
 };
 
 static int __init init_vfat_fs(void)
@@ -25,15 +25,27 @@ MODULE_ALIAS("devname:fuse");
 
 static struct kmem_cache *fuse_req_cachep;
 
-static struct fuse_conn *fuse_get_conn(struct file *file)
+static struct fuse_chan *fuse_get_chan(struct file *file)
 {
 	/*
 	 * Lockless access is OK, because file->private data is set
-	 * once during mount and is valid until the file is released.
+	 * once during mount or clone and is valid until the file is
+	 * released.
 	 */
 	return file->private_data;
 }
 
+void fuse_chan_init(struct fuse_chan *chan, struct fuse_conn *fc)
+{
+	int i;
+
+	chan->fc = fc;
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&chan->processing[i]);
+	INIT_LIST_HEAD(&chan->io);
+	INIT_LIST_HEAD(&chan->entry);
+}
+
 static void fuse_request_init(struct fuse_req *req)
 {
 	memset(req, 0, sizeof(*req));
@@ -237,6 +249,11 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+static unsigned fuse_req_hash(u64 unique)
+{
+	return unique & (FUSE_PQ_HASH_SIZE - 1);
+}
+
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
 	req->in.h.unique = fuse_get_unique(fc);
@@ -953,9 +970,10 @@ __releases(&fc->lock)
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_chan *chan, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
+	struct fuse_conn *fc = chan->fc;
 	int err;
 	struct fuse_req *req;
 	struct fuse_in *in;
@@ -984,7 +1002,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 
 	req = list_entry(fc->pending.next, struct fuse_req, list);
 	req->state = FUSE_REQ_READING;
-	list_move(&req->list, &fc->io);
+	list_move(&req->list, &chan->io);
 
 	in = &req->in;
 	reqsize = in->h.len;
@@ -1019,7 +1037,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		request_end(fc, req);
 	else {
 		req->state = FUSE_REQ_SENT;
-		list_move_tail(&req->list, &fc->processing);
+		list_move_tail(&req->list,
+			       &chan->processing[fuse_req_hash(in->h.unique)]);
 		if (req->interrupted)
 			queue_interrupt(fc, req);
 		spin_unlock(&fc->lock);
@@ -1036,13 +1055,13 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, const struct iovec *iov,
 {
 	struct fuse_copy_state cs;
 	struct file *file = iocb->ki_filp;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(file);
+	if (!chan)
 		return -EPERM;
 
-	fuse_copy_init(&cs, fc, 1, iov, nr_segs);
+	fuse_copy_init(&cs, chan->fc, 1, iov, nr_segs);
 
-	return fuse_dev_do_read(fc, file, &cs, iov_length(iov, nr_segs));
+	return fuse_dev_do_read(chan, file, &cs, iov_length(iov, nr_segs));
 }
 
 static int fuse_dev_pipe_buf_steal(struct pipe_inode_info *pipe,
@@ -1070,18 +1089,18 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int do_wakeup = 0;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc = fuse_get_conn(in);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(in);
+	if (!chan)
 		return -EPERM;
 
 	bufs = kmalloc(pipe->buffers * sizeof (struct pipe_buffer), GFP_KERNEL);
 	if (!bufs)
 		return -ENOMEM;
 
-	fuse_copy_init(&cs, fc, 1, NULL, 0);
+	fuse_copy_init(&cs, chan->fc, 1, NULL, 0);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fc, in, &cs, len);
+	ret = fuse_dev_do_read(chan, in, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -1251,16 +1270,36 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 }
 
 /* Look up request on processing list by unique ID */
-static struct fuse_req *request_find(struct fuse_conn *fc, u64 unique)
+static struct fuse_req *request_find(struct fuse_chan *chan, u64 unique)
 {
-	struct list_head *entry;
+	struct fuse_conn *fc = chan->fc;
+	unsigned hash = fuse_req_hash(unique);
+	struct fuse_req *req;
+	int i;
 
-	list_for_each(entry, &fc->processing) {
-		struct fuse_req *req;
-		req = list_entry(entry, struct fuse_req, list);
-		if (req->in.h.unique == unique || req->intr_unique == unique)
+	list_for_each_entry(req, &chan->processing[hash], list) {
+		if (req->in.h.unique == unique)
 			return req;
 	}
+
+	/*
+	 * Not answered on the channel it was read from, or a reply to
+	 * an interrupt: these are rare, search for them the slow way
+	 */
+	list_for_each_entry(chan, &fc->chans, entry) {
+		list_for_each_entry(req, &chan->processing[hash], list) {
+			if (req->in.h.unique == unique)
+				return req;
+		}
+	}
+	list_for_each_entry(chan, &fc->chans, entry) {
+		for (i = 0; i < FUSE_PQ_HASH_SIZE; i++) {
+			list_for_each_entry(req, &chan->processing[i], list) {
+				if (req->intr_unique == unique)
+					return req;
+			}
+		}
+	}
 	return NULL;
 }
 
@@ -1294,9 +1333,10 @@ static int copy_out_args(struct fuse_copy_state *cs, struct fuse_out *out,
  * it from the list and copy the rest of the buffer to the request.
  * The request is finished by calling request_end()
  */
-static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
+static ssize_t fuse_dev_do_write(struct fuse_chan *chan,
 				 struct fuse_copy_state *cs, size_t nbytes)
 {
+	struct fuse_conn *fc = chan->fc;
 	int err;
 	struct fuse_req *req;
 	struct fuse_out_header oh;
@@ -1330,7 +1370,7 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	if (!fc->connected)
 		goto err_unlock;
 
-	req = request_find(fc, oh.unique);
+	req = request_find(chan, oh.unique);
 	if (!req)
 		goto err_unlock;
 
@@ -1358,7 +1398,7 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	}
 
 	req->state = FUSE_REQ_WRITING;
-	list_move(&req->list, &fc->io);
+	list_move(&req->list, &chan->io);
 	req->out.h = oh;
 	req->locked = 1;
 	cs->req = req;
@@ -1391,13 +1431,13 @@ static ssize_t fuse_dev_write(struct kiocb *iocb, const struct iovec *iov,
 			      unsigned long nr_segs, loff_t pos)
 {
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc = fuse_get_conn(iocb->ki_filp);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(iocb->ki_filp);
+	if (!chan)
 		return -EPERM;
 
-	fuse_copy_init(&cs, fc, 0, iov, nr_segs);
+	fuse_copy_init(&cs, chan->fc, 0, iov, nr_segs);
 
-	return fuse_dev_do_write(fc, &cs, iov_length(iov, nr_segs));
+	return fuse_dev_do_write(chan, &cs, iov_length(iov, nr_segs));
 }
 
 static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
@@ -1408,12 +1448,12 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	unsigned idx;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc;
+	struct fuse_chan *chan;
 	size_t rem;
 	ssize_t ret;
 
-	fc = fuse_get_conn(out);
-	if (!fc)
+	chan = fuse_get_chan(out);
+	if (!chan)
 		return -EPERM;
 
 	bufs = kmalloc(pipe->buffers * sizeof (struct pipe_buffer), GFP_KERNEL);
@@ -1460,14 +1500,14 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	}
 	pipe_unlock(pipe);
 
-	fuse_copy_init(&cs, fc, 0, NULL, nbuf);
+	fuse_copy_init(&cs, chan->fc, 0, NULL, nbuf);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
 
 	if (flags & SPLICE_F_MOVE)
 		cs.move_pages = 1;
 
-	ret = fuse_dev_do_write(fc, &cs, len);
+	ret = fuse_dev_do_write(chan, &cs, len);
 
 	for (idx = 0; idx < nbuf; idx++) {
 		struct pipe_buffer *buf = &bufs[idx];
@@ -1481,10 +1521,12 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(file);
+	struct fuse_conn *fc;
+	if (!chan)
 		return POLLERR;
 
+	fc = chan->fc;
 	poll_wait(file, &fc->waitq, wait);
 
 	spin_lock(&fc->lock);
@@ -1530,9 +1572,16 @@ static void end_io_requests(struct fuse_conn *fc)
 __releases(&fc->lock)
 __acquires(&fc->lock)
 {
-	while (!list_empty(&fc->io)) {
+	struct fuse_chan *chan;
+	LIST_HEAD(io);
+
+	/* Channels may go away while the lock is dropped below */
+	list_for_each_entry(chan, &fc->chans, entry)
+		list_splice_tail_init(&chan->io, &io);
+
+	while (!list_empty(&io)) {
 		struct fuse_req *req =
-			list_entry(fc->io.next, struct fuse_req, list);
+			list_entry(io.next, struct fuse_req, list);
 		void (*end) (struct fuse_conn *, struct fuse_req *) = req->end;
 
 		req->aborted = 1;
@@ -1552,12 +1601,27 @@ __acquires(&fc->lock)
 	}
 }
 
+static void splice_processing(struct fuse_chan *chan, struct list_head *head)
+{
+	int i;
+
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
+		list_splice_tail_init(&chan->processing[i], head);
+}
+
 static void end_queued_requests(struct fuse_conn *fc)
+__releases(&fc->lock)
+__acquires(&fc->lock)
 {
+	struct fuse_chan *chan;
+	LIST_HEAD(processing);
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
 	end_requests(fc, &fc->pending);
-	end_requests(fc, &fc->processing);
+	list_for_each_entry(chan, &fc->chans, entry)
+		splice_processing(chan, &processing);
+	end_requests(fc, &processing);
 }
 
 /*
@@ -1595,16 +1659,32 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+/*
+ * Closing a channel aborts the requests it was processing, since nobody
+ * is left to answer them.  Closing the last channel of the connection
+ * disconnects it.
+ */
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (fc) {
+	struct fuse_chan *chan = fuse_get_chan(file);
+	if (chan) {
+		struct fuse_conn *fc = chan->fc;
+		LIST_HEAD(processing);
+
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		end_queued_requests(fc);
-		wake_up_all(&fc->blocked_waitq);
+		if (fc->nr_chans == 1) {
+			fc->connected = 0;
+			fc->blocked = 0;
+			end_queued_requests(fc);
+			wake_up_all(&fc->blocked_waitq);
+		}
+		list_del_init(&chan->entry);
+		fc->nr_chans--;
+		splice_processing(chan, &processing);
+		end_requests(fc, &processing);
 		spin_unlock(&fc->lock);
+		if (chan != &fc->chan)
+			kfree(chan);
 		fuse_conn_put(fc);
 	}
 
@@ -1614,12 +1694,83 @@ EXPORT_SYMBOL_GPL(fuse_dev_release);
 
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(file);
+	if (!chan)
 		return -EPERM;
 
 	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fc->fasync);
+	return fasync_helper(fd, file, on, &chan->fc->fasync);
+}
+
+/*
+ * Attach a newly opened /dev/fuse file to the connection of an
+ * existing one, so that a daemon thread can read and answer requests
+ * on a channel of its own.
+ */
+static int fuse_dev_clone(struct file *file, struct fuse_conn *fc)
+{
+	struct fuse_chan *chan;
+	int err;
+
+	chan = kmalloc(sizeof(*chan), GFP_KERNEL);
+	if (!chan)
+		return -ENOMEM;
+	fuse_chan_init(chan, fc);
+
+	mutex_lock(&fuse_mutex);
+	err = -EINVAL;
+	if (file->private_data)
+		goto err_unlock;
+
+	spin_lock(&fc->lock);
+	err = -ENOTCONN;
+	if (fc->connected) {
+		list_add_tail(&chan->entry, &fc->chans);
+		fc->nr_chans++;
+		err = 0;
+	}
+	spin_unlock(&fc->lock);
+	if (err)
+		goto err_unlock;
+
+	file->private_data = chan;
+	fuse_conn_get(fc);
+	mutex_unlock(&fuse_mutex);
+
+	return 0;
+
+ err_unlock:
+	mutex_unlock(&fuse_mutex);
+	kfree(chan);
+	return err;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct fuse_chan *chan;
+	struct file *old;
+	u32 oldfd;
+	int err;
+
+	if (cmd != FUSE_DEV_IOC_CLONE)
+		return -ENOTTY;
+
+	if (get_user(oldfd, (u32 __user *) arg))
+		return -EFAULT;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EINVAL;
+
+	/* Only channels of the same kind of device can be cloned */
+	err = -EINVAL;
+	chan = fuse_get_chan(old);
+	if (old->f_op == file->f_op && chan)
+		err = fuse_dev_clone(file, chan->fc);
+	fput(old);
+
+	return err;
 }
 
 const struct file_operations fuse_dev_operations = {
@@ -1634,6 +1785,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
@@ -783,6 +783,13 @@ static void fuse_fillattr(struct inode *inode, struct fuse_attr *attr,
 	stat->size = attr->size;
 	stat->blocks = attr->blocks;
 	stat->blksize = (1 << inode->i_blkbits);
+
+	if (get_fuse_conn(inode)->writeback_cache && S_ISREG(inode->i_mode)) {
+		/* The kernel knows better while writes are cached */
+		stat->mtime = inode->i_mtime;
+		stat->ctime = inode->i_ctime;
+		stat->size = i_size_read(inode);
+	}
 }
 
 static int fuse_do_getattr(struct inode *inode, struct kstat *stat,
@@ -1260,10 +1267,12 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 {
 	struct inode *inode = entry->d_inode;
 	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
 	struct fuse_req *req;
 	struct fuse_setattr_in inarg;
 	struct fuse_attr_out outarg;
 	bool is_truncate = false;
+	bool is_wb = fc->writeback_cache && S_ISREG(inode->i_mode);
 	loff_t oldsize;
 	int err;
 
@@ -1276,8 +1285,25 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 			return err;
 	}
 
-	if ((attr->ia_valid & ATTR_OPEN) && fc->atomic_o_trunc)
+	if ((attr->ia_valid & ATTR_OPEN) && fc->atomic_o_trunc) {
+		/*
+		 * The filesystem already truncated the file on open, but
+		 * the size kept by the writeback cache must follow.
+		 */
+		if (is_wb) {
+			fuse_set_nowrite(inode);
+			spin_lock(&fc->lock);
+			fi->attr_version = ++fc->attr_version;
+			oldsize = inode->i_size;
+			i_size_write(inode, attr->ia_size);
+			inode->i_mtime = attr->ia_mtime;
+			inode->i_ctime = attr->ia_ctime;
+			__fuse_release_nowrite(inode);
+			spin_unlock(&fc->lock);
+			truncate_pagecache(inode, oldsize, attr->ia_size);
+		}
 		return 0;
+	}
 
 	if (attr->ia_valid & ATTR_SIZE) {
 		err = inode_newsize_ok(inode, attr->ia_size);
@@ -1336,7 +1362,19 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	fuse_change_attributes_common(inode, &outarg.attr,
 				      attr_timeout(&outarg));
 	oldsize = inode->i_size;
-	i_size_write(inode, outarg.attr.size);
+	if (is_wb) {
+		/*
+		 * Cached writes may not have reached the filesystem yet,
+		 * so only take the size from the reply on truncate.
+		 */
+		if (attr->ia_valid & ATTR_MTIME)
+			inode->i_mtime = attr->ia_mtime;
+		if (attr->ia_valid & ATTR_CTIME)
+			inode->i_ctime = attr->ia_ctime;
+		if (is_truncate)
+			i_size_write(inode, outarg.attr.size);
+	} else
+		i_size_write(inode, outarg.attr.size);
 
 	if (is_truncate) {
 		/* NOTE: this may release/reacquire fc->lock */
@@ -1348,9 +1386,10 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	 * Only call invalidate_inode_pages2() after removing
 	 * FUSE_NOWRITE, otherwise fuse_launder_page() would deadlock.
 	 */
-	if (S_ISREG(inode->i_mode) && oldsize != outarg.attr.size) {
-		truncate_pagecache(inode, oldsize, outarg.attr.size);
-		invalidate_inode_pages2(inode->i_mapping);
+	if (S_ISREG(inode->i_mode) && oldsize != inode->i_size) {
+		truncate_pagecache(inode, oldsize, inode->i_size);
+		if (!is_wb)
+			invalidate_inode_pages2(inode->i_mapping);
 	}
 
 	return 0;
@@ -1362,6 +1401,45 @@ error:
 	return err;
 }
 
+int fuse_flush_mtime(struct inode *inode)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_req *req;
+	struct fuse_setattr_in inarg;
+	struct fuse_attr_out outarg;
+	int err;
+
+	if (!fc->writeback_cache || !S_ISREG(inode->i_mode) ||
+	    is_bad_inode(inode))
+		return 0;
+
+	req = fuse_get_req(fc);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+
+	memset(&inarg, 0, sizeof(inarg));
+	memset(&outarg, 0, sizeof(outarg));
+	inarg.valid = FATTR_MTIME;
+	inarg.mtime = inode->i_mtime.tv_sec;
+	inarg.mtimensec = inode->i_mtime.tv_nsec;
+	req->in.h.opcode = FUSE_SETATTR;
+	req->in.h.nodeid = get_node_id(inode);
+	req->in.numargs = 1;
+	req->in.args[0].size = sizeof(inarg);
+	req->in.args[0].value = &inarg;
+	req->out.numargs = 1;
+	if (fc->minor < 9)
+		req->out.args[0].size = FUSE_COMPAT_ATTR_OUT_SIZE;
+	else
+		req->out.args[0].size = sizeof(outarg);
+	req->out.args[0].value = &outarg;
+	fuse_request_send(fc, req);
+	err = req->out.h.error;
+	fuse_put_request(fc, req);
+
+	return err;
+}
+
 static int fuse_setattr(struct dentry *entry, struct iattr *attr)
 {
 	if (attr->ia_valid & ATTR_FILE)
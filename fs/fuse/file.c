@@ -134,6 +134,8 @@ EXPORT_SYMBOL_GPL(fuse_do_open);
 void fuse_finish_open(struct inode *inode, struct file *file)
 {
 	struct fuse_file *ff = file->private_data;
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
 
 	if (ff->open_flags & FOPEN_DIRECT_IO)
 		file->f_op = &fuse_direct_io_file_operations;
@@ -141,11 +143,26 @@ void fuse_finish_open(struct inode *inode, struct file *file)
 		invalidate_inode_pages2(inode->i_mapping);
 	if (ff->open_flags & FOPEN_NONSEEKABLE)
 		nonseekable_open(inode, file);
+	if (fc->writeback_cache && S_ISREG(inode->i_mode) &&
+	    (file->f_mode & FMODE_WRITE)) {
+		/*
+		 * Cached writes are sent from writeback, which needs an
+		 * open file to send them through.
+		 */
+		spin_lock(&fc->lock);
+		if (list_empty(&ff->write_entry))
+			list_add(&ff->write_entry, &fi->write_files);
+		spin_unlock(&fc->lock);
+	}
 }
 
 int fuse_open_common(struct inode *inode, struct file *file, bool isdir)
 {
 	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	bool is_wb_truncate = (file->f_flags & O_TRUNC) &&
+			      fc->atomic_o_trunc && fc->writeback_cache;
+	loff_t oldsize;
 	int err;
 
 	/* VFS checks this, but only _after_ ->open() */
@@ -156,13 +173,38 @@ int fuse_open_common(struct inode *inode, struct file *file, bool isdir)
 	if (err)
 		return err;
 
+	/*
+	 * The filesystem truncates on open: no cached write may reach it
+	 * after that, and the cache must not be laundered back to it.
+	 */
+	if (is_wb_truncate) {
+		mutex_lock(&inode->i_mutex);
+		err = filemap_write_and_wait(inode->i_mapping);
+		if (err)
+			goto out_unlock;
+		fuse_set_nowrite(inode);
+	}
+
 	err = fuse_do_open(fc, get_node_id(inode), file, isdir);
-	if (err)
-		return err;
+	if (!err) {
+		if (is_wb_truncate) {
+			spin_lock(&fc->lock);
+			fi->attr_version = ++fc->attr_version;
+			oldsize = inode->i_size;
+			i_size_write(inode, 0);
+			spin_unlock(&fc->lock);
+			truncate_pagecache(inode, oldsize, 0);
+		}
+		fuse_finish_open(inode, file);
+	}
 
-	fuse_finish_open(inode, file);
+	if (is_wb_truncate)
+		fuse_release_nowrite(inode);
+out_unlock:
+	if (is_wb_truncate)
+		mutex_unlock(&inode->i_mutex);
 
-	return 0;
+	return err;
 }
 
 static void fuse_prepare_release(struct fuse_file *ff, int flags, int opcode)
@@ -219,6 +261,13 @@ static int fuse_open(struct inode *inode, struct file *file)
 
 static int fuse_release(struct inode *inode, struct file *file)
 {
+	/*
+	 * Cached writes go out through an open file: write them back
+	 * while this one is still there to send them.
+	 */
+	if (get_fuse_conn(inode)->writeback_cache)
+		filemap_write_and_wait(inode->i_mapping);
+
 	fuse_release_common(file, FUSE_RELEASE);
 
 	/* return value is ignored by VFS */
@@ -277,7 +326,8 @@ static bool fuse_page_is_writeback(struct inode *inode, pgoff_t index)
 
 		BUG_ON(req->inode != inode);
 		curr_index = req->misc.write.in.offset >> PAGE_CACHE_SHIFT;
-		if (curr_index == index) {
+		if (curr_index <= index &&
+		    index < curr_index + req->num_pages) {
 			found = true;
 			break;
 		}
@@ -301,6 +351,21 @@ static int fuse_wait_on_page_writeback(struct inode *inode, pgoff_t index)
 	return 0;
 }
 
+/*
+ * Wait for all pending writepages on the inode to finish.
+ *
+ * This is currently done by blocking further writes with FUSE_NOWRITE
+ * and waiting for all sent writes to complete.
+ *
+ * This must be called under i_mutex, otherwise the FUSE_NOWRITE usage
+ * could conflict with truncation.
+ */
+static void fuse_sync_writes(struct inode *inode)
+{
+	fuse_set_nowrite(inode);
+	fuse_release_nowrite(inode);
+}
+
 static int fuse_flush(struct file *file, fl_owner_t id)
 {
 	struct inode *inode = file->f_path.dentry->d_inode;
@@ -313,6 +378,21 @@ static int fuse_flush(struct file *file, fl_owner_t id)
 	if (is_bad_inode(inode))
 		return -EIO;
 
+	if (fc->writeback_cache) {
+		/* Report errors of cached writes on close */
+		err = filemap_write_and_wait(file->f_mapping);
+		if (err)
+			return err;
+
+		mutex_lock(&inode->i_mutex);
+		fuse_sync_writes(inode);
+		mutex_unlock(&inode->i_mutex);
+
+		err = filemap_fdatawait(file->f_mapping);
+		if (err)
+			return err;
+	}
+
 	if (fc->no_flush)
 		return 0;
 
@@ -336,21 +416,6 @@ static int fuse_flush(struct file *file, fl_owner_t id)
 	return err;
 }
 
-/*
- * Wait for all pending writepages on the inode to finish.
- *
- * This is currently done by blocking further writes with FUSE_NOWRITE
- * and waiting for all sent writes to complete.
- *
- * This must be called under i_mutex, otherwise the FUSE_NOWRITE usage
- * could conflict with truncation.
- */
-static void fuse_sync_writes(struct inode *inode)
-{
-	fuse_set_nowrite(inode);
-	fuse_release_nowrite(inode);
-}
-
 int fuse_fsync_common(struct file *file, int datasync, int isdir)
 {
 	struct inode *inode = file->f_mapping->host;
@@ -450,6 +515,13 @@ static void fuse_read_update_size(struct inode *inode, loff_t size,
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_inode *fi = get_fuse_inode(inode);
 
+	/*
+	 * With the writeback cache a short read only means that cached
+	 * writes have not reached the filesystem yet.
+	 */
+	if (fc->writeback_cache)
+		return;
+
 	spin_lock(&fc->lock);
 	if (attr_ver == fi->attr_version && size < inode->i_size) {
 		fi->attr_version = ++fc->attr_version;
@@ -458,7 +530,7 @@ static void fuse_read_update_size(struct inode *inode, loff_t size,
 	spin_unlock(&fc->lock);
 }
 
-static int fuse_readpage(struct file *file, struct page *page)
+static int fuse_do_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
 	struct fuse_conn *fc = get_fuse_conn(inode);
@@ -469,10 +541,6 @@ static int fuse_readpage(struct file *file, struct page *page)
 	u64 attr_ver;
 	int err;
 
-	err = -EIO;
-	if (is_bad_inode(inode))
-		goto out;
-
 	/*
 	 * Page writeback can extend beyond the liftime of the
 	 * page-cache page, so make sure we read a properly synced
@@ -481,9 +549,8 @@ static int fuse_readpage(struct file *file, struct page *page)
 	fuse_wait_on_page_writeback(inode, page->index);
 
 	req = fuse_get_req(fc);
-	err = PTR_ERR(req);
 	if (IS_ERR(req))
-		goto out;
+		return PTR_ERR(req);
 
 	attr_ver = fuse_get_attr_version(fc);
 
@@ -506,6 +573,19 @@ static int fuse_readpage(struct file *file, struct page *page)
 	}
 
 	fuse_invalidate_attr(inode); /* atime changed */
+	return err;
+}
+
+static int fuse_readpage(struct file *file, struct page *page)
+{
+	struct inode *inode = page->mapping->host;
+	int err;
+
+	err = -EIO;
+	if (is_bad_inode(inode))
+		goto out;
+
+	err = fuse_do_readpage(file, page);
  out:
 	unlock_page(page);
 	return err;
@@ -699,11 +779,42 @@ static int fuse_write_begin(struct file *file, struct address_space *mapping,
 			struct page **pagep, void **fsdata)
 {
 	pgoff_t index = pos >> PAGE_CACHE_SHIFT;
+	struct inode *inode = mapping->host;
+	struct page *page;
+	int err;
 
-	*pagep = grab_cache_page_write_begin(mapping, index, flags);
-	if (!*pagep)
+	page = grab_cache_page_write_begin(mapping, index, flags);
+	if (!page)
 		return -ENOMEM;
-	return 0;
+	*pagep = page;
+
+	if (!get_fuse_conn(inode)->writeback_cache)
+		return 0;
+
+	/*
+	 * Don't let a cached write overtake a writepage that is still
+	 * in flight for the same page.
+	 */
+	fuse_wait_on_page_writeback(inode, index);
+
+	if (PageUptodate(page) || len == PAGE_CACHE_SIZE)
+		return 0;
+
+	/* Nothing to read if the page starts at or beyond EOF */
+	if (i_size_read(inode) <= (pos & PAGE_CACHE_MASK)) {
+		unsigned offset = pos & ~PAGE_CACHE_MASK;
+
+		if (offset)
+			zero_user_segment(page, 0, offset);
+		return 0;
+	}
+
+	err = fuse_do_readpage(file, page);
+	if (err) {
+		unlock_page(page);
+		page_cache_release(page);
+	}
+	return err;
 }
 
 static void fuse_write_update_size(struct inode *inode, loff_t pos)
@@ -766,7 +877,25 @@ static int fuse_write_end(struct file *file, struct address_space *mapping,
 	struct inode *inode = mapping->host;
 	int res = 0;
 
-	if (copied)
+	if (get_fuse_conn(inode)->writeback_cache) {
+		/* A short copy into a page that was not read is retried */
+		if (!PageUptodate(page) && copied < len)
+			copied = 0;
+		if (copied) {
+			if (!PageUptodate(page)) {
+				/* Zero what was neither read nor written */
+				unsigned end = (pos + copied) & ~PAGE_CACHE_MASK;
+
+				if (end)
+					zero_user_segment(page, end,
+							  PAGE_CACHE_SIZE);
+				SetPageUptodate(page);
+			}
+			fuse_write_update_size(inode, pos + copied);
+			set_page_dirty(page);
+		}
+		res = copied;
+	} else if (copied)
 		res = fuse_buffered_write(file, inode, pos, copied, page);
 
 	unlock_page(page);
@@ -937,6 +1066,15 @@ static ssize_t fuse_file_aio_write(struct kiocb *iocb, const struct iovec *iov,
 
 	WARN_ON(iocb->ki_pos != pos);
 
+	if (get_fuse_conn(inode)->writeback_cache) {
+		/* Refresh mode for suid clearing, the size is kept locally */
+		err = fuse_update_attributes(inode, NULL, file, NULL);
+		if (err)
+			return err;
+
+		return generic_file_aio_write(iocb, iov, nr_segs, pos);
+	}
+
 	err = generic_segment_checks(iov, &nr_segs, &count, VERIFY_READ);
 	if (err)
 		return err;
@@ -1125,7 +1263,10 @@ static ssize_t fuse_direct_write(struct file *file, const char __user *buf,
 
 static void fuse_writepage_free(struct fuse_conn *fc, struct fuse_req *req)
 {
-	__free_page(req->pages[0]);
+	int i;
+
+	for (i = 0; i < req->num_pages; i++)
+		__free_page(req->pages[i]);
 	fuse_file_put(req->ff);
 }
 
@@ -1134,11 +1275,14 @@ static void fuse_writepage_finish(struct fuse_conn *fc, struct fuse_req *req)
 	struct inode *inode = req->inode;
 	struct fuse_inode *fi = get_fuse_inode(inode);
 	struct backing_dev_info *bdi = inode->i_mapping->backing_dev_info;
+	int i;
 
 	list_del(&req->writepages_entry);
-	dec_bdi_stat(bdi, BDI_WRITEBACK);
-	dec_zone_page_state(req->pages[0], NR_WRITEBACK_TEMP);
-	bdi_writeout_inc(bdi);
+	for (i = 0; i < req->num_pages; i++) {
+		dec_bdi_stat(bdi, BDI_WRITEBACK);
+		dec_zone_page_state(req->pages[i], NR_WRITEBACK_TEMP);
+		bdi_writeout_inc(bdi);
+	}
 	wake_up(&fi->page_waitq);
 }
 
@@ -1150,14 +1294,15 @@ __acquires(&fc->lock)
 	struct fuse_inode *fi = get_fuse_inode(req->inode);
 	loff_t size = i_size_read(req->inode);
 	struct fuse_write_in *inarg = &req->misc.write.in;
+	__u64 data_size = req->num_pages * PAGE_CACHE_SIZE;
 
 	if (!fc->connected)
 		goto out_free;
 
-	if (inarg->offset + PAGE_CACHE_SIZE <= size) {
-		inarg->size = PAGE_CACHE_SIZE;
+	if (inarg->offset + data_size <= size) {
+		inarg->size = data_size;
 	} else if (inarg->offset < size) {
-		inarg->size = size & (PAGE_CACHE_SIZE - 1);
+		inarg->size = size - inarg->offset;
 	} else {
 		/* Got truncated off completely */
 		goto out_free;
@@ -1219,6 +1364,7 @@ static int fuse_writepage_locked(struct page *page)
 	struct fuse_req *req;
 	struct fuse_file *ff;
 	struct page *tmp_page;
+	int err = -ENOMEM;
 
 	set_page_writeback(page);
 
@@ -1231,7 +1377,13 @@ static int fuse_writepage_locked(struct page *page)
 		goto err_free;
 
 	spin_lock(&fc->lock);
-	BUG_ON(list_empty(&fi->write_files));
+	if (list_empty(&fi->write_files)) {
+		/* No open file left to send it through */
+		spin_unlock(&fc->lock);
+		__free_page(tmp_page);
+		err = -EIO;
+		goto err_free;
+	}
 	ff = list_entry(fi->write_files.next, struct fuse_file, write_entry);
 	req->ff = fuse_file_get(ff);
 	spin_unlock(&fc->lock);
@@ -1263,19 +1415,175 @@ err_free:
 	fuse_request_free(req);
 err:
 	end_page_writeback(page);
-	return -ENOMEM;
+	return err;
+}
+
+/*
+ * Two WRITEs of the same page could reach the filesystem in either order,
+ * so a page whose earlier write is still in flight is redirtied by
+ * background writeback and waited for by data integrity writeback.
+ * Returns true if the page was skipped; it is unlocked then.
+ */
+static bool fuse_skip_page_in_flight(struct page *page,
+				     struct writeback_control *wbc)
+{
+	struct inode *inode = page->mapping->host;
+
+	if (!fuse_page_is_writeback(inode, page->index))
+		return false;
+
+	if (wbc->sync_mode == WB_SYNC_ALL) {
+		fuse_wait_on_page_writeback(inode, page->index);
+		return false;
+	}
+
+	redirty_page_for_writepage(wbc, page);
+	unlock_page(page);
+	return true;
 }
 
 static int fuse_writepage(struct page *page, struct writeback_control *wbc)
 {
 	int err;
 
+	if (fuse_skip_page_in_flight(page, wbc))
+		return 0;
+
 	err = fuse_writepage_locked(page);
+	if (err)
+		redirty_page_for_writepage(wbc, page);
 	unlock_page(page);
 
 	return err;
 }
 
+struct fuse_fill_wb_data {
+	struct fuse_req *req;
+	struct fuse_file *ff;
+	struct inode *inode;
+};
+
+static void fuse_writepages_send(struct fuse_fill_wb_data *data)
+{
+	struct fuse_req *req = data->req;
+	struct inode *inode = data->inode;
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	req->ff = fuse_file_get(data->ff);
+	spin_lock(&fc->lock);
+	list_add_tail(&req->list, &fi->queued_writes);
+	fuse_flush_writepages(inode);
+	spin_unlock(&fc->lock);
+}
+
+/*
+ * Collect contiguous dirty pages into one WRITE request, up to max_write
+ * bytes.  Like fuse_writepage_locked() each page is copied to a temporary
+ * page, so page-cache writeback ends without waiting for userspace.
+ */
+static int fuse_writepages_fill(struct page *page,
+		struct writeback_control *wbc, void *_data)
+{
+	struct fuse_fill_wb_data *data = _data;
+	struct fuse_req *req = data->req;
+	struct inode *inode = data->inode;
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct page *tmp_page;
+	int err = -ENOMEM;
+
+	if (fuse_skip_page_in_flight(page, wbc))
+		return 0;
+
+	if (req && (req->num_pages == FUSE_MAX_PAGES_PER_REQ ||
+		    (req->num_pages + 1) * PAGE_CACHE_SIZE > fc->max_write ||
+		    req->misc.write.in.offset +
+		    req->num_pages * PAGE_CACHE_SIZE != page_offset(page))) {
+		fuse_writepages_send(data);
+		data->req = req = NULL;
+	}
+
+	tmp_page = alloc_page(GFP_NOFS | __GFP_HIGHMEM);
+	if (!tmp_page)
+		goto out_redirty;
+
+	if (!req) {
+		req = fuse_request_alloc_nofs();
+		if (!req) {
+			__free_page(tmp_page);
+			goto out_redirty;
+		}
+
+		fuse_write_fill(req, data->ff, page_offset(page), 0);
+		req->misc.write.in.write_flags |= FUSE_WRITE_CACHE;
+		req->in.argpages = 1;
+		req->page_offset = 0;
+		req->end = fuse_writepage_end;
+		req->inode = inode;
+
+		spin_lock(&fc->lock);
+		list_add(&req->writepages_entry, &fi->writepages);
+		spin_unlock(&fc->lock);
+
+		data->req = req;
+	}
+
+	set_page_writeback(page);
+	copy_highpage(tmp_page, page);
+
+	spin_lock(&fc->lock);
+	req->pages[req->num_pages] = tmp_page;
+	req->num_pages++;
+	spin_unlock(&fc->lock);
+
+	inc_bdi_stat(page->mapping->backing_dev_info, BDI_WRITEBACK);
+	inc_zone_page_state(tmp_page, NR_WRITEBACK_TEMP);
+	end_page_writeback(page);
+	unlock_page(page);
+	return 0;
+
+out_redirty:
+	redirty_page_for_writepage(wbc, page);
+	unlock_page(page);
+	return err;
+}
+
+static int fuse_writepages(struct address_space *mapping,
+			   struct writeback_control *wbc)
+{
+	struct inode *inode = mapping->host;
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct fuse_fill_wb_data data;
+	int err;
+
+	if (is_bad_inode(inode))
+		return -EIO;
+
+	data.inode = inode;
+	data.req = NULL;
+
+	spin_lock(&fc->lock);
+	if (list_empty(&fi->write_files)) {
+		spin_unlock(&fc->lock);
+		return -EIO;
+	}
+	data.ff = list_entry(fi->write_files.next, struct fuse_file,
+			     write_entry);
+	fuse_file_get(data.ff);
+	spin_unlock(&fc->lock);
+
+	err = write_cache_pages(mapping, wbc, fuse_writepages_fill, &data);
+	if (data.req) {
+		/* Whatever was collected before an error still goes out */
+		fuse_writepages_send(&data);
+	}
+	fuse_file_put(data.ff);
+
+	return err;
+}
+
 static int fuse_launder_page(struct page *page)
 {
 	int err = 0;
@@ -2021,6 +2329,7 @@ static const struct file_operations fuse_direct_io_file_operations = {
 static const struct address_space_operations fuse_file_aops  = {
 	.readpage	= fuse_readpage,
 	.writepage	= fuse_writepage,
+	.writepages	= fuse_writepages,
 	.launder_page	= fuse_launder_page,
 	.write_begin	= fuse_write_begin,
 	.write_end	= fuse_write_end,
@@ -201,8 +201,8 @@ enum fuse_req_state {
  * A request to the client
  */
 struct fuse_req {
-	/** This can be on either pending processing or io lists in
-	    fuse_conn */
+	/** This can be on either the pending list in fuse_conn, or the
+	    processing or io lists of a channel */
 	struct list_head list;
 
 	/** Entry on the interrupts list  */
@@ -300,6 +300,35 @@ struct fuse_req {
 	struct file *stolen_file;
 };
 
+/** Number of buckets in the processing list hash of a channel */
+#define FUSE_PQ_HASH_SIZE 64
+
+/**
+ * A request channel.
+ *
+ * Each /dev/fuse file attached to a connection is a channel: the one
+ * the filesystem was mounted with, and any made from it with
+ * FUSE_DEV_IOC_CLONE.  All channels read requests from the pending
+ * list of the connection, and a request read from a channel is kept on
+ * its processing list until answered.  Giving each daemon thread its
+ * own channel keeps the lists searched for replies short.
+ *
+ * Protected by the lock of the connection.
+ */
+struct fuse_chan {
+	/** The connection this channel belongs to */
+	struct fuse_conn *fc;
+
+	/** Requests being processed, hashed by unique ID */
+	struct list_head processing[FUSE_PQ_HASH_SIZE];
+
+	/** The list of requests under I/O */
+	struct list_head io;
+
+	/** Entry on the channel list of the connection */
+	struct list_head entry;
+};
+
 /**
  * A Fuse connection.
  *
@@ -338,11 +367,14 @@ struct fuse_conn {
 	/** The list of pending requests */
 	struct list_head pending;
 
-	/** The list of requests being processed */
-	struct list_head processing;
+	/** The channel the filesystem was mounted with */
+	struct fuse_chan chan;
 
-	/** The list of requests under I/O */
-	struct list_head io;
+	/** All channels of the connection */
+	struct list_head chans;
+
+	/** Number of channels on the above list */
+	unsigned nr_chans;
 
 	/** The next unique kernel file handle */
 	u64 khctr;
@@ -456,6 +488,9 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Buffer writes in the page cache, send them from writeback */
+	unsigned writeback_cache:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -670,6 +705,11 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
 /* Abort all requests */
 void fuse_abort_conn(struct fuse_conn *fc);
 
+/**
+ * Initialize a request channel of the connection
+ */
+void fuse_chan_init(struct fuse_chan *chan, struct fuse_conn *fc);
+
 /**
  * Invalidate inode attributes
  */
@@ -724,6 +764,11 @@ void fuse_flush_writepages(struct inode *inode);
 void fuse_set_nowrite(struct inode *inode);
 void fuse_release_nowrite(struct inode *inode);
 
+/**
+ * Send the locally maintained mtime of a writeback cached file
+ */
+int fuse_flush_mtime(struct inode *inode);
+
 u64 fuse_get_attr_version(struct fuse_conn *fc);
 
 /**
@@ -341,6 +341,85 @@ static void write_tag_block(int tag_bytes, journal_block_tag_t *tag,
 		tag->t_blocknr_high = cpu_to_be32((block >> 31) >> 1);
 }
 
+/*
+ * Release the temporary IO buffers on t_iobuf_list whose writes to the
+ * log have completed, together with the shadowed metadata buffers they
+ * were copied from.  Handles of the next transaction that want one of
+ * those buffers sleep in do_get_write_access() until it is released, so
+ * the commit calls this with @wait == 0 each time it has submitted a
+ * batch of log blocks: it then stops at the first write still in flight,
+ * and the metadata whose log copy is already on disk is handed back to
+ * the running transaction without waiting for the rest of the commit.
+ * With @wait set it waits for and releases everything.
+ *
+ * Both lists are filed in submission order, so their heads pair up.
+ * Returns the number of buffers released; a failed write sets *errp.
+ */
+static int journal_release_iobufs(journal_t *journal,
+				  transaction_t *commit_transaction,
+				  int wait, int *errp)
+{
+	struct journal_head *jh;
+	struct buffer_head *bh;
+	int released = 0;
+
+	/*
+	 * akpm: these are BJ_IO, and j_list_lock is not needed.
+	 * See __journal_try_to_free_buffer.
+	 */
+	while (commit_transaction->t_iobuf_list != NULL) {
+		jh = commit_transaction->t_iobuf_list;
+		bh = jh2bh(jh);
+		if (buffer_locked(bh)) {
+			if (!wait)
+				break;
+			wait_on_buffer(bh);
+			continue;
+		}
+
+		if (unlikely(!buffer_uptodate(bh)))
+			*errp = -EIO;
+
+		clear_buffer_jwrite(bh);
+
+		JBUFFER_TRACE(jh, "ph4: unfile after journal write");
+		jbd2_journal_unfile_buffer(journal, jh);
+
+		/*
+		 * ->t_iobuf_list should contain only dummy buffer_heads
+		 * which were created by jbd2_journal_write_metadata_buffer().
+		 */
+		BUFFER_TRACE(bh, "dumping temporary bh");
+		jbd2_journal_put_journal_head(jh);
+		__brelse(bh);
+		J_ASSERT_BH(bh, atomic_read(&bh->b_count) == 0);
+		free_buffer_head(bh);
+
+		/* We also have to unlock and free the corresponding
+                   shadowed buffer */
+		jh = commit_transaction->t_shadow_list;
+		bh = jh2bh(jh);
+		clear_bit(BH_JWrite, &bh->b_state);
+		J_ASSERT_BH(bh, buffer_jbddirty(bh));
+
+		/* The metadata is now released for reuse, but we need
+                   to remember it against this transaction so that when
+                   we finally commit, we can do any checkpointing
+                   required. */
+		JBUFFER_TRACE(jh, "file as BJ_Forget");
+		jbd2_journal_file_buffer(jh, commit_transaction, BJ_Forget);
+		/* Wake up any transactions which were waiting for this
+		   IO to complete */
+		wake_up_bit(&bh->b_state, BH_Unshadow);
+		JBUFFER_TRACE(jh, "brelse shadowed buffer");
+		__brelse(bh);
+		released++;
+
+		cond_resched();
+	}
+	return released;
+}
+
 /*
  * jbd2_journal_commit_transaction
  *
@@ -355,7 +434,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	struct buffer_head **wbuf = journal->j_wbuf;
 	int bufs;
 	int flags;
-	int err;
+	int err, ret;
+	int log_err = 0;
 	unsigned long long blocknr;
 	ktime_t start_time;
 	u64 commit_time;
@@ -382,6 +462,25 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	spin_unlock(&journal->j_list_lock);
 #endif
 
+	/*
+	 * A fast commit of the running transaction may be writing to the
+	 * fast commit area, which this commit is about to supersede: let
+	 * it finish, and keep new ones out until this commit is done.
+	 */
+	spin_lock(&journal->j_state_lock);
+	while (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		spin_unlock(&journal->j_state_lock);
+		schedule();
+		finish_wait(&journal->j_fc_wait, &wait);
+		spin_lock(&journal->j_state_lock);
+	}
+	journal->j_flags |= JBD2_FULL_COMMIT_ONGOING;
+	spin_unlock(&journal->j_state_lock);
+
 	/* Do we need to erase the effects of a prior jbd2_journal_flush? */
 	if (journal->j_flags & JBD2_FLUSHED) {
 		jbd_debug(3, "super block updated\n");
@@ -470,15 +569,6 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		jbd2_journal_refile_buffer(journal, jh);
 	}
 
-	/*
-	 * Now try to drop any written-back buffers from the journal's
-	 * checkpoint lists.  We do this *before* commit because it potentially
-	 * frees some memory
-	 */
-	spin_lock(&journal->j_list_lock);
-	__jbd2_journal_clean_checkpoint_list(journal);
-	spin_unlock(&journal->j_list_lock);
-
 	jbd_debug (3, "JBD: commit phase 1\n");
 
 	/*
@@ -499,6 +589,17 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	wake_up(&journal->j_wait_transaction_locked);
 	spin_unlock(&journal->j_state_lock);
 
+	/*
+	 * Now try to drop any written-back buffers from the journal's
+	 * checkpoint lists.  We do this *before* commit because it potentially
+	 * frees some memory, but only once the transaction is unlocked, so
+	 * that new handles are not kept waiting in start_this_handle() while
+	 * we walk the lists.
+	 */
+	spin_lock(&journal->j_list_lock);
+	__jbd2_journal_clean_checkpoint_list(journal);
+	spin_unlock(&journal->j_list_lock);
+
 	jbd_debug (3, "JBD: commit phase 2\n");
 
 	/*
@@ -529,6 +630,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 					       stats.run.rs_logging);
 	stats.run.rs_blocks = commit_transaction->t_outstanding_credits;
 	stats.run.rs_blocks_logged = 0;
+	stats.run.rs_blocks_released = 0;
 
 	J_ASSERT(commit_transaction->t_nr_buffers <=
 		 commit_transaction->t_outstanding_credits);
@@ -706,6 +808,12 @@ start_journal_io:
                            time round the loop. */
 			descriptor = NULL;
 			bufs = 0;
+
+			/* Hand back whatever earlier batches have
+			   already got to the log */
+			stats.run.rs_blocks_released +=
+				journal_release_iobufs(journal,
+						commit_transaction, 0, &log_err);
 		}
 	}
 
@@ -732,83 +840,24 @@ start_journal_io:
 				BLKDEV_IFL_WAIT);
 	}
 
-	err = journal_finish_inode_data_buffers(journal, commit_transaction);
-	if (err) {
-		printk(KERN_WARNING
-			"JBD2: Detected IO errors while flushing file data "
-		       "on %s\n", journal->j_devname);
-		if (journal->j_flags & JBD2_ABORT_ON_SYNCDATA_ERR)
-			jbd2_journal_abort(journal, err);
-		err = 0;
-	}
-
 	/* Lo and behold: we have just managed to send a transaction to
            the log.  Before we can commit it, wait for the IO so far to
-           complete.  Control buffers being written are on the
-           transaction's t_log_list queue, and metadata buffers are on
-           the t_iobuf_list queue.
+           complete.  Metadata buffers are on the t_iobuf_list queue,
+           and control buffers being written are on the transaction's
+           t_log_list queue.
 
-	   Wait for the buffers in reverse order.  That way we are
-	   less likely to be woken up until all IOs have completed, and
-	   so we incur less scheduling load.
+	   Wait for the log first: the next transaction may be waiting
+	   for some of the metadata buffers, and none of the log IO
+	   depends on the ordered data we wait for afterwards.
 	*/
 
 	jbd_debug(3, "JBD: commit phase 3\n");
 
-	/*
-	 * akpm: these are BJ_IO, and j_list_lock is not needed.
-	 * See __journal_try_to_free_buffer.
-	 */
-wait_for_iobuf:
-	while (commit_transaction->t_iobuf_list != NULL) {
-		struct buffer_head *bh;
-
-		jh = commit_transaction->t_iobuf_list->b_tprev;
-		bh = jh2bh(jh);
-		if (buffer_locked(bh)) {
-			wait_on_buffer(bh);
-			goto wait_for_iobuf;
-		}
-		if (cond_resched())
-			goto wait_for_iobuf;
-
-		if (unlikely(!buffer_uptodate(bh)))
-			err = -EIO;
-
-		clear_buffer_jwrite(bh);
-
-		JBUFFER_TRACE(jh, "ph4: unfile after journal write");
-		jbd2_journal_unfile_buffer(journal, jh);
-
-		/*
-		 * ->t_iobuf_list should contain only dummy buffer_heads
-		 * which were created by jbd2_journal_write_metadata_buffer().
-		 */
-		BUFFER_TRACE(bh, "dumping temporary bh");
-		jbd2_journal_put_journal_head(jh);
-		__brelse(bh);
-		J_ASSERT_BH(bh, atomic_read(&bh->b_count) == 0);
-		free_buffer_head(bh);
-
-		/* We also have to unlock and free the corresponding
-                   shadowed buffer */
-		jh = commit_transaction->t_shadow_list->b_tprev;
-		bh = jh2bh(jh);
-		clear_bit(BH_JWrite, &bh->b_state);
-		J_ASSERT_BH(bh, buffer_jbddirty(bh));
-
-		/* The metadata is now released for reuse, but we need
-                   to remember it against this transaction so that when
-                   we finally commit, we can do any checkpointing
-                   required. */
-		JBUFFER_TRACE(jh, "file as BJ_Forget");
-		jbd2_journal_file_buffer(jh, commit_transaction, BJ_Forget);
-		/* Wake up any transactions which were waiting for this
-		   IO to complete */
-		wake_up_bit(&bh->b_state, BH_Unshadow);
-		JBUFFER_TRACE(jh, "brelse shadowed buffer");
-		__brelse(bh);
-	}
+	stats.run.rs_log_wait = jiffies;
+	stats.run.rs_submit = jbd2_time_diff(stats.run.rs_logging,
+					     stats.run.rs_log_wait);
+	journal_release_iobufs(journal, commit_transaction, 1, &log_err);
+	err = log_err;
 
 	J_ASSERT (commit_transaction->t_shadow_list == NULL);
 
@@ -839,6 +888,21 @@ wait_for_iobuf:
 		/* AKPM: bforget here */
 	}
 
+	stats.run.rs_data_wait = jiffies;
+	stats.run.rs_log_wait = jbd2_time_diff(stats.run.rs_log_wait,
+					       stats.run.rs_data_wait);
+	ret = journal_finish_inode_data_buffers(journal, commit_transaction);
+	if (ret) {
+		printk(KERN_WARNING
+			"JBD2: Detected IO errors while flushing file data "
+		       "on %s\n", journal->j_devname);
+		if (journal->j_flags & JBD2_ABORT_ON_SYNCDATA_ERR)
+			jbd2_journal_abort(journal, ret);
+	}
+	stats.run.rs_commit_wait = jiffies;
+	stats.run.rs_data_wait = jbd2_time_diff(stats.run.rs_data_wait,
+						stats.run.rs_commit_wait);
+
 	if (err)
 		jbd2_journal_abort(journal, err);
 
@@ -853,6 +917,8 @@ wait_for_iobuf:
 	}
 	if (!err && !is_journal_aborted(journal))
 		err = journal_wait_on_commit_record(journal, cbh);
+	stats.run.rs_commit_wait = jbd2_time_diff(stats.run.rs_commit_wait,
+						  jiffies);
 
 	if (err)
 		jbd2_journal_abort(journal, err);
@@ -1017,15 +1083,22 @@ restart_loop:
 	journal->j_stats.run.rs_locked += stats.run.rs_locked;
 	journal->j_stats.run.rs_flushing += stats.run.rs_flushing;
 	journal->j_stats.run.rs_logging += stats.run.rs_logging;
+	journal->j_stats.run.rs_submit += stats.run.rs_submit;
+	journal->j_stats.run.rs_data_wait += stats.run.rs_data_wait;
+	journal->j_stats.run.rs_log_wait += stats.run.rs_log_wait;
+	journal->j_stats.run.rs_commit_wait += stats.run.rs_commit_wait;
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	journal->j_stats.run.rs_blocks_released += stats.run.rs_blocks_released;
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
+	journal->j_fc_off = 0;
+	journal->j_flags &= ~JBD2_FULL_COMMIT_ONGOING;
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
 	/*
@@ -41,6 +41,7 @@
 #include <linux/hash.h>
 #include <linux/log2.h>
 #include <linux/vmalloc.h>
+#include <linux/blkdev.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -88,6 +89,11 @@ EXPORT_SYMBOL(jbd2_journal_blocks_per_page);
 EXPORT_SYMBOL(jbd2_journal_invalidatepage);
 EXPORT_SYMBOL(jbd2_journal_try_to_free_buffers);
 EXPORT_SYMBOL(jbd2_journal_force_commit);
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+EXPORT_SYMBOL(jbd2_fc_end_commit_fallback);
+EXPORT_SYMBOL(jbd2_fc_get_buf);
+EXPORT_SYMBOL(jbd2_fc_write_buf);
 EXPORT_SYMBOL(jbd2_journal_file_inode);
 EXPORT_SYMBOL(jbd2_journal_init_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_release_jbd_inode);
@@ -594,6 +600,194 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 	return err;
 }
 
+/*
+ * Fast commits.
+ *
+ * A fast commit makes the running transaction's changes to a few inodes
+ * durable without committing the transaction.  The client filesystem
+ * writes a compact logical record of them into the fast commit area, a
+ * fixed range of blocks after the log, and replays it itself from its
+ * j_fc_replay_callback once recovery has replayed the log.  A fast
+ * commit record only applies on top of the transactions before the one
+ * it was written for, so fast commits and full commits never overlap:
+ * a full commit waits for a fast commit in progress, and a fast commit
+ * waits for an earlier transaction to finish committing.
+ */
+
+/**
+ * int jbd2_fc_begin_commit() - start a fast commit of a transaction
+ * @journal: Journal to act on.
+ * @tid: Transaction the caller wants to be durable.
+ *
+ * Returns 0 with the fast commit area locked for the caller, who must
+ * then call jbd2_fc_end_commit() or jbd2_fc_end_commit_fallback().
+ * Returns -EALREADY if @tid is no longer running or has started a full
+ * commit, -EOPNOTSUPP if the journal has no fast commit area, and -EIO
+ * if the journal has been aborted; the caller must then commit or wait
+ * for @tid the usual way.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	tid_t wait_tid;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return -EOPNOTSUPP;
+
+	spin_lock(&journal->j_state_lock);
+	while (1) {
+		if (is_journal_aborted(journal)) {
+			spin_unlock(&journal->j_state_lock);
+			return -EIO;
+		}
+		if (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+			DEFINE_WAIT(wait);
+
+			prepare_to_wait(&journal->j_fc_wait, &wait,
+					TASK_UNINTERRUPTIBLE);
+			spin_unlock(&journal->j_state_lock);
+			schedule();
+			finish_wait(&journal->j_fc_wait, &wait);
+			spin_lock(&journal->j_state_lock);
+			continue;
+		}
+		transaction = journal->j_committing_transaction;
+		if (!transaction)
+			break;
+		wait_tid = transaction->t_tid;
+		spin_unlock(&journal->j_state_lock);
+		jbd2_log_wait_commit(journal, wait_tid);
+		spin_lock(&journal->j_state_lock);
+	}
+
+	/*
+	 * Recovery only looks at the fast commit area when the superblock
+	 * says the log is in use, which it does not after a flush until
+	 * the next full commit.
+	 */
+	transaction = journal->j_running_transaction;
+	if (!transaction || transaction->t_tid != tid ||
+	    (journal->j_flags & (JBD2_FULL_COMMIT_ONGOING | JBD2_FLUSHED))) {
+		spin_unlock(&journal->j_state_lock);
+		return -EALREADY;
+	}
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	spin_unlock(&journal->j_state_lock);
+	return 0;
+}
+
+/**
+ * void jbd2_fc_end_commit() - finish a fast commit
+ * @journal: Journal to act on.
+ *
+ * Called when the fast commit has been written, or when the caller
+ * decided not to write one before taking any fast commit block.
+ */
+void jbd2_fc_end_commit(journal_t *journal)
+{
+	spin_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	spin_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+
+/**
+ * void jbd2_fc_end_commit_fallback() - abandon a partly written fast commit
+ * @journal: Journal to act on.
+ *
+ * Recovery stops at the first fast commit block that does not check
+ * out, so whatever a failed fast commit left behind would hide any fast
+ * commit appended after it.  Close the area until the next full commit;
+ * the caller must commit the transaction the usual way.
+ */
+void jbd2_fc_end_commit_fallback(journal_t *journal)
+{
+	spin_lock(&journal->j_state_lock);
+	journal->j_fc_off = journal->j_fc_last - journal->j_fc_first;
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	spin_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+
+/**
+ * int jbd2_fc_get_buf() - get the next block of the fast commit area
+ * @journal: Journal to act on.
+ * @bh_out: Returns the buffer, which the caller fills and passes to
+ *	jbd2_fc_write_buf() and then releases.
+ *
+ * Must be called between jbd2_fc_begin_commit() and the end of the fast
+ * commit.  Returns -ENOSPC once the area is full.
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out)
+{
+	unsigned long long pblock;
+	unsigned long blocknr;
+	struct buffer_head *bh;
+	int err;
+
+	J_ASSERT(journal->j_flags & JBD2_FAST_COMMIT_ONGOING);
+
+	blocknr = journal->j_fc_first + journal->j_fc_off;
+	if (blocknr >= journal->j_fc_last)
+		return -ENOSPC;
+	err = jbd2_journal_bmap(journal, blocknr, &pblock);
+	if (err)
+		return err;
+	bh = __getblk(journal->j_dev, pblock, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+	journal->j_fc_off++;
+	*bh_out = bh;
+	return 0;
+}
+
+/**
+ * int jbd2_fc_write_buf() - write a fast commit block and wait for it
+ * @journal: Journal to act on.
+ * @bh: Buffer from jbd2_fc_get_buf().
+ *
+ * The block is written as a barrier, so that it cannot reach the disk
+ * before the file data written ahead of it, and is on stable storage
+ * when this returns.
+ */
+int jbd2_fc_write_buf(journal_t *journal, struct buffer_head *bh)
+{
+	int barrier;
+
+	if (journal->j_fs_dev != journal->j_dev &&
+	    (journal->j_flags & JBD2_BARRIER))
+		blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL,
+				   BLKDEV_IFL_WAIT);
+retry:
+	barrier = journal->j_flags & JBD2_BARRIER;
+	lock_buffer(bh);
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	get_bh(bh);
+	if (barrier)
+		set_buffer_ordered(bh);
+	submit_bh(WRITE_SYNC, bh);
+	if (barrier)
+		clear_buffer_ordered(bh);
+	wait_on_buffer(bh);
+
+	if (buffer_eopnotsupp(bh) && barrier) {
+		printk(KERN_WARNING
+		       "JBD2: barrier-based sync failed on %s - "
+		       "disabling barriers\n", journal->j_devname);
+		spin_lock(&journal->j_state_lock);
+		journal->j_flags &= ~JBD2_BARRIER;
+		spin_unlock(&journal->j_state_lock);
+		clear_buffer_eopnotsupp(bh);
+		goto retry;
+	}
+	if (unlikely(!buffer_uptodate(bh)))
+		return -EIO;
+	return 0;
+}
+
 /*
  * Log buffer allocation routines:
  */
@@ -714,6 +908,14 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    jiffies_to_msecs(s->stats->run.rs_flushing / s->stats->ts_tid));
 	seq_printf(seq, "  %ums logging transaction\n",
 	    jiffies_to_msecs(s->stats->run.rs_logging / s->stats->ts_tid));
+	seq_printf(seq, "    %ums writing log blocks\n",
+	    jiffies_to_msecs(s->stats->run.rs_submit / s->stats->ts_tid));
+	seq_printf(seq, "    %ums waiting for log blocks\n",
+	    jiffies_to_msecs(s->stats->run.rs_log_wait / s->stats->ts_tid));
+	seq_printf(seq, "    %ums waiting for data (in ordered mode)\n",
+	    jiffies_to_msecs(s->stats->run.rs_data_wait / s->stats->ts_tid));
+	seq_printf(seq, "    %ums writing commit record\n",
+	    jiffies_to_msecs(s->stats->run.rs_commit_wait / s->stats->ts_tid));
 	seq_printf(seq, "  %lluus average transaction commit time\n",
 		   div_u64(s->journal->j_average_commit_time, 1000));
 	seq_printf(seq, "  %lu handles per transaction\n",
@@ -722,6 +924,9 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "  %lu blocks released to the next transaction "
+		   "while logging\n",
+	    s->stats->run.rs_blocks_released / s->stats->ts_tid);
 	return 0;
 }
 
@@ -826,6 +1031,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_checkpoint);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
+	init_waitqueue_head(&journal->j_fc_wait);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
@@ -1026,6 +1232,9 @@ static int journal_reset(journal_t *journal)
 
 	first = be32_to_cpu(sb->s_first);
 	last = be32_to_cpu(sb->s_maxlen);
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		last = journal->j_fc_first;
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1192,6 +1401,32 @@ out:
 	return err;
 }
 
+/*
+ * Carve the fast commit area out of the end of the journal.  The log
+ * must not be in use: this runs as the superblock is loaded, or when
+ * the feature is set on a journal that has just been loaded.
+ */
+static int journal_init_fast_commit(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long num_fc_blks = be32_to_cpu(sb->s_num_fc_blks);
+
+	if (!num_fc_blks)
+		num_fc_blks = JBD2_DEFAULT_FAST_COMMIT_BLOCKS;
+	if (journal->j_first + JBD2_MIN_JOURNAL_BLOCKS + num_fc_blks >
+	    journal->j_last + 1) {
+		printk(KERN_ERR "JBD: Journal too short for %lu fast commit "
+		       "blocks.\n", num_fc_blks);
+		return -EINVAL;
+	}
+	sb->s_num_fc_blks = cpu_to_be32(num_fc_blks);
+	journal->j_fc_last = journal->j_last;
+	journal->j_last -= num_fc_blks;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_off = 0;
+	return 0;
+}
+
 /*
  * Load the on-disk journal superblock and read the key fields into the
  * journal_t.
@@ -1214,6 +1449,9 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return journal_init_fast_commit(journal);
 	return 0;
 }
 
@@ -1441,10 +1679,29 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 
 	sb = journal->j_superblock;
 
+	if ((incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT) &&
+	    !JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+		/* Shrinking the log is only safe while it is empty. */
+		if (journal->j_running_transaction ||
+		    journal->j_head != journal->j_first ||
+		    journal->j_tail != journal->j_first ||
+		    journal_init_fast_commit(journal))
+			return 0;
+		journal->j_free = journal->j_last - journal->j_first;
+	}
+
 	sb->s_feature_compat    |= cpu_to_be32(compat);
 	sb->s_feature_ro_compat |= cpu_to_be32(ro);
 	sb->s_feature_incompat  |= cpu_to_be32(incompat);
 
+	/*
+	 * Recovery must know where the log wraps before the log can
+	 * wrap at the new place.
+	 */
+	if (incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
+		jbd2_journal_update_superblock(journal, 1);
+
 	return 1;
 }
 
@@ -35,6 +35,7 @@ struct recovery_info
 	int		nr_replays;
 	int		nr_revokes;
 	int		nr_revoke_hits;
+	int		nr_fc_replays;
 };
 
 enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
@@ -42,6 +43,7 @@ static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
 				tid_t, struct recovery_info *);
+static int fc_do_one_pass(journal_t *journal, struct recovery_info *info);
 
 #ifdef __KERNEL__
 
@@ -250,12 +252,17 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err && JBD2_HAS_INCOMPAT_FEATURE(journal,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		err = fc_do_one_pass(journal, &info);
 
 	jbd_debug(1, "JBD: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
 		  err, info.start_transaction, info.end_transaction);
 	jbd_debug(1, "JBD: Replayed %d and revoked %d/%d blocks\n",
 		  info.nr_replays, info.nr_revoke_hits, info.nr_revokes);
+	jbd_debug(1, "JBD: Replayed %d fast commit blocks\n",
+		  info.nr_fc_replays);
 
 	/* Restart the log at the next transaction ID, thus invalidating
 	 * any existing commit records in the log. */
@@ -710,6 +717,42 @@ static int do_one_pass(journal_t *journal,
 }
 
 
+/*
+ * Hand the fast commit area to the client filesystem, block by block,
+ * once the log has been replayed.  Fast commits only count if they were
+ * written for the transaction after the last one found in the log.
+ */
+static int fc_do_one_pass(journal_t *journal, struct recovery_info *info)
+{
+	unsigned long next_fc_block;
+	struct buffer_head *bh;
+	int err = 0;
+
+	if (!journal->j_fc_replay_callback)
+		return 0;
+
+	for (next_fc_block = journal->j_fc_first;
+	     next_fc_block < journal->j_fc_last; next_fc_block++) {
+		jbd_debug(3, "JBD: fast commit block %lu\n", next_fc_block);
+		err = jread(&bh, journal, next_fc_block);
+		if (err)
+			break;
+		err = journal->j_fc_replay_callback(journal, bh,
+				next_fc_block - journal->j_fc_first,
+				info->end_transaction);
+		brelse(bh);
+		if (err)
+			break;
+		info->nr_fc_replays++;
+	}
+	if (err == JBD2_FC_REPLAY_STOP)
+		err = 0;
+	if (err)
+		printk(KERN_ERR "JBD: fast commit replay failed at block %lu, "
+		       "error %d\n", next_fc_block, err);
+	return err;
+}
+
 /* Scan a revoke record, marking all blocks mentioned as revoked. */
 
 static int scan_revoke_records(journal_t *journal, struct buffer_head *bh,
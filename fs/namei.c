@@ -482,6 +482,45 @@ ok:
 	return security_inode_permission(inode, MAY_EXEC);
 }
 
+/*
+ * As exec_permission(), for the lockless part of path walk: called under
+ * rcu_read_lock() on an inode nobody holds a reference to.  Only answers
+ * "yes" when the mode bits alone allow the search; anything that would
+ * need ->permission(), an ACL that is not known to be absent, a
+ * capability or an LSM that keeps per-inode state returns -EAGAIN so
+ * the caller falls back to the reference-counted walk, which gets the
+ * answer (and any auditing) right.
+ */
+static int exec_permission_rcu(struct inode *inode)
+{
+	umode_t mode = inode->i_mode;
+
+	if (inode->i_op->permission)
+		return -EAGAIN;
+#ifdef CONFIG_SECURITY
+	if (inode->i_security)
+		return -EAGAIN;
+#endif
+
+	if (current_fsuid() == inode->i_uid)
+		mode >>= 6;
+	else {
+		if (IS_POSIXACL(inode) && (mode & S_IRWXG) &&
+		    inode->i_op->check_acl) {
+#ifdef CONFIG_FS_POSIX_ACL
+			if (ACCESS_ONCE(inode->i_acl) != NULL)
+#endif
+				return -EAGAIN;
+		}
+		if (in_group_p(inode->i_gid))
+			mode >>= 3;
+	}
+	if (!(mode & MAY_EXEC))
+		return -EAGAIN;
+
+	return security_inode_permission(inode, MAY_EXEC);
+}
+
 static __always_inline void set_root(struct nameidata *nd)
 {
 	if (!nd->root.mnt) {
@@ -793,6 +832,100 @@ fail:
 	return PTR_ERR(dentry);
 }
 
+/*
+ * Lockless walk of the intermediate components of a pathname.
+ *
+ * Starting at nd->path, which the caller holds references on, resolve
+ * as many of the components that are followed by a '/' as the dcache
+ * can answer under rcu_read_lock() alone: no dcache_lock, no d_lock and
+ * no reference counting on the directories passed through.  The walk
+ * stops, leaving the rest to the caller, at the last component, at "."
+ * and "..", at a dentry that is not cached, negative, a mountpoint, a
+ * symlink or not a directory, at a search permission that the mode bits
+ * cannot grant, and on filesystems that have not set FS_RCU_WALK.
+ *
+ * Renames anywhere are caught by rename_lock, and an unlink of the
+ * directory we stop at by checking it is still hashed and still has the
+ * inode we looked at when we finally take a reference on it; an unlink
+ * further up cannot leave it positive.  If that check fails nothing has
+ * changed and the caller walks the same components the usual way.
+ *
+ * Returns 1 if nd->path and *name were advanced, 0 otherwise.
+ */
+static int rcu_path_walk(struct nameidata *nd, const char **pname)
+{
+	struct dentry *parent = nd->path.dentry;
+	struct inode *inode = parent->d_inode;
+	struct dentry *dentry = NULL;
+	const char *name = *pname;
+	unsigned seq;
+
+	if (nd->flags & LOOKUP_REVAL)
+		return 0;
+	if (!(nd->path.mnt->mnt_sb->s_type->fs_flags & FS_RCU_WALK))
+		return 0;
+
+	rcu_read_lock();
+	seq = read_seqbegin(&rename_lock);
+	for (;;) {
+		struct dentry *child;
+		struct inode *child_inode;
+		const char *p = name;
+		unsigned long hash;
+		struct qstr this;
+		unsigned int c;
+
+		if (exec_permission_rcu(inode))
+			break;
+
+		this.name = p;
+		c = *(const unsigned char *)p;
+
+		hash = init_name_hash();
+		do {
+			p++;
+			hash = partial_name_hash(c, hash);
+			c = *(const unsigned char *)p;
+		} while (c && (c != '/'));
+		this.len = p - (const char *) this.name;
+		this.hash = end_name_hash(hash);
+
+		if (!c)
+			break;
+		while (*++p == '/');
+		if (!*p)
+			break;
+		if (this.name[0] == '.' &&
+		    (this.len == 1 || (this.len == 2 && this.name[1] == '.')))
+			break;
+
+		if (parent->d_op && parent->d_op->d_hash &&
+		    parent->d_op->d_hash(parent, &this) < 0)
+			break;
+		child = __d_lookup_rcu(parent, &this);
+		if (!child || d_mountpoint(child))
+			break;
+		child_inode = ACCESS_ONCE(child->d_inode);
+		if (!child_inode || child_inode->i_op->follow_link ||
+		    !child_inode->i_op->lookup)
+			break;
+
+		parent = dentry = child;
+		inode = child_inode;
+		name = p;
+	}
+
+	if (dentry && d_rcu_walk_get(dentry, inode, seq)) {
+		rcu_read_unlock();
+		dput(nd->path.dentry);
+		nd->path.dentry = dentry;
+		*pname = name;
+		return 1;
+	}
+	rcu_read_unlock();
+	return 0;
+}
+
 /*
  * This is a temporary kludge to deal with "automount" symlinks; proper
  * solution is to trigger them on follow_mount(), so that do_lookup()
@@ -835,6 +968,8 @@ static int link_path_walk(const char *name, struct nameidata *nd)
 		unsigned int c;
 
 		nd->flags |= LOOKUP_CONTINUE;
+		if (rcu_path_walk(nd, &name))
+			inode = nd->path.dentry->d_inode;
 		err = exec_permission(inode);
  		if (err)
 			break;
@@ -368,6 +368,33 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 }
 #endif
 
+#ifdef CONFIG_TASK_DELAY_ACCT
+/*
+ * Provides /proc/PID/memstall: the number of direct reclaim and direct
+ * compaction runs the task has had to do, and the total time in
+ * nanoseconds it spent stalled in each.
+ */
+static int proc_pid_memstall(struct task_struct *task, char *buffer)
+{
+	unsigned long long reclaim_delay = 0, compact_delay = 0;
+	unsigned int reclaim_count = 0, compact_count = 0;
+	unsigned long flags;
+
+	if (task->delays) {
+		spin_lock_irqsave(&task->delays->lock, flags);
+		reclaim_delay = task->delays->freepages_delay;
+		reclaim_count = task->delays->freepages_count;
+		compact_delay = task->delays->compact_delay;
+		compact_count = task->delays->compact_count;
+		spin_unlock_irqrestore(&task->delays->lock, flags);
+	}
+
+	return sprintf(buffer, "reclaim %u %llu\ncompact %u %llu\n",
+			reclaim_count, reclaim_delay,
+			compact_count, compact_delay);
+}
+#endif
+
 #ifdef CONFIG_LATENCYTOP
 static int lstats_show_proc(struct seq_file *m, void *v)
 {
@@ -2648,6 +2675,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_TASK_DELAY_ACCT
+	INF("memstall",   S_IRUGO, proc_pid_memstall),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -2982,6 +3012,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_TASK_DELAY_ACCT
+	INF("memstall",  S_IRUGO, proc_pid_memstall),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -109,11 +109,13 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			 * disk.
 			 */
 			cache->unused--;
+			cache->misses++;
 			entry->block = block;
 			entry->refcount = 1;
 			entry->pending = 1;
 			entry->num_waiters = 0;
 			entry->error = 0;
+			entry->populated = 0;
 			spin_unlock(&cache->lock);
 
 			entry->length = squashfs_read_data(sb, entry->data,
@@ -151,6 +153,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
+		cache->hits++;
 
 		/*
 		 * If the entry is currently being filled in by another process
@@ -24,6 +24,7 @@
 #include <linux/types.h>
 #include <linux/mutex.h>
 #include <linux/buffer_head.h>
+#include <linux/percpu.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -40,9 +41,15 @@ static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
 	NULL, NULL, NULL, LZMA_COMPRESSION, "lzma", 0
 };
 
+#ifndef CONFIG_SQUASHFS_LZO
 static const struct squashfs_decompressor squashfs_lzo_unsupported_comp_ops = {
 	NULL, NULL, NULL, LZO_COMPRESSION, "lzo", 0
 };
+#endif
+
+static const struct squashfs_decompressor squashfs_xz_unsupported_comp_ops = {
+	NULL, NULL, NULL, XZ_COMPRESSION, "xz", 0
+};
 
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
@@ -51,7 +58,12 @@ static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
+#ifdef CONFIG_SQUASHFS_LZO
+	&squashfs_lzo_comp_ops,
+#else
 	&squashfs_lzo_unsupported_comp_ops,
+#endif
+	&squashfs_xz_unsupported_comp_ops,
 	&squashfs_unknown_comp_ops
 };
 
@@ -66,3 +78,96 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 
 	return decompressor[i];
 }
+
+
+#ifdef CONFIG_SQUASHFS_DECOMP_PERCPU
+/*
+ * One decompressor stream per CPU, so that readers on different CPUs
+ * decompress in parallel.  A reader keeps preemption disabled while it
+ * uses its CPU's stream; squashfs_read_data() has already waited for the
+ * buffers, so decompressing does not sleep.
+ */
+struct squashfs_stream {
+	void	*stream;
+};
+
+void *squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream __percpu *percpu;
+	int cpu;
+
+	percpu = alloc_percpu(struct squashfs_stream);
+	if (percpu == NULL)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		struct squashfs_stream *s = per_cpu_ptr(percpu, cpu);
+
+		s->stream = msblk->decompressor->init(msblk);
+		if (s->stream == NULL) {
+			squashfs_decompressor_free(msblk, percpu);
+			return NULL;
+		}
+	}
+
+	return percpu;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk, void *s)
+{
+	struct squashfs_stream __percpu *percpu = s;
+	int cpu;
+
+	if (msblk->decompressor == NULL || percpu == NULL)
+		return;
+
+	for_each_possible_cpu(cpu)
+		msblk->decompressor->free(per_cpu_ptr(percpu, cpu)->stream);
+	free_percpu(percpu);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream __percpu *percpu = msblk->stream;
+	int cpu, res;
+
+	cpu = get_cpu();
+	res = msblk->decompressor->decompress(msblk,
+		per_cpu_ptr(percpu, cpu)->stream, buffer, bh, b, offset,
+		length, srclength, pages);
+	put_cpu();
+
+	return res;
+}
+#else
+void *squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+{
+	return msblk->decompressor->init(msblk);
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk, void *s)
+{
+	if (msblk->decompressor)
+		msblk->decompressor->free(s);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	int res;
+
+	mutex_lock(&msblk->read_data_mutex);
+	res = msblk->decompressor->decompress(msblk, msblk->stream, buffer,
+		bh, b, offset, length, srclength, pages);
+	mutex_unlock(&msblk->read_data_mutex);
+
+	return res;
+}
+#endif
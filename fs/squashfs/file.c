@@ -371,6 +371,152 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/* Most files whose tail ends are filled in from one fragment read */
+#define SQUASHFS_FRAG_POPULATE_MAX	32
+
+/*
+ * Fill in the page cache pages of the tail end of inode, which is stored
+ * in the fragment block in buffer.  Pages which are locked or already
+ * uptodate are left alone.
+ */
+static void squashfs_fill_tail(struct inode *inode,
+	struct squashfs_cache_entry *buffer)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	loff_t size = i_size_read(inode);
+	int bytes = size & (msblk->block_size - 1);
+	int offset = squashfs_i(inode)->fragment_offset;
+	pgoff_t index = (size >> msblk->block_log) <<
+		(msblk->block_log - PAGE_CACHE_SHIFT);
+	struct page *page;
+	void *pageaddr;
+
+	for (; bytes > 0; index++, bytes -= PAGE_CACHE_SIZE,
+			offset += PAGE_CACHE_SIZE) {
+		int avail = min_t(int, bytes, PAGE_CACHE_SIZE);
+
+		page = grab_cache_page_nowait(inode->i_mapping, index);
+		if (!page)
+			continue;
+
+		if (!PageUptodate(page)) {
+			pageaddr = kmap_atomic(page, KM_USER0);
+			squashfs_copy_data(pageaddr, buffer, offset, avail);
+			memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+			kunmap_atomic(pageaddr, KM_USER0);
+			flush_dcache_page(page);
+			SetPageUptodate(page);
+			atomic_long_inc(&msblk->populated_pages);
+		}
+		unlock_page(page);
+		page_cache_release(page);
+	}
+}
+
+
+/*
+ * A fragment block has just been read for inode: fill in the tail ends of
+ * the other files in memory that are packed into the same fragment block,
+ * so that reading them does not decompress it again once it has been
+ * evicted from the small fragment cache.
+ */
+static void squashfs_populate_fragment(struct inode *inode,
+	struct squashfs_cache_entry *buffer)
+{
+	struct inode *sharer[SQUASHFS_FRAG_POPULATE_MAX];
+	int i, n;
+
+	n = squashfs_frag_sharers(inode, sharer, SQUASHFS_FRAG_POPULATE_MAX);
+	for (i = 0; i < n; i++) {
+		squashfs_fill_tail(sharer[i], buffer);
+		iput(sharer[i]);
+	}
+}
+
+
+/*
+ * Decompress a datablock straight into all the page cache pages it covers,
+ * rather than into the single read_page cache entry and copying from
+ * there.  This needs every one of those pages locked and not yet uptodate;
+ * if that cannot be had, return -EAGAIN and leave it to the caller to go
+ * through the cache.  On success, target_page is uptodate but still locked.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct address_space *mapping = target_page->mapping;
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int i, n, pages, avail, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (n = 0; n < pages; n++) {
+		if (start_index + n == target_page->index) {
+			page[n] = target_page;
+			continue;
+		}
+		page[n] = grab_cache_page_nowait(mapping, start_index + n);
+		if (page[n] == NULL)
+			goto release;
+		if (PageUptodate(page[n])) {
+			n++;
+			goto release;
+		}
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+
+	for (i = 0; i < pages; i++) {
+		if (res >= 0) {
+			avail = clamp_t(int, res - (i << PAGE_CACHE_SHIFT), 0,
+				PAGE_CACHE_SIZE);
+			memset(pageaddr[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+		}
+		kunmap(page[i]);
+		if (res >= 0) {
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+	}
+
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+	else
+		res = 0;
+
+release:
+	for (i = 0; i < n; i++) {
+		if (page[i] == target_page)
+			continue;
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -392,6 +538,8 @@ static int squashfs_readpage(struct file *file, struct page *page)
 					PAGE_CACHE_SHIFT))
 		goto out;
 
+	atomic_long_add(PAGE_CACHE_SIZE, &msblk->read_bytes);
+
 	if (index < file_end || squashfs_i(inode)->fragment_block ==
 					SQUASHFS_INVALID_BLK) {
 		/*
@@ -409,6 +557,14 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+			int res = squashfs_readpage_block(page, block, bsize);
+
+			if (res == 0) {
+				unlock_page(page);
+				return 0;
+			} else if (res != -EAGAIN)
+				goto error_out;
+
 			/*
 			 * Read and decompress datablock.
 			 */
@@ -440,6 +596,11 @@ static int squashfs_readpage(struct file *file, struct page *page)
 		}
 		bytes = i_size_read(inode) & (msblk->block_size - 1);
 		offset = squashfs_i(inode)->fragment_offset;
+
+		if (msblk->frag_hash && !buffer->populated) {
+			buffer->populated = 1;
+			squashfs_populate_fragment(inode, buffer);
+		}
 	}
 
 	/*
@@ -36,6 +36,7 @@
 #include <linux/fs.h>
 #include <linux/vfs.h>
 #include <linux/slab.h>
+#include <linux/hash.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -95,3 +96,86 @@ __le64 *squashfs_read_fragment_index_table(struct super_block *sb,
 
 	return fragment_index;
 }
+
+
+/*
+ * With the frag_populate mount option, the regular file inodes in memory
+ * are hashed by fragment block, so that when a fragment block is read the
+ * tail ends of all the files packed into it can be put in the page cache
+ * at once.
+ */
+#define SQUASHFS_FRAG_HASH_BITS	8
+
+int squashfs_frag_hash_init(struct squashfs_sb_info *msblk)
+{
+	int i;
+
+	msblk->frag_hash = kmalloc(sizeof(struct hlist_head) <<
+		SQUASHFS_FRAG_HASH_BITS, GFP_KERNEL);
+	if (msblk->frag_hash == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < 1 << SQUASHFS_FRAG_HASH_BITS; i++)
+		INIT_HLIST_HEAD(&msblk->frag_hash[i]);
+	spin_lock_init(&msblk->frag_lock);
+	return 0;
+}
+
+
+void squashfs_frag_add(struct inode *inode)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	u64 block = squashfs_i(inode)->fragment_block;
+
+	if (msblk->frag_hash == NULL || block == SQUASHFS_INVALID_BLK)
+		return;
+
+	spin_lock(&msblk->frag_lock);
+	hlist_add_head(&squashfs_i(inode)->frag_node,
+		&msblk->frag_hash[hash_64(block, SQUASHFS_FRAG_HASH_BITS)]);
+	spin_unlock(&msblk->frag_lock);
+}
+
+
+void squashfs_frag_del(struct inode *inode)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+
+	if (hlist_unhashed(&squashfs_i(inode)->frag_node))
+		return;
+
+	spin_lock(&msblk->frag_lock);
+	hlist_del_init(&squashfs_i(inode)->frag_node);
+	spin_unlock(&msblk->frag_lock);
+}
+
+
+/*
+ * Find up to max other inodes whose tail end is in the same fragment
+ * block as inode's, and take a reference to each.  Return how many.
+ */
+int squashfs_frag_sharers(struct inode *inode, struct inode **sharer,
+	int max)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	u64 block = squashfs_i(inode)->fragment_block;
+	struct squashfs_inode_info *ei;
+	struct hlist_node *pos;
+	int n = 0;
+
+	spin_lock(&msblk->frag_lock);
+	hlist_for_each_entry(ei, pos,
+		&msblk->frag_hash[hash_64(block, SQUASHFS_FRAG_HASH_BITS)],
+		frag_node) {
+		if (n == max)
+			break;
+		if (ei->fragment_block != block || &ei->vfs_inode == inode)
+			continue;
+		sharer[n] = igrab(&ei->vfs_inode);
+		if (sharer[n])
+			n++;
+	}
+	spin_unlock(&msblk->frag_lock);
+
+	return n;
+}
@@ -171,6 +171,7 @@ int squashfs_read_inode(struct inode *inode, long long ino)
 		squashfs_i(inode)->block_list_start = block;
 		squashfs_i(inode)->offset = offset;
 		inode->i_data.a_ops = &squashfs_aops;
+		squashfs_frag_add(inode);
 
 		TRACE("File inode %x:%x, start_block %llx, block_list_start "
 			"%llx, offset %x\n", SQUASHFS_INODE_BLK(ino),
@@ -218,6 +219,7 @@ int squashfs_read_inode(struct inode *inode, long long ino)
 		squashfs_i(inode)->block_list_start = block;
 		squashfs_i(inode)->offset = offset;
 		inode->i_data.a_ops = &squashfs_aops;
+		squashfs_frag_add(inode);
 
 		TRACE("File inode %x:%x, start_block %llx, block_list_start "
 			"%llx, offset %x\n", SQUASHFS_INODE_BLK(ino),
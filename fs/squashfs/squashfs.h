@@ -62,6 +62,10 @@ extern __le64 *squashfs_read_inode_lookup_table(struct super_block *, u64,
 extern int squashfs_frag_lookup(struct super_block *, unsigned int, u64 *);
 extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
 				u64, unsigned int);
+extern int squashfs_frag_hash_init(struct squashfs_sb_info *);
+extern void squashfs_frag_add(struct inode *);
+extern void squashfs_frag_del(struct inode *);
+extern int squashfs_frag_sharers(struct inode *, struct inode **, int);
 
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
@@ -104,3 +108,6 @@ extern const struct xattr_handler *squashfs_xattr_handlers[];
 
 /* zlib_wrapper.c */
 extern const struct squashfs_decompressor squashfs_zlib_comp_ops;
+
+/* lzo_wrapper.c */
+extern const struct squashfs_decompressor squashfs_lzo_comp_ops;
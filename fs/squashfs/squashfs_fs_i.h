@@ -43,6 +43,7 @@ struct squashfs_inode_info {
 			int		parent;
 		};
 	};
+	struct hlist_node frag_node;	/* in msblk->frag_hash */
 	struct inode	vfs_inode;
 };
 #endif
@@ -33,6 +33,8 @@ struct squashfs_cache {
 	int			unused;
 	int			block_size;
 	int			pages;
+	unsigned long		hits;
+	unsigned long		misses;
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
@@ -45,6 +47,7 @@ struct squashfs_cache_entry {
 	u64			next_index;
 	int			pending;
 	int			error;
+	int			populated;
 	int			num_waiters;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache	*cache;
@@ -75,5 +78,15 @@ struct squashfs_sb_info {
 	long long				bytes_used;
 	unsigned int				inodes;
 	int					xattr_ids;
+	int					metadata_cache_entries;
+	int					fragment_cache_entries;
+	int					frag_populate;
+	struct hlist_head			*frag_hash;
+	spinlock_t				frag_lock;
+	struct proc_dir_entry			*proc;
+	atomic_long_t				decompressions;
+	atomic_long_t				decompressed_bytes;
+	atomic_long_t				read_bytes;
+	atomic_long_t				populated_pages;
 };
 #endif
@@ -37,6 +37,10 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/parser.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/mount.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -47,6 +51,7 @@
 
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
+static struct proc_dir_entry *squashfs_proc_root;
 
 static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 	major, short minor, short id)
@@ -75,6 +80,131 @@ static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 }
 
 
+/* Upper limit for the metadata_cache= and fragment_cache= mount options */
+#define SQUASHFS_MAX_CACHE_ENTRIES	64
+
+enum {
+	Opt_metadata_cache, Opt_fragment_cache, Opt_frag_populate, Opt_err
+};
+
+static const match_table_t squashfs_tokens = {
+	{Opt_metadata_cache, "metadata_cache=%u"},
+	{Opt_fragment_cache, "fragment_cache=%u"},
+	{Opt_frag_populate, "frag_populate"},
+	{Opt_err, NULL}
+};
+
+/*
+ * Squashfs used to ignore any mount options, so unknown or bad ones are
+ * warned about rather than failing the mount.
+ */
+static void squashfs_parse_options(struct squashfs_sb_info *msblk,
+	char *options)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p;
+	int option;
+
+	msblk->metadata_cache_entries = SQUASHFS_CACHED_BLKS;
+	msblk->fragment_cache_entries = SQUASHFS_CACHED_FRAGMENTS;
+
+	if (options == NULL)
+		return;
+
+	while ((p = strsep(&options, ",")) != NULL) {
+		int token;
+
+		if (!*p)
+			continue;
+
+		token = match_token(p, squashfs_tokens, args);
+		switch (token) {
+		case Opt_metadata_cache:
+		case Opt_fragment_cache:
+			if (match_int(&args[0], &option) || option < 1 ||
+					option > SQUASHFS_MAX_CACHE_ENTRIES) {
+				WARNING("Ignoring invalid cache size \"%s\"\n",
+					p);
+				break;
+			}
+			if (token == Opt_metadata_cache)
+				msblk->metadata_cache_entries = option;
+			else
+				msblk->fragment_cache_entries = option;
+			break;
+		case Opt_frag_populate:
+			msblk->frag_populate = 1;
+			break;
+		default:
+			WARNING("Ignoring unrecognised mount option \"%s\"\n",
+				p);
+			break;
+		}
+	}
+}
+
+
+static void squashfs_cache_stats(struct seq_file *m,
+	struct squashfs_cache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	spin_lock(&cache->lock);
+	seq_printf(m, "%s_cache: entries %d hits %lu misses %lu\n",
+		cache->name, cache->entries, cache->hits, cache->misses);
+	spin_unlock(&cache->lock);
+}
+
+
+/*
+ * /proc/fs/squashfs/<dev>: how much decompression it takes to read the
+ * file data, and how the caches are doing.
+ */
+static int squashfs_stats_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	unsigned long decompressions = atomic_long_read(&msblk->decompressions);
+	unsigned long read_bytes = atomic_long_read(&msblk->read_bytes);
+	u64 per_mb = 0;
+
+	if (read_bytes) {
+		per_mb = (u64)decompressions << 20;
+		do_div(per_mb, read_bytes);
+	}
+
+	seq_printf(m, "decompressions: %lu\n", decompressions);
+	seq_printf(m, "decompressed_bytes: %lu\n",
+		atomic_long_read(&msblk->decompressed_bytes));
+	seq_printf(m, "read_bytes: %lu\n", read_bytes);
+	seq_printf(m, "decompressions_per_mb_read: %llu\n",
+		(unsigned long long)per_mb);
+	seq_printf(m, "populated_pages: %lu\n",
+		atomic_long_read(&msblk->populated_pages));
+	squashfs_cache_stats(m, msblk->block_cache);
+	squashfs_cache_stats(m, msblk->fragment_cache);
+	squashfs_cache_stats(m, msblk->read_page);
+
+	return 0;
+}
+
+
+static int squashfs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, squashfs_stats_show, PDE(inode)->data);
+}
+
+
+static const struct file_operations squashfs_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = squashfs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+
 static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct squashfs_sb_info *msblk;
@@ -108,6 +238,8 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
 
+	squashfs_parse_options(msblk, data);
+
 	/*
 	 * msblk->bytes_used is checked in squashfs_read_table to ensure reads
 	 * are not beyond filesystem end.  But as we're using
@@ -205,7 +337,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto failed_mount;
 
 	msblk->block_cache = squashfs_cache_init("metadata",
-			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
+			msblk->metadata_cache_entries, SQUASHFS_METADATA_SIZE);
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
@@ -230,12 +362,18 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto allocate_lookup_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		msblk->fragment_cache_entries, msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
 	}
 
+	if (msblk->frag_populate) {
+		err = squashfs_frag_hash_init(msblk);
+		if (err)
+			goto failed_mount;
+	}
+
 	/* Allocate and read fragment index table */
 	msblk->fragment_index = squashfs_read_fragment_index_table(sb,
 		le64_to_cpu(sblk->fragment_table_start), fragments);
@@ -299,6 +437,10 @@ allocate_root:
 		goto failed_mount;
 	}
 
+	if (squashfs_proc_root)
+		msblk->proc = proc_create_data(sb->s_id, S_IRUGO,
+			squashfs_proc_root, &squashfs_stats_fops, sb);
+
 	TRACE("Leaving squashfs_fill_super\n");
 	kfree(sblk);
 	return 0;
@@ -308,6 +450,7 @@ failed_mount:
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
 	squashfs_decompressor_free(msblk, msblk->stream);
+	kfree(msblk->frag_hash);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
@@ -345,6 +488,23 @@ static int squashfs_statfs(struct dentry *dentry, struct kstatfs *buf)
 }
 
 
+static int squashfs_show_options(struct seq_file *m, struct vfsmount *mnt)
+{
+	struct squashfs_sb_info *msblk = mnt->mnt_sb->s_fs_info;
+
+	if (msblk->metadata_cache_entries != SQUASHFS_CACHED_BLKS)
+		seq_printf(m, ",metadata_cache=%d",
+			msblk->metadata_cache_entries);
+	if (msblk->fragment_cache_entries != SQUASHFS_CACHED_FRAGMENTS)
+		seq_printf(m, ",fragment_cache=%d",
+			msblk->fragment_cache_entries);
+	if (msblk->frag_populate)
+		seq_puts(m, ",frag_populate");
+
+	return 0;
+}
+
+
 static int squashfs_remount(struct super_block *sb, int *flags, char *data)
 {
 	*flags |= MS_RDONLY;
@@ -358,6 +518,8 @@ static void squashfs_put_super(struct super_block *sb)
 
 	if (sb->s_fs_info) {
 		struct squashfs_sb_info *sbi = sb->s_fs_info;
+		if (sbi->proc)
+			remove_proc_entry(sb->s_id, squashfs_proc_root);
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
@@ -367,6 +529,7 @@ static void squashfs_put_super(struct super_block *sb)
 		kfree(sbi->meta_index);
 		kfree(sbi->inode_lookup_table);
 		kfree(sbi->xattr_id_table);
+		kfree(sbi->frag_hash);
 		kfree(sb->s_fs_info);
 		sb->s_fs_info = NULL;
 	}
@@ -407,6 +570,7 @@ static int __init init_inodecache(void)
 
 static void destroy_inodecache(void)
 {
+	rcu_barrier();
 	kmem_cache_destroy(squashfs_inode_cachep);
 }
 
@@ -424,6 +588,8 @@ static int __init init_squashfs_fs(void)
 		return err;
 	}
 
+	squashfs_proc_root = proc_mkdir("fs/squashfs", NULL);
+
 	printk(KERN_INFO "squashfs: version 4.0 (2009/01/31) "
 		"Phillip Lougher\n");
 
@@ -433,6 +599,8 @@ static int __init init_squashfs_fs(void)
 
 static void __exit exit_squashfs_fs(void)
 {
+	if (squashfs_proc_root)
+		remove_proc_entry("fs/squashfs", NULL);
 	unregister_filesystem(&squashfs_fs_type);
 	destroy_inodecache();
 }
@@ -443,22 +611,32 @@ static struct inode *squashfs_alloc_inode(struct super_block *sb)
 	struct squashfs_inode_info *ei =
 		kmem_cache_alloc(squashfs_inode_cachep, GFP_KERNEL);
 
-	return ei ? &ei->vfs_inode : NULL;
+	if (ei == NULL)
+		return NULL;
+	INIT_HLIST_NODE(&ei->frag_node);
+	return &ei->vfs_inode;
 }
 
 
-static void squashfs_destroy_inode(struct inode *inode)
+static void squashfs_i_callback(struct rcu_head *head)
 {
+	struct inode *inode = container_of(head, struct inode, i_rcu);
 	kmem_cache_free(squashfs_inode_cachep, squashfs_i(inode));
 }
 
+static void squashfs_destroy_inode(struct inode *inode)
+{
+	squashfs_frag_del(inode);
+	call_rcu(&inode->i_rcu, squashfs_i_callback);
+}
+
 
 static struct file_system_type squashfs_fs_type = {
 	.owner = THIS_MODULE,
 	.name = "squashfs",
 	.get_sb = squashfs_get_sb,
 	.kill_sb = kill_block_super,
-	.fs_flags = FS_REQUIRES_DEV
+	.fs_flags = FS_REQUIRES_DEV | FS_RCU_WALK
 };
 
 static const struct super_operations squashfs_super_ops = {
@@ -466,6 +644,7 @@ static const struct super_operations squashfs_super_ops = {
 	.destroy_inode = squashfs_destroy_inode,
 	.statfs = squashfs_statfs,
 	.put_super = squashfs_put_super,
+	.show_options = squashfs_show_options,
 	.remount_fs = squashfs_remount
 };
 
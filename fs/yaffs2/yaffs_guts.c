@@ -2866,6 +2866,44 @@ static int yaffs_ReadChunkDataFromObject(yaffs_Object *in, int chunkInInode,
 
 }
 
+/* Read nChunks whole chunks of a file into buffer.
+ * Runs of chunks that sit next to each other in NAND are read in one go.
+ */
+static int yaffs_ReadChunksDataFromObject(yaffs_Object *in, int chunkInInode,
+					int nChunks, __u8 *buffer)
+{
+	yaffs_Device *dev = in->myDev;
+	int chunkInNAND[YAFFS_MAX_CHUNK_BATCH];
+	int i;
+	int run;
+
+	if (nChunks > YAFFS_MAX_CHUNK_BATCH)
+		YBUG();
+
+	for (i = 0; i < nChunks; i++)
+		chunkInNAND[i] = yaffs_FindChunkInFile(in, chunkInInode + i, NULL);
+
+	for (i = 0; i < nChunks; i += run) {
+		run = 1;
+		if (chunkInNAND[i] < 0) {
+			/* get sane (zero) data if you read a hole */
+			memset(buffer + i * dev->nDataBytesPerChunk, 0,
+				dev->nDataBytesPerChunk);
+			continue;
+		}
+
+		while (i + run < nChunks &&
+		       chunkInNAND[i + run] == chunkInNAND[i] + run)
+			run++;
+
+		yaffs_ReadChunksWithTagsFromNAND(dev, chunkInNAND[i], run,
+				buffer + i * dev->nDataBytesPerChunk,
+				dev->batchTags);
+	}
+
+	return nChunks;
+}
+
 void yaffs_DeleteChunk(yaffs_Device *dev, int chunkId, int markNAND, int lyn)
 {
 	int block;
@@ -3176,21 +3214,69 @@ int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   Cache lookups are hashed on (objectId, chunkId) and replacement is strict
+ *   LRU, so the number of cache chunks can be raised to a few hundred without
+ *   each lookup getting slower.
  */
 
+static Y_INLINE struct ylist_head *yaffs_ChunkCacheBucket(yaffs_Device *dev,
+					const yaffs_Object *obj, int chunkId)
+{
+	unsigned hash = (unsigned)obj->objectId * 31 + (unsigned)chunkId;
+
+	return &dev->srHash[hash & (YAFFS_NCACHE_BUCKETS - 1)];
+}
+
+/* Mark a cache as holding no data and move it to the LRU tail for reuse. */
+static void yaffs_ReleaseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (cache->dirty) {
+		ylist_del_init(&cache->dirtyLink);
+		dev->srNDirty--;
+		cache->dirty = 0;
+	}
+	if (cache->object) {
+		ylist_del_init(&cache->hashLink);
+		cache->object = NULL;
+	}
+	ylist_del(&cache->lruLink);
+	ylist_add_tail(&cache->lruLink, &dev->srLru);
+}
+
+/* Bind a cache to (obj, chunkId), dropping whatever it held before. */
+static void yaffs_SetChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
+				yaffs_Object *obj, int chunkId)
+{
+	yaffs_ReleaseChunkCache(dev, cache);
+
+	cache->object = obj;
+	cache->chunkId = chunkId;
+	cache->locked = 0;
+	ylist_add(&cache->hashLink, yaffs_ChunkCacheBucket(dev, obj, chunkId));
+}
+
+/* The cache contents have reached flash. */
+static void yaffs_CleanChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (cache->dirty) {
+		ylist_del_init(&cache->dirtyLink);
+		dev->srNDirty--;
+		cache->dirty = 0;
+	}
+}
+
 static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *i;
 	yaffs_ChunkCache *cache;
-	int nCaches = obj->myDev->param.nShortOpCaches;
 
-	for (i = 0; i < nCaches; i++) {
-		cache = &dev->srCache[i];
-		if (cache->object == obj &&
-		    cache->dirty)
+	if (dev->param.nShortOpCaches <= 0)
+		return 0;
+
+	ylist_for_each(i, &dev->srDirty) {
+		cache = ylist_entry(i, yaffs_ChunkCache, dirtyLink);
+		if (cache->object == obj)
 			return 1;
 	}
 
@@ -3201,50 +3287,50 @@ static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int lowest = -99;	/* Stop compiler whining. */
-	int i;
+	struct ylist_head *i;
 	yaffs_ChunkCache *cache;
-	int chunkWritten = 0;
-	int nCaches = obj->myDev->param.nShortOpCaches;
-
-	if (nCaches > 0) {
-		do {
-			cache = NULL;
-
-			/* Find the dirty cache for this object with the lowest chunk id. */
-			for (i = 0; i < nCaches; i++) {
-				if (dev->srCache[i].object == obj &&
-				    dev->srCache[i].dirty) {
-					if (!cache
-					    || dev->srCache[i].chunkId <
-					    lowest) {
-						cache = &dev->srCache[i];
-						lowest = cache->chunkId;
-					}
-				}
-			}
+	yaffs_ChunkCache **list = dev->srFlushList;
+	int chunkWritten = 1;
+	int nList = 0;
+	int j, k;
 
-			if (cache && !cache->locked) {
-				/* Write it out and free it up */
+	if (dev->param.nShortOpCaches <= 0)
+		return;
 
-				chunkWritten =
-				    yaffs_WriteChunkDataToObject(cache->object,
-								 cache->chunkId,
-								 cache->data,
-								 cache->nBytes,
-								 1);
-				cache->dirty = 0;
-				cache->object = NULL;
-			}
+	/* Gather the object's dirty caches in chunk order so that
+	 * they are written out sequentially.
+	 */
+	ylist_for_each(i, &dev->srDirty) {
+		cache = ylist_entry(i, yaffs_ChunkCache, dirtyLink);
+		if (cache->object != obj)
+			continue;
+		for (k = nList; k > 0 && list[k - 1]->chunkId > cache->chunkId; k--)
+			list[k] = list[k - 1];
+		list[k] = cache;
+		nList++;
+	}
 
-		} while (cache && chunkWritten > 0);
+	for (j = 0; j < nList && chunkWritten > 0; j++) {
+		cache = list[j];
 
-		if (cache) {
-			/* Hoosterman, disk full while writing cache out. */
-			T(YAFFS_TRACE_ERROR,
-			  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
+		if (cache->locked)
+			break;
+
+		/* Write it out and free it up */
+		chunkWritten =
+		    yaffs_WriteChunkDataToObject(cache->object,
+						 cache->chunkId,
+						 cache->data,
+						 cache->nBytes,
+						 1);
+		yaffs_ReleaseChunkCache(dev, cache);
+	}
+
+	if (chunkWritten <= 0 || j < nList) {
+		/* Hoosterman, disk full while writing cache out. */
+		T(YAFFS_TRACE_ERROR,
+		  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
 
-		}
 	}
 
 }
@@ -3256,25 +3342,22 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 
 void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
 {
-	yaffs_Object *obj;
-	int nCaches = dev->param.nShortOpCaches;
-	int i;
-
-	/* Find a dirty object in the cache and flush it...
-	 * until there are no further dirty objects.
-	 */
-	do {
-		obj = NULL;
-		for (i = 0; i < nCaches && !obj; i++) {
-			if (dev->srCache[i].object &&
-			    dev->srCache[i].dirty)
-				obj = dev->srCache[i].object;
+	yaffs_ChunkCache *cache;
+	int nDirty;
 
-		}
-		if (obj)
-			yaffs_FlushFilesChunkCache(obj);
+	if (dev->param.nShortOpCaches <= 0)
+		return;
 
-	} while (obj);
+	/* Flush the object owning the first dirty cache...
+	 * until there are no further dirty objects or no progress is made.
+	 */
+	while (!ylist_empty(&dev->srDirty)) {
+		nDirty = dev->srNDirty;
+		cache = ylist_entry(dev->srDirty.next, yaffs_ChunkCache, dirtyLink);
+		yaffs_FlushFilesChunkCache(cache->object);
+		if (dev->srNDirty >= nDirty)
+			break;
+	}
 
 }
 
@@ -3283,16 +3366,18 @@ void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
  * First look for an empty one.
  * Then look for the least recently used non-dirty one.
  * Then look for the least recently used dirty one...., flush and look again.
+ *
+ * Empty caches are kept at the tail of the LRU list, so the first two
+ * steps only ever look at the tail.
  */
 static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 {
-	int i;
+	yaffs_ChunkCache *cache;
 
 	if (dev->param.nShortOpCaches > 0) {
-		for (i = 0; i < dev->param.nShortOpCaches; i++) {
-			if (!dev->srCache[i].object)
-				return &dev->srCache[i];
-		}
+		cache = ylist_entry(dev->srLru.prev, yaffs_ChunkCache, lruLink);
+		if (!cache->object)
+			return cache;
 	}
 
 	return NULL;
@@ -3301,10 +3386,7 @@ static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 {
 	yaffs_ChunkCache *cache;
-	yaffs_Object *theObj;
-	int usage;
-	int i;
-	int pushout;
+	struct ylist_head *i;
 
 	if (dev->param.nShortOpCaches > 0) {
 		/* Try find a non-dirty one... */
@@ -3312,33 +3394,19 @@ static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 		cache = yaffs_GrabChunkCacheWorker(dev);
 
 		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
-			 * NB what's here is not very accurate, we actually flush the object
-			 * the last recently used page.
+			/* None free: take the least recently used unlocked one.
+			 * If that is dirty, flush its object then find again.
 			 */
-
-			/* With locking we can't assume we can use entry zero */
-
-			theObj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
-
-			for (i = 0; i < dev->param.nShortOpCaches; i++) {
-				if (dev->srCache[i].object &&
-				    !dev->srCache[i].locked &&
-				    (dev->srCache[i].lastUse < usage || !cache)) {
-					usage = dev->srCache[i].lastUse;
-					theObj = dev->srCache[i].object;
-					cache = &dev->srCache[i];
-					pushout = i;
-				}
+			for (i = dev->srLru.prev; i != &dev->srLru; i = i->prev) {
+				cache = ylist_entry(i, yaffs_ChunkCache, lruLink);
+				if (!cache->locked)
+					break;
+				cache = NULL;
 			}
 
-			if (!cache || cache->dirty) {
+			if (cache && cache->dirty) {
 				/* Flush and try again */
-				yaffs_FlushFilesChunkCache(theObj);
+				yaffs_FlushFilesChunkCache(cache->object);
 				cache = yaffs_GrabChunkCacheWorker(dev);
 			}
 
@@ -3354,14 +3422,19 @@ static yaffs_ChunkCache *yaffs_FindChunkCache(const yaffs_Object *obj,
 					      int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *bucket;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
+
 	if (dev->param.nShortOpCaches > 0) {
-		for (i = 0; i < dev->param.nShortOpCaches; i++) {
-			if (dev->srCache[i].object == obj &&
-			    dev->srCache[i].chunkId == chunkId) {
+		bucket = yaffs_ChunkCacheBucket(dev, obj, chunkId);
+		ylist_for_each(i, bucket) {
+			cache = ylist_entry(i, yaffs_ChunkCache, hashLink);
+			if (cache->object == obj &&
+			    cache->chunkId == chunkId) {
 				dev->cacheHits++;
 
-				return &dev->srCache[i];
+				return cache;
 			}
 		}
 	}
@@ -3374,21 +3447,14 @@ static void yaffs_UseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
 {
 
 	if (dev->param.nShortOpCaches > 0) {
-		if (dev->srLastUse < 0 || dev->srLastUse > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->param.nShortOpCaches; i++)
-				dev->srCache[i].lastUse = 0;
-
-			dev->srLastUse = 0;
-		}
+		ylist_del(&cache->lruLink);
+		ylist_add(&cache->lruLink, &dev->srLru);
 
-		dev->srLastUse++;
-
-		cache->lastUse = dev->srLastUse;
-
-		if (isAWrite)
+		if (isAWrite && !cache->dirty) {
 			cache->dirty = 1;
+			ylist_add_tail(&cache->dirtyLink, &dev->srDirty);
+			dev->srNDirty++;
+		}
 	}
 }
 
@@ -3402,7 +3468,7 @@ static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId)
 		yaffs_ChunkCache *cache = yaffs_FindChunkCache(object, chunkId);
 
 		if (cache)
-			cache->object = NULL;
+			yaffs_ReleaseChunkCache(object->myDev, cache);
 	}
 }
 
@@ -3418,7 +3484,7 @@ static void yaffs_InvalidateWholeChunkCache(yaffs_Object *in)
 		/* Invalidate it. */
 		for (i = 0; i < dev->param.nShortOpCaches; i++) {
 			if (dev->srCache[i].object == in)
-				dev->srCache[i].object = NULL;
+				yaffs_ReleaseChunkCache(dev, &dev->srCache[i]);
 		}
 	}
 }
@@ -3476,10 +3542,7 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 
 				if (!cache) {
 					cache = yaffs_GrabChunkCache(in->myDev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_SetChunkCache(dev, cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->
 								      data);
@@ -3510,9 +3573,23 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 			}
 
 		} else {
+			/* Full chunks. Read directly into the supplied buffer,
+			 * taking as many uncached whole chunks as we can in one go.
+			 */
+			int nChunks = 1;
+
+			while (nChunks < YAFFS_MAX_CHUNK_BATCH &&
+			       n - nToCopy >= dev->nDataBytesPerChunk &&
+			       !yaffs_FindChunkCache(in, chunk + nChunks)) {
+				nChunks++;
+				nToCopy += dev->nDataBytesPerChunk;
+			}
 
-			/* A full chunk. Read directly into the supplied buffer. */
-			yaffs_ReadChunkDataFromObject(in, chunk, buffer);
+			if (nChunks > 1)
+				yaffs_ReadChunksDataFromObject(in, chunk,
+							nChunks, buffer);
+			else
+				yaffs_ReadChunkDataFromObject(in, chunk, buffer);
 
 		}
 
@@ -3603,10 +3680,7 @@ int yaffs_DoWriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 				if (!cache
 				    && yaffs_CheckSpaceForAllocation(dev, 1)) {
 					cache = yaffs_GrabChunkCache(dev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_SetChunkCache(dev, cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->data);
 				} else if (cache &&
@@ -3637,7 +3711,7 @@ int yaffs_DoWriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 						     cache->chunkId,
 						     cache->data, cache->nBytes,
 						     1);
-						cache->dirty = 0;
+						yaffs_CleanChunkCache(dev, cache);
 					}
 
 				} else {
@@ -5293,6 +5367,7 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 		init_failed = 1;
 
 	dev->srCache = NULL;
+	dev->srFlushList = NULL;
 	dev->gcCleanupList = NULL;
 
 
@@ -5300,28 +5375,38 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	    dev->param.nShortOpCaches > 0) {
 		int i;
 		void *buf;
-		int srCacheBytes = dev->param.nShortOpCaches * sizeof(yaffs_ChunkCache);
+		int srCacheBytes;
 
 		if (dev->param.nShortOpCaches > YAFFS_MAX_SHORT_OP_CACHES)
 			dev->param.nShortOpCaches = YAFFS_MAX_SHORT_OP_CACHES;
 
+		srCacheBytes = dev->param.nShortOpCaches * sizeof(yaffs_ChunkCache);
+
 		dev->srCache =  YMALLOC(srCacheBytes);
+		dev->srFlushList = YMALLOC(dev->param.nShortOpCaches *
+					   sizeof(yaffs_ChunkCache *));
 
-		buf = (__u8 *) dev->srCache;
+		buf = dev->srFlushList ? (__u8 *) dev->srCache : NULL;
 
 		if (dev->srCache)
 			memset(dev->srCache, 0, srCacheBytes);
 
+		for (i = 0; i < YAFFS_NCACHE_BUCKETS; i++)
+			YINIT_LIST_HEAD(&dev->srHash[i]);
+		YINIT_LIST_HEAD(&dev->srLru);
+		YINIT_LIST_HEAD(&dev->srDirty);
+		dev->srNDirty = 0;
+
 		for (i = 0; i < dev->param.nShortOpCaches && buf; i++) {
+			YINIT_LIST_HEAD(&dev->srCache[i].hashLink);
+			YINIT_LIST_HEAD(&dev->srCache[i].dirtyLink);
+			ylist_add_tail(&dev->srCache[i].lruLink, &dev->srLru);
 			dev->srCache[i].object = NULL;
-			dev->srCache[i].lastUse = 0;
 			dev->srCache[i].dirty = 0;
 			dev->srCache[i].data = buf = YMALLOC_DMA(dev->param.totalBytesPerChunk);
 		}
 		if (!buf)
 			init_failed = 1;
-
-		dev->srLastUse = 0;
 	}
 
 	dev->cacheHits = 0;
@@ -5399,6 +5484,7 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 
 	/* Zero out stats */
 	dev->nPageReads = 0;
+	dev->nBatchedReads = 0;
 	dev->nPageWrites = 0;
 	dev->nBlockErasures = 0;
 	dev->nGCCopies = 0;
@@ -5439,6 +5525,10 @@ void yaffs_Deinitialise(yaffs_Device *dev)
 			dev->srCache = NULL;
 		}
 
+		if (dev->srFlushList)
+			YFREE(dev->srFlushList);
+		dev->srFlushList = NULL;
+
 		YFREE(dev->gcCleanupList);
 
 		for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++)
@@ -5485,7 +5575,6 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 	int nFree;
 	int nDirtyCacheChunks;
 	int blocksForCheckpoint;
-	int i;
 
 #if 1
 	nFree = dev->nFreeChunks;
@@ -5497,10 +5586,7 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 
 	/* Now count the number of dirty chunks in the cache and subtract those */
 
-	for (nDirtyCacheChunks = 0, i = 0; i < dev->param.nShortOpCaches; i++) {
-		if (dev->srCache[i].dirty)
-			nDirtyCacheChunks++;
-	}
+	nDirtyCacheChunks = (dev->param.nShortOpCaches > 0) ? dev->srNDirty : 0;
 
 	nFree -= nDirtyCacheChunks;
 
@@ -88,10 +88,18 @@
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+#define YAFFS_MAX_SHORT_OP_CACHES	512
+
+/* Short op cache lookups are hashed on (objectId, chunkId).
+ * Must be a power of 2.
+ */
+#define YAFFS_NCACHE_BUCKETS		128
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
+/* Maximum number of physically contiguous chunks read in one driver call */
+#define YAFFS_MAX_CHUNK_BATCH		8
+
 /* We limit the number attempts at sucessfully saving a chunk of data.
  * Small-page devices have 32 pages per block; large-page devices have 64.
  * Default to something in the order of 5 to 10 blocks worth of chunks.
@@ -111,11 +119,17 @@
 /* Special sequence number for bad block that failed to be marked bad */
 #define YAFFS_SEQUENCE_BAD_BLOCK	0xFFFF0000
 
-/* ChunkCache is used for short read/write operations.*/
+/* ChunkCache is used for short read/write operations.
+ * A cache in use is on its hash bucket, and on the device dirty list if dirty.
+ * All caches are on the LRU list, most recently used first, with the free
+ * ones gathered at the tail.
+ */
 typedef struct {
+	struct ylist_head hashLink;
+	struct ylist_head lruLink;
+	struct ylist_head dirtyLink;
 	struct yaffs_ObjectStruct *object;
 	int chunkId;
-	int lastUse;
 	int dirty;
 	int nBytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
@@ -534,8 +548,9 @@ struct yaffs_DeviceParamStruct {
 
 
 	int nShortOpCaches;	/* If <= 0, then short op caching is disabled, else
-				 * the number of short op caches (don't use too many).
-                                 * 10 to 20 is a good bet.
+				 * the number of short op caches.
+				 * Lookups are hashed so this can be a few hundred
+				 * if there is RAM for it. 10 to 20 is a good bet.
 				 */
 	int useNANDECC;		/* Flag to decide whether or not to use NANDECC on data (yaffs1) */
 	int noTagsECC;		/* Flag to decide whether or not to do ECC on packed tags (yaffs2) */ 
@@ -572,6 +587,12 @@ struct yaffs_DeviceParamStruct {
 	int (*readChunkWithTagsFromNAND) (struct yaffs_DeviceStruct *dev,
 					  int chunkInNAND, __u8 *data,
 					  yaffs_ExtendedTags *tags);
+	/* Optional: read nChunks consecutive chunks into data, one set of
+	 * tags per chunk. At most YAFFS_MAX_CHUNK_BATCH chunks are asked for.
+	 */
+	int (*readChunksWithTagsFromNAND) (struct yaffs_DeviceStruct *dev,
+					  int chunkInNAND, int nChunks,
+					  __u8 *data, yaffs_ExtendedTags *tags);
 	int (*markNANDBlockBad) (struct yaffs_DeviceStruct *dev, int blockNo);
 	int (*queryNANDBlock) (struct yaffs_DeviceStruct *dev, int blockNo,
 			       yaffs_BlockState *state, __u32 *sequenceNumber);
@@ -719,7 +740,11 @@ struct yaffs_DeviceStruct {
 	int doingBufferedBlockRewrite;
 
 	yaffs_ChunkCache *srCache;
-	int srLastUse;
+	struct ylist_head srHash[YAFFS_NCACHE_BUCKETS];
+	struct ylist_head srLru;	/* Most recently used first */
+	struct ylist_head srDirty;	/* Caches holding unwritten data */
+	int srNDirty;
+	yaffs_ChunkCache **srFlushList;	/* Scratch for ordering a file flush */
 
 	/* Stuff for background deletion and unlinked files.*/
 	yaffs_Object *unlinkedDir;	/* Directory where unlinked and deleted files live. */
@@ -736,6 +761,9 @@ struct yaffs_DeviceStruct {
 	int unmanagedTempAllocations;
 	int unmanagedTempDeallocations;
 
+	/* Tags for batched reads */
+	yaffs_ExtendedTags batchTags[YAFFS_MAX_CHUNK_BATCH];
+
 	/* yaffs2 runtime stuff */
 	unsigned sequenceNumber;	/* Sequence number of currently allocating block */
 	unsigned oldestDirtySequence;
@@ -751,6 +779,7 @@ struct yaffs_DeviceStruct {
 	/* Statistcs */
 	__u32 nPageWrites;
 	__u32 nPageReads;
+	__u32 nBatchedReads;
 	__u32 nBlockErasures;
 	__u32 nErasureFailures;
 	__u32 nGCCopies;
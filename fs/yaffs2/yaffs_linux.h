@@ -29,6 +29,9 @@ struct yaffs_LinuxContext {
 	__u8 *spareBuffer;      /* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
 				 */
+	__u8 *readBuffer;	/* For readpages: a run of pages covering up
+				 * to YAFFS_MAX_CHUNK_BATCH chunks.
+				 */
 	struct ylist_head searchContexts;
 	void (*putSuperFunc)(struct super_block *sb);
 
@@ -193,6 +193,66 @@ int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 		return YAFFS_FAIL;
 }
 
+/* Read a run of consecutive chunks with one MTD call so that the driver
+ * can stream the pages instead of paying the command overhead per chunk.
+ * With MTD_OOB_AUTO each page contributes oobavail bytes to the spare buffer.
+ * If the batched read reports any error, fall back to reading the chunks
+ * one at a time so that each chunk gets its own ECC result.
+ */
+int nandmtd2_ReadChunksWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
+					int nChunks, __u8 *data,
+					yaffs_ExtendedTags *tags)
+{
+	int i;
+	int retval = -EINVAL;
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
+	struct mtd_info *mtd = yaffs_DeviceToMtd(dev);
+	struct mtd_oob_ops ops;
+	__u8 *spare = yaffs_DeviceToLC(dev)->spareBuffer;
+
+	loff_t addr = ((loff_t) chunkInNAND) * dev->param.totalBytesPerChunk;
+
+	yaffs_PackedTags2 pt;
+
+	int packed_tags_size = dev->param.noTagsECC ? sizeof(pt.t) : sizeof(pt);
+	void * packed_tags_ptr = dev->param.noTagsECC ? (void *) &pt.t: (void *)&pt;
+
+	T(YAFFS_TRACE_MTD,
+	  (TSTR
+	   ("nandmtd2_ReadChunksWithTagsFromNAND chunk %d n %d data %p tags %p"
+	    TENDSTR), chunkInNAND, nChunks, data, tags));
+
+	if (!dev->param.inbandTags && nChunks <= YAFFS_MAX_CHUNK_BATCH) {
+		ops.mode = MTD_OOB_AUTO;
+		ops.ooblen = nChunks * mtd->oobavail;
+		ops.len = nChunks * dev->nDataBytesPerChunk;
+		ops.ooboffs = 0;
+		ops.datbuf = data;
+		ops.oobbuf = spare;
+		retval = mtd->read_oob(mtd, addr, &ops);
+	}
+
+	if (retval == 0) {
+		for (i = 0; i < nChunks; i++) {
+			memcpy(packed_tags_ptr, spare + i * mtd->oobavail,
+				packed_tags_size);
+			yaffs_UnpackTags2(&tags[i], &pt, !dev->param.noTagsECC);
+		}
+		return YAFFS_OK;
+	}
+#endif
+
+	retval = YAFFS_OK;
+	for (i = 0; i < nChunks; i++) {
+		if (nandmtd2_ReadChunkWithTagsFromNAND(dev, chunkInNAND + i,
+				data + i * dev->nDataBytesPerChunk,
+				&tags[i]) != YAFFS_OK)
+			retval = YAFFS_FAIL;
+	}
+
+	return retval;
+}
+
 int nandmtd2_MarkNANDBlockBad(struct yaffs_DeviceStruct *dev, int blockNo)
 {
 	struct mtd_info *mtd = yaffs_DeviceToMtd(dev);
@@ -51,6 +51,46 @@ int yaffs_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 	return result;
 }
 
+/* Read nChunks chunks that are consecutive in NAND into buffer.
+ * tags must have room for nChunks entries.
+ */
+int yaffs_ReadChunksWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
+					int nChunks, __u8 *buffer,
+					yaffs_ExtendedTags *tags)
+{
+	int result = YAFFS_OK;
+	int realignedChunkInNAND = chunkInNAND - dev->chunkOffset;
+	int i;
+
+	if (!dev->param.readChunksWithTagsFromNAND || nChunks < 2) {
+		for (i = 0; i < nChunks; i++) {
+			if (yaffs_ReadChunkWithTagsFromNAND(dev, chunkInNAND + i,
+					buffer + i * dev->nDataBytesPerChunk,
+					&tags[i]) != YAFFS_OK)
+				result = YAFFS_FAIL;
+		}
+		return result;
+	}
+
+	dev->nPageReads += nChunks;
+	dev->nBatchedReads++;
+
+	result = dev->param.readChunksWithTagsFromNAND(dev,
+					realignedChunkInNAND, nChunks,
+					buffer, tags);
+
+	for (i = 0; i < nChunks; i++) {
+		if (tags[i].eccResult > YAFFS_ECC_RESULT_NO_ERROR) {
+			yaffs_BlockInfo *bi;
+			bi = yaffs_GetBlockInfo(dev,
+				(chunkInNAND + i)/dev->param.nChunksPerBlock);
+			yaffs_HandleChunkError(dev, bi);
+		}
+	}
+
+	return result;
+}
+
 int yaffs_WriteChunkWithTagsToNAND(yaffs_Device *dev,
 						   int chunkInNAND,
 						   const __u8 *buffer,
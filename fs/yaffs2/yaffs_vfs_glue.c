@@ -301,6 +301,10 @@ static void yaffs_clear_inode(struct inode *);
 
 static int yaffs_readpage(struct file *file, struct page *page);
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
+static int yaffs_readpages(struct file *file, struct address_space *mapping,
+			struct list_head *pages, unsigned nr_pages);
+#endif
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
 static int yaffs_writepage(struct page *page, struct writeback_control *wbc);
 #else
 static int yaffs_writepage(struct page *page);
@@ -349,6 +353,9 @@ static int yaffs_vfs_setattr(struct inode *, struct iattr *);
 
 static struct address_space_operations yaffs_file_address_operations = {
 	.readpage = yaffs_readpage,
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
+	.readpages = yaffs_readpages,
+#endif
 	.writepage = yaffs_writepage,
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 	.write_begin = yaffs_write_begin,
@@ -1057,6 +1064,99 @@ static int yaffs_readpage(struct file *f, struct page *pg)
 	return ret;
 }
 
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
+/* Readahead. A single readpage only covers a chunk or two, so runs of
+ * consecutive pages are read with one yaffs_ReadDataFromFile() call into
+ * the device's read buffer, letting it batch up to YAFFS_MAX_CHUNK_BATCH
+ * chunks per NAND read.
+ */
+static int yaffs_readpages(struct file *f, struct address_space *mapping,
+			struct list_head *pages, unsigned nr_pages)
+{
+	yaffs_Object *obj = yaffs_DentryToObject(f->f_dentry);
+	yaffs_Device *dev = obj->myDev;
+	struct yaffs_LinuxContext *lc = yaffs_DeviceToLC(dev);
+	struct page *run[YAFFS_MAX_CHUNK_BATCH];
+	struct page *pg;
+	unsigned char *pg_buf;
+	int maxPages;
+	int nPages;
+	int ret;
+	int i;
+
+	T(YAFFS_TRACE_OS, (TSTR("yaffs_readpages %u pages\n"), nr_pages));
+
+	maxPages = (YAFFS_MAX_CHUNK_BATCH * dev->nDataBytesPerChunk) >>
+			PAGE_CACHE_SHIFT;
+	if (maxPages > YAFFS_MAX_CHUNK_BATCH)
+		maxPages = YAFFS_MAX_CHUNK_BATCH;
+
+	if (maxPages > 1) {
+		yaffs_GrossLock(dev);
+		if (!lc->readBuffer)
+			lc->readBuffer = YMALLOC(maxPages << PAGE_CACHE_SHIFT);
+		if (!lc->readBuffer)
+			maxPages = 1;
+		yaffs_GrossUnlock(dev);
+	}
+
+	while (!list_empty(pages)) {
+		nPages = 0;
+		while (!list_empty(pages) && nPages < maxPages) {
+			pg = list_entry(pages->prev, struct page, lru);
+			if (nPages && pg->index != run[0]->index + nPages)
+				break;
+			list_del(&pg->lru);
+			if (add_to_page_cache_lru(pg, mapping, pg->index,
+						GFP_KERNEL)) {
+				page_cache_release(pg);
+				if (nPages)
+					break;
+				continue;
+			}
+			run[nPages++] = pg;
+		}
+
+		if (nPages == 1) {
+			yaffs_readpage_unlock(f, run[0]);
+			page_cache_release(run[0]);
+			continue;
+		}
+
+		yaffs_GrossLock(dev);
+
+		ret = yaffs_ReadDataFromFile(obj, lc->readBuffer,
+				((loff_t)run[0]->index) << PAGE_CACHE_SHIFT,
+				nPages << PAGE_CACHE_SHIFT);
+
+		for (i = 0; i < nPages && ret >= 0; i++) {
+			pg_buf = kmap(run[i]);
+			memcpy(pg_buf, lc->readBuffer + (i << PAGE_CACHE_SHIFT),
+				PAGE_CACHE_SIZE);
+			flush_dcache_page(run[i]);
+			kunmap(run[i]);
+		}
+
+		yaffs_GrossUnlock(dev);
+
+		for (i = 0; i < nPages; i++) {
+			if (ret >= 0) {
+				SetPageUptodate(run[i]);
+				ClearPageError(run[i]);
+			} else {
+				ClearPageUptodate(run[i]);
+				SetPageError(run[i]);
+			}
+			UnlockPage(run[i]);
+			page_cache_release(run[i]);
+		}
+	}
+
+	T(YAFFS_TRACE_OS, (TSTR("yaffs_readpages done\n")));
+	return 0;
+}
+#endif
+
 /* writepage inspired by/stolen from smbfs */
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
@@ -2577,6 +2677,11 @@ static void yaffs_put_super(struct super_block *sb)
 		yaffs_DeviceToLC(dev)->spareBuffer = NULL;
 	}
 
+	if (yaffs_DeviceToLC(dev)->readBuffer) {
+		YFREE(yaffs_DeviceToLC(dev)->readBuffer);
+		yaffs_DeviceToLC(dev)->readBuffer = NULL;
+	}
+
 	kfree(dev);
 }
 
@@ -2606,6 +2711,7 @@ typedef struct {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int n_caches;
 	int tags_ecc_on;
 	int tags_ecc_overridden;
 	int lazy_loading_enabled;
@@ -2660,6 +2766,8 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options->empty_lost_and_found_overridden=1;
 		} else if (!strcmp(cur_opt, "no-cache"))
 			options->no_cache = 1;
+		else if (!strncmp(cur_opt, "cache-size=", 11))
+			options->n_caches = simple_strtoul(cur_opt + 11, NULL, 0);
 		else if (!strcmp(cur_opt, "no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-write"))
@@ -2916,7 +3024,8 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	param->nChunksPerBlock = YAFFS_CHUNKS_PER_BLOCK;
 	param->totalBytesPerChunk = YAFFS_BYTES_PER_CHUNK;
 	param->nReservedBlocks = 5;
-	param->nShortOpCaches = (options.no_cache) ? 0 : 10;
+	param->nShortOpCaches = (options.no_cache) ? 0 :
+				(options.n_caches ? options.n_caches : 10);
 	param->inbandTags = options.inband_tags;
 
 #ifdef CONFIG_YAFFS_DISABLE_LAZY_LOAD
@@ -2963,9 +3072,13 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 		    nandmtd2_WriteChunkWithTagsToNAND;
 		param->readChunkWithTagsFromNAND =
 		    nandmtd2_ReadChunkWithTagsFromNAND;
+		param->readChunksWithTagsFromNAND =
+		    nandmtd2_ReadChunksWithTagsFromNAND;
 		param->markNANDBlockBad = nandmtd2_MarkNANDBlockBad;
 		param->queryNANDBlock = nandmtd2_QueryNANDBlock;
-		yaffs_DeviceToLC(dev)->spareBuffer = YMALLOC(mtd->oobsize);
+		/* Big enough for the oob of a batched read */
+		yaffs_DeviceToLC(dev)->spareBuffer =
+			YMALLOC(mtd->oobsize * YAFFS_MAX_CHUNK_BATCH);
 		param->isYaffs2 = 1;
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
 		param->totalBytesPerChunk = mtd->writesize;
@@ -3120,7 +3233,7 @@ static struct file_system_type yaffs_fs_type = {
 	.name = "yaffs",
 	.get_sb = yaffs_read_super,
 	.kill_sb = kill_block_super,
-	.fs_flags = FS_REQUIRES_DEV,
+	.fs_flags = FS_REQUIRES_DEV | FS_RCU_WALK,
 };
 #else
 static struct super_block *yaffs_read_super(struct super_block *sb, void *data,
@@ -3167,7 +3280,7 @@ static struct file_system_type yaffs2_fs_type = {
 	.name = "yaffs2",
 	.get_sb = yaffs2_read_super,
 	.kill_sb = kill_block_super,
-	.fs_flags = FS_REQUIRES_DEV,
+	.fs_flags = FS_REQUIRES_DEV | FS_RCU_WALK,
 };
 #else
 static struct super_block *yaffs2_read_super(struct super_block *sb,
@@ -3221,6 +3334,7 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "\n");
 	buf += sprintf(buf, "nPageWrites........ %u\n", dev->nPageWrites);
 	buf += sprintf(buf, "nPageReads......... %u\n", dev->nPageReads);
+	buf += sprintf(buf, "nBatchedReads...... %u\n", dev->nBatchedReads);
 	buf += sprintf(buf, "nBlockErasures..... %u\n", dev->nBlockErasures);
 	buf += sprintf(buf, "nGCCopies.......... %u\n", dev->nGCCopies);
 	buf += sprintf(buf, "allGCs............. %u\n", dev->allGCs);
@@ -179,6 +179,8 @@ struct buffer_head *__bread(struct block_device *, sector_t block, unsigned size
 void invalidate_bh_lrus(void);
 struct buffer_head *alloc_buffer_head(gfp_t gfp_flags);
 void free_buffer_head(struct buffer_head * bh);
+int alloc_buffer_heads(gfp_t gfp_flags, int nr, struct buffer_head **bhs);
+void free_buffer_heads(int nr, struct buffer_head **bhs);
 void unlock_buffer(struct buffer_head *bh);
 void __lock_buffer(struct buffer_head *bh);
 void ll_rw_block(int, int, struct buffer_head * bh[]);
@@ -0,0 +1,65 @@
+#ifndef __LINUX_CCACHE_H
+#define __LINUX_CCACHE_H
+/*
+ * Compressed page cache.
+ *
+ * Clean file pages chosen for eviction by page reclaim are compressed
+ * into a bounded pool of RAM, and refaults of those pages are served
+ * from the pool instead of going back to the backing device.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+
+#ifdef CONFIG_CCACHE
+int ccache_put_page(struct page *page);
+int ccache_readpage(struct page *page);
+void ccache_read_pages(struct address_space *mapping,
+			struct list_head *pages, unsigned *nr_pages);
+void __ccache_invalidate_range(struct address_space *mapping,
+			pgoff_t start, pgoff_t end);
+
+/*
+ * Drop any compressed copies of pages start..end (inclusive) of mapping.
+ * Must be called after the page cache itself has been invalidated, so
+ * that no page being put by reclaim can slip in behind us.
+ */
+static inline void ccache_invalidate_range(struct address_space *mapping,
+			pgoff_t start, pgoff_t end)
+{
+	if (test_bit(AS_CCACHE, &mapping->flags))
+		__ccache_invalidate_range(mapping, start, end);
+}
+
+static inline void ccache_invalidate_inode(struct address_space *mapping)
+{
+	ccache_invalidate_range(mapping, 0, ~0UL);
+}
+#else
+static inline int ccache_put_page(struct page *page)
+{
+	return 0;
+}
+
+static inline int ccache_readpage(struct page *page)
+{
+	return 0;
+}
+
+static inline void ccache_read_pages(struct address_space *mapping,
+			struct list_head *pages, unsigned *nr_pages)
+{
+}
+
+static inline void ccache_invalidate_range(struct address_space *mapping,
+			pgoff_t start, pgoff_t end)
+{
+}
+
+static inline void ccache_invalidate_inode(struct address_space *mapping)
+{
+}
+#endif /* !CONFIG_CCACHE */
+
+#endif /* __LINUX_CCACHE_H */
@@ -180,6 +180,13 @@ struct inodes_stat_t {
 #define FS_RENAME_DOES_D_MOVE	32768	/* FS will handle d_move()
 					 * during rename() internally.
 					 */
+#define FS_RCU_WALK	65536	/* Path walk may pass through directories
+				 * under rcu_read_lock() alone: inodes are
+				 * freed after an RCU grace period, d_hash
+				 * and d_compare neither sleep nor look at
+				 * d_inode, and d_revalidate always accepts
+				 * a positive dentry.
+				 */
 
 /*
  * These are the fs-independent mount-flags: up to 32 flags are supported
@@ -728,7 +735,10 @@ struct inode {
 	struct hlist_node	i_hash;
 	struct list_head	i_list;		/* backing dev IO list */
 	struct list_head	i_sb_list;
-	struct list_head	i_dentry;
+	union {
+		struct list_head	i_dentry;
+		struct rcu_head		i_rcu;
+	};
 	unsigned long		i_ino;
 	atomic_t		i_count;
 	unsigned int		i_nlink;
@@ -950,6 +960,9 @@ struct file {
 #ifdef CONFIG_DEBUG_WRITECOUNT
 	unsigned long f_mnt_write_state;
 #endif
+#ifdef CONFIG_READAHEAD_HISTORY
+	struct ra_history	*f_ra_history;
+#endif
 };
 extern spinlock_t files_lock;
 #define file_list_lock() spin_lock(&files_lock);
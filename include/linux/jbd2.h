@@ -75,6 +75,12 @@ extern void jbd2_free(void *ptr, size_t size);
 
 #define JBD2_MIN_JOURNAL_BLOCKS 1024
 
+/*
+ * Size of the fast commit area carved out of the end of the log when the
+ * superblock does not specify one.
+ */
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS 256
+
 #ifdef __KERNEL__
 
 /**
@@ -241,7 +247,11 @@ typedef struct journal_superblock_s
 	__be32	s_max_trans_data;	/* Limit of data blocks per trans. */
 
 /* 0x0050 */
-	__u32	s_padding[44];
+	__u32	s_padding2;
+	__be32	s_num_fc_blks;		/* Nr of fast commit blocks */
+
+/* 0x0058 */
+	__u32	s_padding[42];
 
 /* 0x0100 */
 	__u8	s_users[16*48];		/* ids of all fs'es sharing the log */
@@ -263,13 +273,15 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_REVOKE		0x00000001
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000020
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
 #define JBD2_KNOWN_ROCOMPAT_FEATURES	0
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
-					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
+					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -651,10 +663,16 @@ struct transaction_run_stats_s {
 	unsigned long		rs_locked;
 	unsigned long		rs_flushing;
 	unsigned long		rs_logging;
+	/* Breakdown of rs_logging: */
+	unsigned long		rs_submit;	/* writing out log blocks */
+	unsigned long		rs_data_wait;	/* waiting for ordered data */
+	unsigned long		rs_log_wait;	/* waiting for log blocks */
+	unsigned long		rs_commit_wait;	/* writing the commit record */
 
 	__u32			rs_handle_count;
 	__u32			rs_blocks;
 	__u32			rs_blocks_logged;
+	__u32			rs_blocks_released; /* released while logging */
 };
 
 struct transaction_stats_s {
@@ -740,6 +758,11 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_history_lock: Protect the transactions statistics history
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
+ * @j_fc_first: The block number of the first block of the fast commit area
+ * @j_fc_last: The block number one beyond the fast commit area
+ * @j_fc_off: Number of fast commit blocks written since the last full commit
+ * @j_fc_wait: Wait queue for a fast commit or full commit to finish
+ * @j_fc_replay_callback: Called by recovery for each fast commit block
  * @j_private: An opaque pointer to fs-private information.
  */
 
@@ -972,6 +995,30 @@ struct journal_s
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
 
+	/*
+	 * Fast commit area: blocks [j_fc_first, j_fc_last) at the end of
+	 * the journal, outside the log.  Fast commits of the running
+	 * transaction are appended at j_fc_off, which is reset by the
+	 * next full commit.  [JBD2_FAST_COMMIT_ONGOING]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+
+	/* Wait queue for JBD2_FAST_COMMIT_ONGOING to be cleared */
+	wait_queue_head_t	j_fc_wait;
+
+	/*
+	 * Called by recovery, after the log has been replayed, for each
+	 * block of the fast commit area in turn.  Returns 0 to go on,
+	 * JBD2_FC_REPLAY_STOP at the end of the valid fast commits, or a
+	 * negative error.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *journal,
+							struct buffer_head *bh,
+							int off,
+							tid_t expected_tid);
+
 	/*
 	 * An opaque pointer to fs-private information.  ext3 puts its
 	 * superblock pointer here
@@ -991,6 +1038,11 @@ struct journal_s
 #define JBD2_ABORT_ON_SYNCDATA_ERR	0x040	/* Abort the journal on file
 						 * data write error in ordered
 						 * mode */
+#define JBD2_FAST_COMMIT_ONGOING	0x080	/* A fast commit is writing
+						 * to the fast commit area */
+#define JBD2_FULL_COMMIT_ONGOING	0x100	/* A full commit has started */
+
+#define JBD2_FC_REPLAY_STOP	1
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1127,6 +1179,11 @@ extern void	   jbd2_journal_ack_err    (journal_t *);
 extern int	   jbd2_journal_clear_err  (journal_t *);
 extern int	   jbd2_journal_bmap(journal_t *, unsigned long, unsigned long long *);
 extern int	   jbd2_journal_force_commit(journal_t *);
+extern int	   jbd2_fc_begin_commit(journal_t *, tid_t);
+extern void	   jbd2_fc_end_commit(journal_t *);
+extern void	   jbd2_fc_end_commit_fallback(journal_t *);
+extern int	   jbd2_fc_get_buf(journal_t *, struct buffer_head **);
+extern int	   jbd2_fc_write_buf(journal_t *, struct buffer_head *);
 extern int	   jbd2_journal_file_inode(handle_t *handle, struct jbd2_inode *inode);
 extern int	   jbd2_journal_begin_ordered_truncate(journal_t *journal,
 				struct jbd2_inode *inode, loff_t new_size);
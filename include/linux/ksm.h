@@ -23,6 +23,7 @@ struct page *ksm_does_need_to_copy(struct page *page,
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
+void ksm_auto_merge(struct vm_area_struct *vma);
 void __ksm_exit(struct mm_struct *mm);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
@@ -106,6 +107,10 @@ static inline int PageKsm(struct page *page)
 	return 0;
 }
 
+static inline void ksm_auto_merge(struct vm_area_struct *vma)
+{
+}
+
 #ifdef CONFIG_MMU
 static inline int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
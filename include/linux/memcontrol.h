@@ -127,6 +127,7 @@ static inline bool mem_cgroup_disabled(void)
 }
 
 void mem_cgroup_update_file_mapped(struct page *page, int val);
+void mem_cgroup_note_reclaim(struct page *page, bool reclaimed);
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 						gfp_t gfp_mask, int nid,
 						int zid);
@@ -302,6 +303,10 @@ static inline void mem_cgroup_update_file_mapped(struct page *page,
 {
 }
 
+static inline void mem_cgroup_note_reclaim(struct page *page, bool reclaimed)
+{
+}
+
 static inline
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 					    gfp_t gfp_mask, int nid, int zid)
@@ -35,6 +35,11 @@
  */
 #define PAGE_ALLOC_COSTLY_ORDER 3
 
+/*
+ * Orders 1..PCP_MAX_ORDER are also cached on the per-cpu page lists.
+ */
+#define PCP_MAX_ORDER PAGE_ALLOC_COSTLY_ORDER
+
 #define MIGRATE_UNMOVABLE     0
 #define MIGRATE_RECLAIMABLE   1
 #define MIGRATE_MOVABLE       2
@@ -104,6 +109,8 @@ enum zone_stat_item {
 	NR_ISOLATED_ANON,	/* Temporary isolated pages from anon lru */
 	NR_ISOLATED_FILE,	/* Temporary isolated pages from file lru */
 	NR_SHMEM,		/* shmem pages (included tmpfs/GEM pages) */
+	DIRECT_STALL,		/* direct reclaims entered for this zone */
+	DIRECT_STALL_MS,	/* time spent in those direct reclaims */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -173,6 +180,10 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Pages held in the lists of order-1..PCP_MAX_ORDER blocks */
+	int high_count;
+	struct list_head high_lists[PCP_MAX_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
@@ -283,6 +294,16 @@ struct zone {
 	/* zone watermarks, access with *_wmark_pages(zone) macros */
 	unsigned long watermark[NR_WMARK];
 
+	/*
+	 * Part of the low and high watermarks set by kswapd to cover
+	 * watermark_headroom_ms worth of the recent allocation rate
+	 * (pages per second), sampled from the PGALLOC counters.
+	 */
+	unsigned long watermark_boost;
+	unsigned long alloc_rate;
+	unsigned long alloc_events;
+	unsigned long alloc_stamp;
+
 	/*
 	 * When free pages are below this point, additional steps are taken
 	 * when reading the number of free pages to avoid per-cpu counter
@@ -0,0 +1,39 @@
+#ifndef __LINUX_RA_HISTORY_H
+#define __LINUX_RA_HISTORY_H
+/*
+ * Readahead history.
+ *
+ * Records which pages of a file are touched in the first moments after it
+ * is opened, and reads those pages ahead in one batch the next time it is
+ * opened, so that repeated program launches do not fault them in one by one.
+ */
+
+#include <linux/fs.h>
+
+struct ra_history;
+
+#ifdef CONFIG_READAHEAD_HISTORY
+void ra_history_open(struct file *file);
+void ra_history_release(struct file *file);
+void __ra_history_access(struct ra_history *history, pgoff_t index);
+
+static inline void ra_history_access(struct file *file, pgoff_t index)
+{
+	if (file->f_ra_history)
+		__ra_history_access(file->f_ra_history, index);
+}
+#else
+static inline void ra_history_open(struct file *file)
+{
+}
+
+static inline void ra_history_release(struct file *file)
+{
+}
+
+static inline void ra_history_access(struct file *file, pgoff_t index)
+{
+}
+#endif /* !CONFIG_READAHEAD_HISTORY */
+
+#endif /* __LINUX_RA_HISTORY_H */
@@ -753,6 +753,10 @@ struct task_delay_info {
 	struct timespec freepages_start, freepages_end;
 	u64 freepages_delay;	/* wait for memory reclaim */
 	u32 freepages_count;	/* total count of memory reclaim */
+
+	struct timespec compact_start, compact_end;
+	u64 compact_delay;	/* wait for memory compaction */
+	u32 compact_count;	/* total count of memory compaction */
 };
 #endif	/* CONFIG_TASK_DELAY_ACCT */
 
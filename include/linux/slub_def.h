@@ -47,9 +47,11 @@ struct kmem_cache_node {
 	spinlock_t list_lock;	/* Protect partial list and nr_partial */
 	unsigned long nr_partial;
 	struct list_head partial;
-#ifdef CONFIG_SLUB_DEBUG
+#if defined(CONFIG_SLUB_DEBUG) || defined(CONFIG_SLUB_STATS)
 	atomic_long_t nr_slabs;
 	atomic_long_t total_objects;
+#endif
+#ifdef CONFIG_SLUB_DEBUG
 	struct list_head full;
 #endif
 };
@@ -42,10 +42,17 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PGINODESTEAL, SLABS_SCANNED, KSWAPD_STEAL, KSWAPD_INODESTEAL,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
-		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		PAGEOUTRUN, ALLOCSTALL,
+		/* direct reclaim durations, each bucket 4x the previous */
+		ALLOCSTALL_LT_1MS, ALLOCSTALL_LT_4MS, ALLOCSTALL_LT_16MS,
+		ALLOCSTALL_LT_64MS, ALLOCSTALL_LT_256MS, ALLOCSTALL_LT_1024MS,
+		ALLOCSTALL_GE_1024MS,
+		PGROTATED,
+		LRU_BATCH_DRAIN, LRU_BATCH_PAGES, LRU_BATCH_CONTENDED,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
-		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS, COMPACTSTALLUSECS,
+		KCOMPACTDWAKE, KCOMPACTDPAGES, KCOMPACTDSUCCESS, KCOMPACTDUSECS,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -101,6 +108,7 @@ static inline void count_vm_events(enum vm_event_item item, long delta)
 }
 
 extern void all_vm_events(unsigned long *);
+extern unsigned long sum_vm_event(enum vm_event_item item);
 #ifdef CONFIG_HOTPLUG
 extern void vm_events_fold_cpu(int cpu);
 #else
@@ -127,6 +135,10 @@ static inline void __count_vm_events(enum vm_event_item item, long delta)
 static inline void all_vm_events(unsigned long *ret)
 {
 }
+static inline unsigned long sum_vm_event(enum vm_event_item item)
+{
+	return 0;
+}
 static inline void vm_events_fold_cpu(int cpu)
 {
 }
@@ -93,6 +93,8 @@ extern unsigned int core_pipe_limit;
 extern int pid_max;
 extern int min_free_kbytes;
 extern int min_free_order_shift;
+extern int extra_free_kbytes;
+extern int watermark_headroom_ms;
 extern int pid_max_min, pid_max_max;
 extern int sysctl_drop_caches;
 extern int percpu_pagelist_fraction;
@@ -267,6 +269,8 @@ static int max_sched_shares_ratelimit = NSEC_PER_SEC; /* 1 second */
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int max_compact_proactive_order = MAX_ORDER - 1;
+static int max_compact_proactive_centisecs = 60 * 60 * 100; /* one hour */
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -1145,6 +1149,32 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compact_proactive_order",
+		.data		= &sysctl_compact_proactive_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_compact_proactive_handler,
+		.extra1		= &zero,
+		.extra2		= &max_compact_proactive_order,
+	},
+	{
+		.procname	= "compact_proactive_blocks",
+		.data		= &sysctl_compact_proactive_blocks,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_compact_proactive_handler,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "compact_proactive_centisecs",
+		.data		= &sysctl_compact_proactive_centisecs,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_compact_proactive_handler,
+		.extra1		= &zero,
+		.extra2		= &max_compact_proactive_centisecs,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
@@ -1155,6 +1185,22 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= min_free_kbytes_sysctl_handler,
 		.extra1		= &zero,
 	},
+	{
+		.procname	= "extra_free_kbytes",
+		.data		= &extra_free_kbytes,
+		.maxlen		= sizeof(extra_free_kbytes),
+		.mode		= 0644,
+		.proc_handler	= min_free_kbytes_sysctl_handler,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "watermark_headroom_ms",
+		.data		= &watermark_headroom_ms,
+		.maxlen		= sizeof(watermark_headroom_ms),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 	{
 		.procname	= "min_free_order_shift",
 		.data		= &min_free_order_shift,
@@ -28,6 +28,7 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/shmem_fs.h>
+#include <linux/ksm.h>
 #include <linux/ashmem.h>
 
 #define ASHMEM_NAME_PREFIX "dev/ashmem/"
@@ -327,6 +328,9 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	}
 	vma->vm_flags |= VM_CAN_NONLINEAR;
 
+	/* private copies of the region's pages are candidates for merging */
+	ksm_auto_merge(vma);
+
 out:
 	mutex_unlock(&ashmem_mutex);
 	return ret;
@@ -0,0 +1,608 @@
+/*
+ * mm/ccache.c
+ *
+ * Compressed cache for clean page-cache pages.
+ *
+ * When page reclaim is about to drop a clean page of a regular file on a
+ * block device, ccache_put_page() keeps an LZO-compressed copy of it in a
+ * pool bounded by max_pool_pages.  A later read, readahead or fault of that
+ * page finds the copy before ->readpage(s) is called, decompresses it and
+ * takes it out of the pool: a page lives either in the page cache or here,
+ * never in both.  The oldest copies are dropped when the pool is full.
+ *
+ * Coherency rests on two rules.  A copy is only made while reclaim holds
+ * the page lock, just before the page leaves the page cache, so anyone
+ * truncating or invalidating the file must wait for it.  And every path
+ * that removes pages from the page cache for reasons other than reclaim
+ * (truncate, invalidate, direct I/O write, inode teardown) calls
+ * ccache_invalidate_range() after it has done so.  A page that reclaim
+ * does not store, for whatever reason, also loses any older copy: the
+ * page cache may have been refilled behind the pool's back since then.
+ *
+ * The pool is also given back to the system through a shrinker, oldest
+ * copies first, when memory is short.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/radix-tree.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
+#include <linux/kobject.h>
+#include <linux/swap.h>
+#include <linux/lzo.h>
+#include <linux/ccache.h>
+
+/*
+ * Never dip into the reserves: ccache_put_page() runs from reclaim with
+ * PF_MEMALLOC set, and a compressed copy is not worth an emergency page.
+ */
+#define CCACHE_GFP	(GFP_NOWAIT | __GFP_NOWARN | __GFP_NOMEMALLOC)
+
+/* Pages which do not compress to this size are not worth keeping */
+#define CCACHE_MAX_LEN	(PAGE_SIZE * 3 / 4)
+
+#define CCACHE_HASH_SHIFT	8
+#define CCACHE_BATCH		16
+
+/* One per address_space with compressed pages in the pool */
+struct ccache_mapping {
+	struct hlist_node link;
+	struct address_space *mapping;
+	struct radix_tree_root pages;
+	unsigned long nr_pages;
+};
+
+struct ccache_entry {
+	struct list_head lru;		/* on ccache_lru, oldest at the tail */
+	struct ccache_mapping *cm;
+	pgoff_t index;
+	unsigned int len;
+	unsigned int size;		/* ksize() of the entry, for the pool */
+	u8 data[0];
+};
+
+/* Protects the hash, the radix trees, the lru and the pool size */
+static DEFINE_SPINLOCK(ccache_lock);
+static struct hlist_head ccache_hash[1 << CCACHE_HASH_SHIFT];
+static LIST_HEAD(ccache_lru);
+
+static unsigned long ccache_stored_pages;
+static unsigned long ccache_pool_bytes;
+
+/* Tunables */
+static unsigned int ccache_enabled;	/* set once ccache_init() is done */
+static unsigned long ccache_max_pool_pages;
+
+/* Event counts for sysfs: not worth any locking */
+static unsigned long ccache_puts;
+static unsigned long ccache_rejects;
+static unsigned long ccache_lookups;
+static unsigned long ccache_hits;
+static unsigned long ccache_evicts;
+static unsigned long ccache_invalidates;
+
+/* Compression scratch space, used with preemption disabled */
+static DEFINE_PER_CPU(void *, ccache_workmem);
+static DEFINE_PER_CPU(u8 *, ccache_buffer);
+
+static struct ccache_mapping *ccache_find_mapping(struct address_space *mapping)
+{
+	struct hlist_head *bucket;
+	struct hlist_node *node;
+	struct ccache_mapping *cm;
+
+	bucket = &ccache_hash[hash_ptr(mapping, CCACHE_HASH_SHIFT)];
+	hlist_for_each_entry(cm, node, bucket, link)
+		if (cm->mapping == mapping)
+			return cm;
+	return NULL;
+}
+
+static struct ccache_mapping *ccache_get_mapping(struct address_space *mapping)
+{
+	struct ccache_mapping *cm;
+
+	cm = ccache_find_mapping(mapping);
+	if (cm)
+		return cm;
+
+	cm = kmalloc(sizeof(*cm), CCACHE_GFP);
+	if (!cm)
+		return NULL;
+	cm->mapping = mapping;
+	INIT_RADIX_TREE(&cm->pages, CCACHE_GFP);
+	cm->nr_pages = 0;
+	hlist_add_head(&cm->link,
+		       &ccache_hash[hash_ptr(mapping, CCACHE_HASH_SHIFT)]);
+	set_bit(AS_CCACHE, &mapping->flags);
+	return cm;
+}
+
+/* Free the ccache_mapping once its last page has gone */
+static void ccache_release_mapping(struct ccache_mapping *cm)
+{
+	if (cm->nr_pages)
+		return;
+	clear_bit(AS_CCACHE, &cm->mapping->flags);
+	hlist_del(&cm->link);
+	kfree(cm);
+}
+
+/*
+ * Take entry out of the pool.  The caller frees it after dropping
+ * ccache_lock, and calls ccache_release_mapping() on its cm.
+ */
+static void ccache_unlink_entry(struct ccache_entry *entry)
+{
+	radix_tree_delete(&entry->cm->pages, entry->index);
+	list_del(&entry->lru);
+	entry->cm->nr_pages--;
+	ccache_stored_pages--;
+	ccache_pool_bytes -= entry->size;
+}
+
+/* Take the oldest entry out of the pool and put it on list */
+static void ccache_evict_oldest(struct list_head *list)
+{
+	struct ccache_entry *entry;
+	struct ccache_mapping *cm;
+
+	entry = list_entry(ccache_lru.prev, struct ccache_entry, lru);
+	cm = entry->cm;
+	ccache_unlink_entry(entry);
+	ccache_release_mapping(cm);
+	list_add(&entry->lru, list);
+}
+
+/* Trim the pool down to size, collecting the victims on list */
+static void ccache_shrink(unsigned long max_bytes, struct list_head *list)
+{
+	while (ccache_pool_bytes > max_bytes)
+		ccache_evict_oldest(list);
+}
+
+static unsigned long ccache_free_list(struct list_head *list)
+{
+	struct ccache_entry *entry, *next;
+	unsigned long nr = 0;
+
+	list_for_each_entry_safe(entry, next, list, lru) {
+		kfree(entry);
+		nr++;
+	}
+	return nr;
+}
+
+/* Only regular files on block devices: everything else is cheap to reread */
+static int ccache_mapping_eligible(struct address_space *mapping)
+{
+	struct inode *inode = mapping->host;
+
+	return inode && S_ISREG(inode->i_mode) && inode->i_sb->s_bdev;
+}
+
+static int ccache_eligible(struct address_space *mapping, struct page *page)
+{
+	if (!ccache_mapping_eligible(mapping))
+		return 0;
+	if (!PageUptodate(page) || PageDirty(page) || PageWriteback(page))
+		return 0;
+	/* Anyone else holding the page will make __remove_mapping() fail */
+	if (page_mapped(page) || page_count(page) != 2)
+		return 0;
+	return 1;
+}
+
+/**
+ * ccache_put_page - keep a compressed copy of a page about to be reclaimed
+ * @page: locked, clean page-cache page
+ *
+ * Called by shrink_page_list() just before __remove_mapping().  If that
+ * then fails, the caller must invalidate the copy again.  Returns 1 if a
+ * copy was stored.
+ */
+int ccache_put_page(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	struct ccache_mapping *cm;
+	struct ccache_entry *entry, *old;
+	void **slot;
+	LIST_HEAD(victims);
+	size_t len;
+	u8 *src, *dst;
+	int ret;
+
+	VM_BUG_ON(!PageLocked(page));
+
+	if (!mapping)
+		return 0;
+	if (!ccache_enabled || !ccache_eligible(mapping, page))
+		goto drop_old;
+
+	dst = get_cpu_var(ccache_buffer);
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &len,
+			       __get_cpu_var(ccache_workmem));
+	kunmap_atomic(src, KM_USER0);
+
+	entry = NULL;
+	if (ret == LZO_E_OK && len <= CCACHE_MAX_LEN) {
+		entry = kmalloc(sizeof(*entry) + len, CCACHE_GFP);
+		if (entry)
+			memcpy(entry->data, dst, len);
+	}
+	put_cpu_var(ccache_buffer);
+
+	if (!entry)
+		goto reject;
+	entry->index = page->index;
+	entry->len = len;
+	entry->size = ksize(entry);
+
+	spin_lock(&ccache_lock);
+	cm = ccache_get_mapping(mapping);
+	if (!cm)
+		goto fail;
+	entry->cm = cm;
+
+	slot = radix_tree_lookup_slot(&cm->pages, entry->index);
+	if (slot) {
+		/* Stale copy of an earlier incarnation of this page */
+		old = radix_tree_deref_slot(slot);
+		radix_tree_replace_slot(slot, entry);
+		list_move(&old->lru, &victims);
+		ccache_pool_bytes -= old->size;
+	} else {
+		if (radix_tree_insert(&cm->pages, entry->index, entry)) {
+			ccache_release_mapping(cm);
+			goto fail;
+		}
+		cm->nr_pages++;
+		ccache_stored_pages++;
+	}
+	list_add(&entry->lru, &ccache_lru);
+	ccache_pool_bytes += entry->size;
+
+	ccache_shrink(ccache_max_pool_pages << PAGE_SHIFT, &victims);
+	spin_unlock(&ccache_lock);
+
+	ccache_puts++;
+	ccache_evicts += ccache_free_list(&victims);
+	return 1;
+
+fail:
+	spin_unlock(&ccache_lock);
+	kfree(entry);
+reject:
+	ccache_rejects++;
+drop_old:
+	/* An older copy must not outlive the page it was made from */
+	ccache_invalidate_range(mapping, page->index, page->index);
+	return 0;
+}
+
+/*
+ * Remove and return the copy of page index of mapping, if there is one.
+ * Nothing is handed back for pages wholly beyond EOF: they may have
+ * been truncated away since the copy was made.
+ */
+static struct ccache_entry *ccache_take(struct address_space *mapping,
+					pgoff_t index)
+{
+	struct ccache_mapping *cm;
+	struct ccache_entry *entry = NULL;
+	loff_t isize;
+
+	if (!ccache_mapping_eligible(mapping))
+		return NULL;
+	ccache_lookups++;
+	if (!test_bit(AS_CCACHE, &mapping->flags))
+		return NULL;
+
+	spin_lock(&ccache_lock);
+	cm = ccache_find_mapping(mapping);
+	if (cm) {
+		entry = radix_tree_lookup(&cm->pages, index);
+		if (entry) {
+			ccache_unlink_entry(entry);
+			ccache_release_mapping(cm);
+		}
+	}
+	spin_unlock(&ccache_lock);
+
+	if (!entry)
+		return NULL;
+
+	isize = i_size_read(mapping->host);
+	if (!isize || index > (isize - 1) >> PAGE_CACHE_SHIFT) {
+		kfree(entry);
+		ccache_invalidates++;
+		return NULL;
+	}
+	return entry;
+}
+
+/* Decompress entry into page and free it: returns 1 on success */
+static int ccache_fill_page(struct ccache_entry *entry, struct page *page)
+{
+	size_t len = PAGE_SIZE;
+	u8 *dst;
+	int ret;
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(entry->data, entry->len, dst, &len);
+	kunmap_atomic(dst, KM_USER0);
+	kfree(entry);
+
+	if (WARN_ON_ONCE(ret != LZO_E_OK || len != PAGE_SIZE))
+		return 0;
+	flush_dcache_page(page);
+	ccache_hits++;
+	return 1;
+}
+
+/**
+ * ccache_readpage - satisfy a page-cache read from the compressed cache
+ * @page: locked, !uptodate page-cache page
+ *
+ * Returns 1, with the page uptodate and unlocked, if it was found in the
+ * compressed cache.  Otherwise returns 0 with the page still locked, and
+ * the caller goes on to ->readpage().
+ */
+int ccache_readpage(struct page *page)
+{
+	struct ccache_entry *entry;
+
+	VM_BUG_ON(!PageLocked(page));
+
+	entry = ccache_take(page->mapping, page->index);
+	if (!entry || !ccache_fill_page(entry, page))
+		return 0;
+
+	SetPageUptodate(page);
+	unlock_page(page);
+	return 1;
+}
+
+/**
+ * ccache_read_pages - satisfy readahead from the compressed cache
+ * @mapping: address_space being read
+ * @pages: list of new pages, not yet in the page cache
+ * @nr_pages: number of pages on @pages
+ *
+ * Pages found in the compressed cache are filled, added to the page
+ * cache and taken off @pages; @nr_pages is reduced to match.  The
+ * rest are left for ->readpages() or ->readpage().
+ */
+void ccache_read_pages(struct address_space *mapping,
+			struct list_head *pages, unsigned *nr_pages)
+{
+	struct ccache_entry *entry;
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, pages, lru) {
+		entry = ccache_take(mapping, page->index);
+		if (!entry)
+			continue;
+		list_del(&page->lru);
+		(*nr_pages)--;
+		if (ccache_fill_page(entry, page) &&
+		    !add_to_page_cache_lru(page, mapping,
+					   page->index, GFP_KERNEL)) {
+			SetPageUptodate(page);
+			unlock_page(page);
+		}
+		page_cache_release(page);
+	}
+}
+
+void __ccache_invalidate_range(struct address_space *mapping,
+			pgoff_t start, pgoff_t end)
+{
+	struct ccache_entry *batch[CCACHE_BATCH];
+	struct ccache_mapping *cm;
+	LIST_HEAD(victims);
+	pgoff_t next;
+	unsigned int i, nr;
+
+	while (start <= end) {
+		spin_lock(&ccache_lock);
+		cm = ccache_find_mapping(mapping);
+		if (!cm) {
+			spin_unlock(&ccache_lock);
+			break;
+		}
+		nr = radix_tree_gang_lookup(&cm->pages, (void **)batch,
+					    start, CCACHE_BATCH);
+		next = 0;
+		for (i = 0; i < nr && batch[i]->index <= end; i++) {
+			next = batch[i]->index + 1;
+			ccache_unlink_entry(batch[i]);
+			list_add(&batch[i]->lru, &victims);
+		}
+		ccache_release_mapping(cm);
+		spin_unlock(&ccache_lock);
+
+		ccache_invalidates += ccache_free_list(&victims);
+		INIT_LIST_HEAD(&victims);
+
+		/* Short batch, past the end, or index wrapped */
+		if (i < CCACHE_BATCH || !next)
+			break;
+		start = next;
+	}
+}
+
+/* Give back the oldest copies when the system is short of memory */
+static int ccache_shrink_pool(struct shrinker *shrink, int nr_to_scan,
+			      gfp_t gfp_mask)
+{
+	LIST_HEAD(victims);
+
+	if (nr_to_scan) {
+		spin_lock(&ccache_lock);
+		while (nr_to_scan-- && !list_empty(&ccache_lru))
+			ccache_evict_oldest(&victims);
+		spin_unlock(&ccache_lock);
+		ccache_evicts += ccache_free_list(&victims);
+	}
+	return ccache_stored_pages;
+}
+
+static struct shrinker ccache_shrinker = {
+	.shrink = ccache_shrink_pool,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/* Drop the whole pool, as when it is disabled */
+static void ccache_flush(void)
+{
+	LIST_HEAD(victims);
+
+	spin_lock(&ccache_lock);
+	ccache_shrink(0, &victims);
+	spin_unlock(&ccache_lock);
+	ccache_evicts += ccache_free_list(&victims);
+}
+
+#ifdef CONFIG_SYSFS
+#define CCACHE_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define CCACHE_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ccache_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long enabled;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enabled);
+	if (err || enabled > 1)
+		return -EINVAL;
+
+	ccache_enabled = enabled;
+	if (!enabled)
+		ccache_flush();
+
+	return count;
+}
+CCACHE_ATTR(enabled);
+
+static ssize_t max_pool_pages_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ccache_max_pool_pages);
+}
+
+static ssize_t max_pool_pages_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	LIST_HEAD(victims);
+	unsigned long nr_pages;
+	int err;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > totalram_pages / 2)
+		return -EINVAL;
+
+	spin_lock(&ccache_lock);
+	ccache_max_pool_pages = nr_pages;
+	ccache_shrink(nr_pages << PAGE_SHIFT, &victims);
+	spin_unlock(&ccache_lock);
+	ccache_evicts += ccache_free_list(&victims);
+
+	return count;
+}
+CCACHE_ATTR(max_pool_pages);
+
+#define CCACHE_STAT(_name, _value)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%lu\n", (unsigned long)(_value));		\
+}									\
+CCACHE_ATTR_RO(_name)
+
+CCACHE_STAT(stored_pages, ccache_stored_pages);
+CCACHE_STAT(pool_pages, DIV_ROUND_UP(ccache_pool_bytes, PAGE_SIZE));
+CCACHE_STAT(puts, ccache_puts);
+CCACHE_STAT(rejects, ccache_rejects);
+CCACHE_STAT(lookups, ccache_lookups);
+CCACHE_STAT(hits, ccache_hits);
+CCACHE_STAT(saved_read_kb, ccache_hits << (PAGE_SHIFT - 10));
+CCACHE_STAT(evicts, ccache_evicts);
+CCACHE_STAT(invalidates, ccache_invalidates);
+
+static struct attribute *ccache_attrs[] = {
+	&enabled_attr.attr,
+	&max_pool_pages_attr.attr,
+	&stored_pages_attr.attr,
+	&pool_pages_attr.attr,
+	&puts_attr.attr,
+	&rejects_attr.attr,
+	&lookups_attr.attr,
+	&hits_attr.attr,
+	&saved_read_kb_attr.attr,
+	&evicts_attr.attr,
+	&invalidates_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ccache_attr_group = {
+	.attrs = ccache_attrs,
+	.name = "ccache",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init ccache_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(ccache_workmem, cpu) =
+			kmalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+		per_cpu(ccache_buffer, cpu) =
+			kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+		if (!per_cpu(ccache_workmem, cpu) ||
+		    !per_cpu(ccache_buffer, cpu))
+			goto out_free;
+	}
+
+	ccache_max_pool_pages = totalram_pages / 16;
+	register_shrinker(&ccache_shrinker);
+	ccache_enabled = 1;
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &ccache_attr_group))
+		printk(KERN_ERR "ccache: register sysfs failed\n");
+#endif
+	return 0;
+
+out_free:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(ccache_workmem, cpu));
+		kfree(per_cpu(ccache_buffer, cpu));
+		per_cpu(ccache_workmem, cpu) = NULL;
+		per_cpu(ccache_buffer, cpu) = NULL;
+	}
+	printk(KERN_ERR "ccache: out of memory, disabled\n");
+	return -ENOMEM;
+}
+module_init(ccache_init)
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/ktime.h>
 #include "internal.h"
 
 /*
@@ -37,6 +40,8 @@ struct compact_control {
 
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
+	unsigned long nr_blocks;	/* free blocks of order kcompactd wants */
+	unsigned long nr_moved;		/* Number of pages migrated */
 	struct zone *zone;
 };
 
@@ -341,6 +346,17 @@ static void update_nr_listpages(struct compact_control *cc)
 	cc->nr_freepages = nr_freepages;
 }
 
+/* Number of free blocks of at least @order, counted in @order units */
+static unsigned long zone_free_blocks(struct zone *zone, unsigned int order)
+{
+	unsigned long blocks = 0;
+	unsigned int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		blocks += zone->free_area[o].nr_free << (o - order);
+	return blocks;
+}
+
 static int compact_finished(struct zone *zone,
 						struct compact_control *cc)
 {
@@ -361,6 +377,14 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	/* kcompactd: are there enough free blocks of the target order? */
+	if (cc->nr_blocks) {
+		if (kthread_should_stop() ||
+		    zone_free_blocks(zone, cc->order) >= cc->nr_blocks)
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Direct compactor: Is a suitable page free? */
 	for (order = cc->order; order < MAX_ORDER; order++) {
 		/* Job done if page is free of the right migratetype */
@@ -398,6 +422,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		update_nr_listpages(cc);
 		nr_remaining = cc->nr_migratepages;
 
+		cc->nr_moved += nr_migrate - nr_remaining;
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
 		if (nr_remaining)
@@ -455,6 +480,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	struct zoneref *z;
 	struct zone *zone;
 	int rc = COMPACT_SKIPPED;
+	ktime_t start;
 
 	/*
 	 * Check whether it is worth even starting compaction. The order check is
@@ -465,6 +491,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		return rc;
 
 	count_vm_event(COMPACTSTALL);
+	start = ktime_get();
 
 	/* Compact each zone in the list */
 	for_each_zone_zonelist_nodemask(zone, z, zonelist, high_zoneidx,
@@ -509,6 +536,8 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			break;
 	}
 
+	count_vm_events(COMPACTSTALLUSECS,
+			ktime_us_delta(ktime_get(), start));
 	return rc;
 }
 
@@ -583,6 +612,177 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * Proactive compaction.  kcompactd wakes every compact_proactive_centisecs,
+ * or sooner when a high-order allocation enters the slow path, and
+ * compacts each zone holding fewer than compact_proactive_blocks free
+ * blocks of compact_proactive_order or larger.  Zones whose shortfall is
+ * down to a lack of free memory rather than fragmentation, as judged by
+ * the fragmentation index against extfrag_threshold, are left to kswapd.
+ * When compaction cannot meet the target, kcompactd backs off and
+ * ignores allocator wakeups for a while rather than spin on it.
+ */
+int sysctl_compact_proactive_order = PAGE_ALLOC_COSTLY_ORDER + 1;
+int sysctl_compact_proactive_blocks = 8;
+int sysctl_compact_proactive_centisecs = 500;
+
+#define KCOMPACTD_MAX_BACKOFF	5
+
+static struct task_struct *kcompactd_task;
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static int kcompactd_woken;
+static unsigned int kcompactd_backoff;
+
+static bool kcompactd_zone_needed(struct zone *zone, unsigned int order,
+					unsigned long target)
+{
+	unsigned long watermark;
+	int fragindex;
+
+	if (zone_free_blocks(zone, order) >= target)
+		return false;
+
+	/* There must be enough free memory to form the blocks from */
+	watermark = high_wmark_pages(zone) + (target << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	/* Only compact if the shortfall is due to fragmentation */
+	fragindex = fragmentation_index(zone, order);
+	if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
+		return false;
+
+	return true;
+}
+
+/* Returns the number of zones still short of the target */
+static int kcompactd_do_work(void)
+{
+	unsigned int order = sysctl_compact_proactive_order;
+	unsigned long target = sysctl_compact_proactive_blocks;
+	struct zone *zone;
+	int drained = 0;
+	int nr_short = 0;
+
+	if (!order || !target)
+		return 0;
+
+	for_each_populated_zone(zone) {
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.nr_blocks = target,
+			.nr_moved = 0,
+			.zone = zone,
+		};
+		ktime_t start;
+
+		if (kthread_should_stop())
+			break;
+		if (!kcompactd_zone_needed(zone, order, target))
+			continue;
+
+		/* Flush pending updates to the LRU lists */
+		if (!drained) {
+			lru_add_drain_all();
+			drained = 1;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		start = ktime_get();
+		compact_zone(zone, &cc);
+		count_vm_events(KCOMPACTDUSECS,
+				ktime_us_delta(ktime_get(), start));
+		count_vm_events(KCOMPACTDPAGES, cc.nr_moved);
+
+		/* Page migration frees to the PCP lists but we want merging */
+		drain_all_pages();
+
+		if (zone_free_blocks(zone, order) >= target)
+			count_vm_event(KCOMPACTDSUCCESS);
+		else
+			nr_short++;
+	}
+
+	return nr_short;
+}
+
+static int kcompactd(void *p)
+{
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		long timeout = MAX_SCHEDULE_TIMEOUT;
+
+		if (sysctl_compact_proactive_centisecs)
+			timeout = msecs_to_jiffies(
+				sysctl_compact_proactive_centisecs * 10)
+					<< kcompactd_backoff;
+
+		wait_event_freezable_timeout(kcompactd_wait,
+				kcompactd_woken || kthread_should_stop(),
+				timeout);
+		kcompactd_woken = 0;
+		count_vm_event(KCOMPACTDWAKE);
+
+		if (kcompactd_do_work()) {
+			if (kcompactd_backoff < KCOMPACTD_MAX_BACKOFF)
+				kcompactd_backoff++;
+		} else
+			kcompactd_backoff = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - kick background compaction
+ * @order: order of the allocation which entered the slow path
+ *
+ * Called alongside wake_all_kswapd() so that kcompactd can restore the
+ * supply of high-order blocks before anyone has to compact directly.
+ */
+void wakeup_kcompactd(unsigned int order)
+{
+	if (!order || !sysctl_compact_proactive_order || kcompactd_backoff)
+		return;
+	if (!waitqueue_active(&kcompactd_wait))
+		return;
+	kcompactd_woken = 1;
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+int sysctl_compact_proactive_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	/* Targets changed: start afresh */
+	kcompactd_backoff = 0;
+	kcompactd_woken = 1;
+	wake_up_interruptible(&kcompactd_wait);
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	kcompactd_task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(kcompactd_task)) {
+		printk(KERN_ERR "compaction: creating kcompactd failed\n");
+		return PTR_ERR(kcompactd_task);
+	}
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
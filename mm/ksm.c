@@ -190,6 +190,22 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 #define KSM_RUN_UNMERGE	2
 static unsigned int ksm_run = KSM_RUN_STOP;
 
+/*
+ * Low overhead mode: only consider pages which have not been referenced
+ * since ksmd last looked at them, and pick candidates by a sampled hash
+ * instead of checksumming the whole page.
+ */
+static unsigned int ksm_low_overhead;
+
+/* Whether ksm_auto_merge() registers private shared-memory mappings */
+static unsigned int ksm_auto_merge_enabled = 1;
+
+/* Pages passed over in low overhead mode because they were referenced */
+static unsigned long ksm_pages_skipped;
+
+/* CPU time consumed by ksmd scanning, in nanoseconds */
+static u64 ksm_scan_cpu_ns;
+
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
 static DEFINE_MUTEX(ksm_thread_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
@@ -686,11 +702,32 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * Words hashed per page in low overhead mode: two from each 256 byte
+ * stretch of the page, which is enough to tell apart the pages that are
+ * actually changing, and a zero page still hashes to a single value.
+ */
+#define KSM_SAMPLE_STRIDE	(256 / sizeof(u32))
+
+static u32 calc_sampled_checksum(u32 *addr)
+{
+	u32 checksum = 17;
+	unsigned int i;
+
+	for (i = 0; i < PAGE_SIZE / 4; i += KSM_SAMPLE_STRIDE)
+		checksum = jhash_2words(addr[i],
+				addr[i + KSM_SAMPLE_STRIDE / 2 + 1], checksum);
+	return checksum;
+}
+
 static u32 calc_checksum(struct page *page)
 {
 	u32 checksum;
 	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	if (ksm_low_overhead)
+		checksum = calc_sampled_checksum(addr);
+	else
+		checksum = jhash2(addr, PAGE_SIZE / 4, 17);
 	kunmap_atomic(addr, KM_USER0);
 	return checksum;
 }
@@ -1252,6 +1289,30 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * In low overhead mode, a page referenced since ksmd last visited it is
+ * likely to be written again soon: leave it alone until it has gone idle.
+ * The young bit is cleared to detect that, so pass it on as PG_referenced
+ * to keep page reclaim informed.
+ */
+static int page_recently_used(struct page *page, struct vm_area_struct *vma,
+			      unsigned long address)
+{
+	pte_t *pte;
+	spinlock_t *ptl;
+	int young;
+
+	pte = page_check_address(page, vma->vm_mm, address, &ptl, 0);
+	if (!pte)
+		return 0;
+	young = ptep_clear_flush_young_notify(vma, address, pte);
+	pte_unmap_unlock(pte, ptl);
+
+	if (young)
+		SetPageReferenced(page);
+	return young;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1294,6 +1355,15 @@ next_mm:
 			if (ksm_test_exit(mm))
 				break;
 			*page = follow_page(vma, ksm_scan.address, FOLL_GET);
+			if (!IS_ERR_OR_NULL(*page) && PageAnon(*page) &&
+			    ksm_low_overhead && !PageKsm(*page) &&
+			    page_recently_used(*page, vma, ksm_scan.address)) {
+				ksm_pages_skipped++;
+				put_page(*page);
+				ksm_scan.address += PAGE_SIZE;
+				cond_resched();
+				continue;
+			}
 			if (!IS_ERR_OR_NULL(*page) && PageAnon(*page)) {
 				flush_anon_page(vma, *page, ksm_scan.address);
 				flush_dcache_page(*page);
@@ -1391,8 +1461,12 @@ static int ksm_scan_thread(void *nothing)
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
+			u64 start = task_sched_runtime(current);
+
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_scan_cpu_ns += task_sched_runtime(current) - start;
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		if (ksmd_should_run()) {
@@ -1449,6 +1523,21 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
+/*
+ * Register a private mapping of a shared memory object (ashmem) as
+ * mergeable without waiting for its user to madvise: Dalvik heaps live
+ * in such mappings, and zygote's children inherit the registration at
+ * fork.  Called from ->mmap with mmap_sem held for writing; failure to
+ * register loses only the merging, not the mapping.
+ */
+void ksm_auto_merge(struct vm_area_struct *vma)
+{
+	if (!ksm_auto_merge_enabled || (vma->vm_flags & VM_SHARED))
+		return;
+	ksm_madvise(vma, vma->vm_start, vma->vm_end,
+		    MADV_MERGEABLE, &vma->vm_flags);
+}
+
 int __ksm_enter(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -1913,15 +2002,98 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t low_overhead_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_low_overhead);
+}
+
+static ssize_t low_overhead_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned long flags;
+	int err;
+
+	err = strict_strtoul(buf, 10, &flags);
+	if (err || flags > 1)
+		return -EINVAL;
+
+	ksm_low_overhead = flags;
+
+	return count;
+}
+KSM_ATTR(low_overhead);
+
+static ssize_t auto_merge_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_merge_enabled);
+}
+
+static ssize_t auto_merge_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long flags;
+	int err;
+
+	err = strict_strtoul(buf, 10, &flags);
+	if (err || flags > 1)
+		return -EINVAL;
+
+	ksm_auto_merge_enabled = flags;
+
+	return count;
+}
+KSM_ATTR(auto_merge);
+
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
+static ssize_t scan_cpu_ms_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n",
+		       (unsigned long long)div_u64(ksm_scan_cpu_ns,
+						   NSEC_PER_MSEC));
+}
+KSM_ATTR_RO(scan_cpu_ms);
+
+/*
+ * Pages saved for each second of CPU ksmd has spent scanning: the figure
+ * to watch when tuning pages_to_scan and low_overhead on a small device.
+ */
+static ssize_t sharing_per_cpu_sec_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	u64 cpu_ms = div_u64(ksm_scan_cpu_ns, NSEC_PER_MSEC);
+
+	if (!cpu_ms)
+		return sprintf(buf, "0\n");
+	return sprintf(buf, "%llu\n", (unsigned long long)
+		       div64_u64((u64)ksm_pages_sharing * MSEC_PER_SEC, cpu_ms));
+}
+KSM_ATTR_RO(sharing_per_cpu_sec);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
 	&run_attr.attr,
+	&low_overhead_attr.attr,
+	&auto_merge_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&pages_skipped_attr.attr,
+	&scan_cpu_ms_attr.attr,
+	&sharing_per_cpu_sec_attr.attr,
 	NULL,
 };
 
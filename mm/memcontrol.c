@@ -176,8 +176,28 @@ struct mem_cgroup_eventfd_list {
 	struct eventfd_ctx *eventfd;
 };
 
+/* for reclaim pressure */
+enum mem_cgroup_pressure_level {
+	MEMCG_PRESSURE_NONE,
+	MEMCG_PRESSURE_LOW,
+	MEMCG_PRESSURE_MEDIUM,
+	MEMCG_PRESSURE_CRITICAL,
+	NR_MEMCG_PRESSURE_LEVELS,
+};
+
+static const char * const memcg_pressure_names[NR_MEMCG_PRESSURE_LEVELS] = {
+	"none", "low", "medium", "critical",
+};
+
+struct mem_cgroup_pressure_event {
+	struct list_head list;
+	struct eventfd_ctx *eventfd;
+	int level;
+};
+
 static void mem_cgroup_threshold(struct mem_cgroup *mem);
 static void mem_cgroup_oom_notify(struct mem_cgroup *mem);
+static void mem_cgroup_pressure_work(struct work_struct *work);
 
 /*
  * The memory controller data structure. The memory controller controls both
@@ -244,6 +264,20 @@ struct mem_cgroup {
 	/* For oom notifier event fd */
 	struct list_head oom_notify;
 
+	/*
+	 * Pages of this cgroup looked at and freed by page reclaim in the
+	 * current window, and the outcome of the last complete window.
+	 */
+	spinlock_t pressure_lock;
+	unsigned long pressure_scanned;
+	unsigned long pressure_reclaimed;
+	unsigned int pressure_ratio;
+	int pressure_level;
+	struct work_struct pressure_work;
+
+	/* For pressure notifier event fd, protected by memcg_pressure_mutex */
+	struct list_head pressure_notify;
+
 	/*
 	 * Should we move charges of a task when a task is moved into this
 	 * mem_cgroup ? And what type of charges should we move ?
@@ -1455,6 +1489,91 @@ done:
 	unlock_page_cgroup(pc);
 }
 
+/*
+ * Reclaim pressure is judged over windows of this many pages scanned from
+ * a cgroup, by the proportion of them which could not be reclaimed.
+ */
+#define MEMCG_PRESSURE_WINDOW	(SWAP_CLUSTER_MAX * 16)
+#define MEMCG_PRESSURE_MEDIUM	60	/* percent not reclaimed */
+#define MEMCG_PRESSURE_CRITICAL	95
+
+static DEFINE_MUTEX(memcg_pressure_mutex);
+
+static int mem_cgroup_pressure_level(unsigned int ratio)
+{
+	if (ratio >= MEMCG_PRESSURE_CRITICAL)
+		return MEMCG_PRESSURE_CRITICAL;
+	if (ratio >= MEMCG_PRESSURE_MEDIUM)
+		return MEMCG_PRESSURE_MEDIUM;
+	return MEMCG_PRESSURE_LOW;
+}
+
+static void mem_cgroup_pressure_work(struct work_struct *work)
+{
+	struct mem_cgroup *mem;
+	struct mem_cgroup_pressure_event *ev;
+
+	mem = container_of(work, struct mem_cgroup, pressure_work);
+
+	mutex_lock(&memcg_pressure_mutex);
+	list_for_each_entry(ev, &mem->pressure_notify, list)
+		if (ev->level <= mem->pressure_level)
+			eventfd_signal(ev->eventfd, 1);
+	mutex_unlock(&memcg_pressure_mutex);
+
+	css_put(&mem->css);
+}
+
+/*
+ * Called by page reclaim for each page it considers (@reclaimed false) and
+ * again for each page it is about to free (@reclaimed true).  This costs
+ * nothing outside reclaim: nothing is added to the fault or charge paths.
+ */
+void mem_cgroup_note_reclaim(struct page *page, bool reclaimed)
+{
+	struct mem_cgroup *mem;
+	struct page_cgroup *pc;
+	unsigned long scanned, freed;
+	bool notify = false;
+
+	if (mem_cgroup_disabled())
+		return;
+
+	pc = lookup_page_cgroup(page);
+	if (unlikely(!pc))
+		return;
+
+	lock_page_cgroup(pc);
+	mem = pc->mem_cgroup;
+	if (!mem || !PageCgroupUsed(pc))
+		goto done;
+
+	spin_lock(&mem->pressure_lock);
+	if (reclaimed)
+		mem->pressure_reclaimed++;
+	else
+		mem->pressure_scanned++;
+	if (mem->pressure_scanned >= MEMCG_PRESSURE_WINDOW) {
+		scanned = mem->pressure_scanned;
+		freed = min(mem->pressure_reclaimed, scanned);
+		mem->pressure_ratio = (scanned - freed) * 100 / scanned;
+		mem->pressure_level =
+			mem_cgroup_pressure_level(mem->pressure_ratio);
+		mem->pressure_scanned = 0;
+		mem->pressure_reclaimed = 0;
+		notify = !list_empty(&mem->pressure_notify);
+	}
+	spin_unlock(&mem->pressure_lock);
+
+	/* the work holds a reference, dropped when it has run */
+	if (notify && css_tryget(&mem->css)) {
+		if (!schedule_work(&mem->pressure_work))
+			css_put(&mem->css);
+	}
+done:
+	unlock_page_cgroup(pc);
+}
+
 /*
  * size of first charge trial. "32" comes from vmscan.c's magic value.
  * TODO: maybe necessary to use big numbers in big irons.
@@ -3291,6 +3410,7 @@ enum {
 	MCS_INACTIVE_FILE,
 	MCS_ACTIVE_FILE,
 	MCS_UNEVICTABLE,
+	MCS_WORKING_SET,
 	NR_MCS_STAT,
 };
 
@@ -3312,7 +3432,8 @@ struct {
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
 	{"active_file", "total_active_file"},
-	{"unevictable", "total_unevictable"}
+	{"unevictable", "total_unevictable"},
+	{"working_set", "total_working_set"}
 };
 
 
@@ -3348,6 +3469,17 @@ static int mem_cgroup_get_local_stat(struct mem_cgroup *mem, void *data)
 	s->stat[MCS_ACTIVE_FILE] += val * PAGE_SIZE;
 	val = mem_cgroup_get_local_zonestat(mem, LRU_UNEVICTABLE);
 	s->stat[MCS_UNEVICTABLE] += val * PAGE_SIZE;
+
+	/*
+	 * Working set estimate: the active lists, plus the share of the
+	 * inactive lists which reclaim found still in use last time round.
+	 */
+	val = mem_cgroup_get_local_zonestat(mem, LRU_INACTIVE_ANON) +
+		mem_cgroup_get_local_zonestat(mem, LRU_INACTIVE_FILE);
+	val = div_s64(val * mem->pressure_ratio, 100);
+	val += mem_cgroup_get_local_zonestat(mem, LRU_ACTIVE_ANON) +
+		mem_cgroup_get_local_zonestat(mem, LRU_ACTIVE_FILE);
+	s->stat[MCS_WORKING_SET] += val * PAGE_SIZE;
 	return 0;
 }
 
@@ -3787,6 +3919,62 @@ static int mem_cgroup_oom_control_write(struct cgroup *cgrp,
 	return 0;
 }
 
+static int mem_cgroup_pressure_read(struct cgroup *cgrp,
+	struct cftype *cft,  struct cgroup_map_cb *cb)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cgrp);
+
+	cb->fill(cb, "level", mem->pressure_level);
+	cb->fill(cb, "ratio", mem->pressure_ratio);
+	return 0;
+}
+
+static int mem_cgroup_pressure_register_event(struct cgroup *cgrp,
+	struct cftype *cft, struct eventfd_ctx *eventfd, const char *args)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_pressure_event *event;
+	int level;
+
+	for (level = MEMCG_PRESSURE_LOW; level < NR_MEMCG_PRESSURE_LEVELS;
+	     level++)
+		if (!strcmp(args, memcg_pressure_names[level]))
+			break;
+	if (level == NR_MEMCG_PRESSURE_LEVELS)
+		return -EINVAL;
+
+	event = kmalloc(sizeof(*event), GFP_KERNEL);
+	if (!event)
+		return -ENOMEM;
+
+	event->eventfd = eventfd;
+	event->level = level;
+
+	mutex_lock(&memcg_pressure_mutex);
+	list_add(&event->list, &mem->pressure_notify);
+	mutex_unlock(&memcg_pressure_mutex);
+
+	return 0;
+}
+
+static void mem_cgroup_pressure_unregister_event(struct cgroup *cgrp,
+	struct cftype *cft, struct eventfd_ctx *eventfd)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_pressure_event *ev, *tmp;
+
+	mutex_lock(&memcg_pressure_mutex);
+
+	list_for_each_entry_safe(ev, tmp, &mem->pressure_notify, list) {
+		if (ev->eventfd == eventfd) {
+			list_del(&ev->list);
+			kfree(ev);
+		}
+	}
+
+	mutex_unlock(&memcg_pressure_mutex);
+}
+
 static struct cftype mem_cgroup_files[] = {
 	{
 		.name = "usage_in_bytes",
@@ -3850,6 +4038,12 @@ static struct cftype mem_cgroup_files[] = {
 		.unregister_event = mem_cgroup_oom_unregister_event,
 		.private = MEMFILE_PRIVATE(_OOM_TYPE, OOM_CONTROL),
 	},
+	{
+		.name = "pressure_level",
+		.read_map = mem_cgroup_pressure_read,
+		.register_event = mem_cgroup_pressure_register_event,
+		.unregister_event = mem_cgroup_pressure_unregister_event,
+	},
 };
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
@@ -4107,6 +4301,9 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	mem->last_scanned_child = 0;
 	spin_lock_init(&mem->reclaim_param_lock);
 	INIT_LIST_HEAD(&mem->oom_notify);
+	spin_lock_init(&mem->pressure_lock);
+	INIT_WORK(&mem->pressure_work, mem_cgroup_pressure_work);
+	INIT_LIST_HEAD(&mem->pressure_notify);
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
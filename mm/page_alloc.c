@@ -50,6 +50,7 @@
 #include <linux/kmemleak.h>
 #include <linux/memory.h>
 #include <linux/compaction.h>
+#include <linux/delayacct.h>
 #include <trace/events/kmem.h>
 #include <linux/ftrace_event.h>
 
@@ -168,6 +169,14 @@ static char * const zone_names[MAX_NR_ZONES] = {
 int min_free_kbytes = 1024;
 int min_free_order_shift = 1;
 
+/*
+ * Extra memory for the system to try freeing between the min and
+ * low watermarks.  Useful for workloads that require low latency
+ * memory allocations in bursts larger than the normal gap between
+ * low and min.
+ */
+int extra_free_kbytes;
+
 static unsigned long __meminitdata nr_kernel_pages;
 static unsigned long __meminitdata nr_all_pages;
 static unsigned long __meminitdata dma_reserve;
@@ -626,6 +635,45 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Frees blocks from the order-1..PCP_MAX_ORDER PCP lists, larger orders
+ * first, until at least count pages have been returned to the buddy
+ * allocator. Returns the number of pages freed.
+ */
+static int free_pcp_high_bulk(struct zone *zone, int count,
+					struct per_cpu_pages *pcp)
+{
+	int order, migratetype;
+	int freed = 0;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	for (order = PCP_MAX_ORDER; order > 0 && freed < count; order--) {
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES &&
+					freed < count; migratetype++) {
+			struct list_head *list;
+
+			list = &pcp->high_lists[order - 1][migratetype];
+			while (!list_empty(list) && freed < count) {
+				struct page *page;
+
+				page = list_entry(list->prev, struct page, lru);
+				list_del(&page->lru);
+				__free_one_page(page, zone, order,
+						page_private(page));
+				trace_mm_page_pcpu_drain(page, order,
+						page_private(page));
+				freed += 1 << order;
+			}
+		}
+	}
+	__mod_zone_page_state(zone, NR_FREE_PAGES, freed);
+	spin_unlock(&zone->lock);
+	return freed;
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -638,6 +686,42 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Put a free order-1..PCP_MAX_ORDER block on this cpu's lists for the
+ * zone. When the zone is below its low watermark the block goes straight
+ * back to the buddy allocator instead, where it can merge into the larger
+ * blocks that reclaim and compaction are trying to build.
+ *
+ * Interrupts must be disabled.
+ */
+static void free_pcp_high_page(struct zone *zone, struct page *page,
+					int order)
+{
+	struct per_cpu_pages *pcp;
+	int migratetype = get_pageblock_migratetype(page);
+
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
+
+	if (migratetype == MIGRATE_ISOLATE ||
+	    zone_page_state(zone, NR_FREE_PAGES) < low_wmark_pages(zone)) {
+		free_one_page(zone, page, order, migratetype);
+		return;
+	}
+
+	/* As for order-0, RESERVE blocks are kept on the movable list */
+	set_page_private(page, migratetype);
+	if (migratetype >= MIGRATE_PCPTYPES)
+		migratetype = MIGRATE_MOVABLE;
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list_add(&page->lru, &pcp->high_lists[order - 1][migratetype]);
+	pcp->high_count += 1 << order;
+	if (pcp->high_count >= pcp->high)
+		pcp->high_count -= free_pcp_high_bulk(zone, pcp->batch, pcp);
+}
+
 static bool free_pages_prepare(struct page *page, unsigned int order)
 {
 	int i;
@@ -679,7 +763,10 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
+	if (order <= PCP_MAX_ORDER)
+		free_pcp_high_page(page_zone(page), page, order);
+	else
+		free_one_page(page_zone(page), page, order,
 					get_pageblock_migratetype(page));
 	local_irq_restore(flags);
 }
@@ -1066,6 +1153,8 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->count;
 	free_pcppages_bulk(zone, to_drain, pcp);
 	pcp->count -= to_drain;
+	if (pcp->high_count)
+		pcp->high_count -= free_pcp_high_bulk(zone, pcp->batch, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1092,6 +1181,8 @@ static void drain_pages(unsigned int cpu)
 		pcp = &pset->pcp;
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		free_pcp_high_bulk(zone, pcp->high_count, pcp);
+		pcp->high_count = 0;
 		local_irq_restore(flags);
 	}
 }
@@ -1310,6 +1401,31 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+	} else if (order <= PCP_MAX_ORDER &&
+		   !(gfp_flags & __GFP_NOFAIL)) {
+		/* __GFP_NOFAIL users go below and get warned about */
+		struct per_cpu_pages *pcp;
+		struct list_head *list;
+
+		local_irq_save(flags);
+		pcp = &this_cpu_ptr(zone->pageset)->pcp;
+		list = &pcp->high_lists[order - 1][migratetype];
+		if (list_empty(list)) {
+			unsigned long count = max(pcp->batch >> order, 1);
+
+			/* Do not stockpile blocks from a zone low on memory */
+			if (zone_page_state(zone, NR_FREE_PAGES) <
+						low_wmark_pages(zone))
+				count = 1;
+			pcp->high_count += rmqueue_bulk(zone, order, count,
+					list, migratetype, cold) << order;
+			if (unlikely(list_empty(list)))
+				goto failed;
+		}
+
+		page = list_entry(list->next, struct page, lru);
+		list_del(&page->lru);
+		pcp->high_count -= 1 << order;
 	} else {
 		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
 			/*
@@ -1792,8 +1908,10 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	if (!order || compaction_deferred(preferred_zone))
 		return NULL;
 
+	delayacct_compact_start();
 	*did_some_progress = try_to_compact_pages(zonelist, order, gfp_mask,
 								nodemask);
+	delayacct_compact_end();
 	if (*did_some_progress != COMPACT_SKIPPED) {
 
 		/* Page migration frees to the PCP lists but we want merging */
@@ -1835,6 +1953,25 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 }
 #endif /* CONFIG_COMPACTION */
 
+/*
+ * Account a direct reclaim of ms milliseconds against zone and in the
+ * global histogram of direct reclaim durations.
+ */
+static void count_direct_stall(struct zone *zone, s64 ms)
+{
+	enum vm_event_item item = ALLOCSTALL_LT_1MS;
+	s64 limit = 1;
+
+	while (item < ALLOCSTALL_GE_1024MS && ms >= limit) {
+		item++;
+		limit <<= 2;
+	}
+	count_vm_event(item);
+
+	inc_zone_state(zone, DIRECT_STALL);
+	mod_zone_page_state(zone, DIRECT_STALL_MS, ms);
+}
+
 /* The really slow allocator path where we enter direct reclaim */
 static inline struct page *
 __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
@@ -1846,6 +1983,7 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	struct reclaim_state reclaim_state;
 	struct task_struct *p = current;
 	bool drained = false;
+	ktime_t start;
 
 	cond_resched();
 
@@ -1856,7 +1994,10 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	reclaim_state.reclaimed_slab = 0;
 	p->reclaim_state = &reclaim_state;
 
+	start = ktime_get();
 	*did_some_progress = try_to_free_pages(zonelist, order, gfp_mask, nodemask);
+	count_direct_stall(preferred_zone,
+			ktime_to_ms(ktime_sub(ktime_get(), start)));
 
 	p->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
@@ -1996,6 +2137,7 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 
 restart:
 	wake_all_kswapd(order, zonelist, high_zoneidx);
+	wakeup_kcompactd(order);
 
 	/*
 	 * OK, we're below the kswapd watermark and have kicked background
@@ -2363,9 +2505,10 @@ void show_free_areas(void)
 
 			pageset = per_cpu_ptr(zone->pageset, cpu);
 
-			printk("CPU %4d: hi:%5d, btch:%4d usd:%4d\n",
+			printk("CPU %4d: hi:%5d, btch:%4d usd:%4d hiord:%4d\n",
 			       cpu, pageset->pcp.high,
-			       pageset->pcp.batch, pageset->pcp.count);
+			       pageset->pcp.batch, pageset->pcp.count,
+			       pageset->pcp.high_count);
 		}
 	}
 
@@ -3361,7 +3504,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3371,6 +3514,11 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+	pcp->high_count = 0;
+	for (order = 0; order < PCP_MAX_ORDER; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+							migratetype++)
+			INIT_LIST_HEAD(&pcp->high_lists[order][migratetype]);
 }
 
 /*
@@ -3478,6 +3626,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcp_high_bulk(zone, pcp->high_count, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4867,6 +5016,7 @@ static void setup_per_zone_lowmem_reserve(void)
 void setup_per_zone_wmarks(void)
 {
 	unsigned long pages_min = min_free_kbytes >> (PAGE_SHIFT - 10);
+	unsigned long pages_low = extra_free_kbytes >> (PAGE_SHIFT - 10);
 	unsigned long lowmem_pages = 0;
 	struct zone *zone;
 	unsigned long flags;
@@ -4878,11 +5028,14 @@ void setup_per_zone_wmarks(void)
 	}
 
 	for_each_zone(zone) {
-		u64 tmp;
+		u64 min, low;
 
 		spin_lock_irqsave(&zone->lock, flags);
-		tmp = (u64)pages_min * zone->present_pages;
-		do_div(tmp, lowmem_pages);
+		min = (u64)pages_min * zone->present_pages;
+		do_div(min, lowmem_pages);
+		low = (u64)pages_low * zone->present_pages;
+		do_div(low, vm_total_pages);
+
 		if (is_highmem(zone)) {
 			/*
 			 * __GFP_HIGH and PF_MEMALLOC allocations usually don't
@@ -4906,11 +5059,13 @@ void setup_per_zone_wmarks(void)
 			 * If it's a lowmem zone, reserve a number of pages
 			 * proportionate to the zone's size.
 			 */
-			zone->watermark[WMARK_MIN] = tmp;
+			zone->watermark[WMARK_MIN] = min;
 		}
 
-		zone->watermark[WMARK_LOW]  = min_wmark_pages(zone) + (tmp >> 2);
-		zone->watermark[WMARK_HIGH] = min_wmark_pages(zone) + (tmp >> 1);
+		zone->watermark[WMARK_LOW]  = min_wmark_pages(zone) +
+					low + (min >> 2) + zone->watermark_boost;
+		zone->watermark[WMARK_HIGH] = min_wmark_pages(zone) +
+					low + (min >> 1) + zone->watermark_boost;
 		setup_zone_migrate_reserve(zone);
 		spin_unlock_irqrestore(&zone->lock, flags);
 	}
@@ -5004,10 +5159,25 @@ static int __init init_per_zone_wmark_min(void)
 }
 module_init(init_per_zone_wmark_min)
 
+/*
+ * set_zone_watermark_boost - sets the adaptive part of the low and high
+ *	watermarks of a zone, kept across setup_per_zone_wmarks().
+ */
+void set_zone_watermark_boost(struct zone *zone, unsigned long boost)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&zone->lock, flags);
+	zone->watermark[WMARK_LOW] += boost - zone->watermark_boost;
+	zone->watermark[WMARK_HIGH] += boost - zone->watermark_boost;
+	zone->watermark_boost = boost;
+	spin_unlock_irqrestore(&zone->lock, flags);
+}
+
 /*
  * min_free_kbytes_sysctl_handler - just a wrapper around proc_dointvec() so 
  *	that we can call two helper functions whenever min_free_kbytes
- *	changes.
+ *	or extra_free_kbytes changes.
  */
 int min_free_kbytes_sysctl_handler(ctl_table *table, int write, 
 	void __user *buffer, size_t *length, loff_t *ppos)
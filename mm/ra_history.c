@@ -0,0 +1,487 @@
+/*
+ * mm/ra_history.c
+ *
+ * Readahead history: replay the pages a file needed last time it was opened.
+ *
+ * Program launches touch the same scattered pages of the same executables,
+ * libraries and packages each time, in an order that ondemand readahead
+ * cannot predict from one open to the next.  For each regular file opened
+ * read-only on a block device we keep a bitmap of the pages accessed
+ * through read() or page faults during a window of window_ms after it is
+ * opened.  When the file is next opened after that window has closed, the
+ * pages recorded in it are read ahead at once, in runs, and a new window
+ * starts recording.
+ *
+ * Histories are keyed by device and inode number, so they survive the inode
+ * being evicted, and are thrown away if the file's size or mtime changes.
+ * They are bounded by max_kb, beyond which the least recently opened
+ * unused histories are dropped.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/hash.h>
+#include <linux/bitops.h>
+#include <linux/jiffies.h>
+#include <linux/kobject.h>
+#include <linux/swap.h>
+#include <linux/ra_history.h>
+
+#define RA_HISTORY_HASH_SHIFT	8
+
+/* Files beyond this many pages only have their head recorded */
+#define RA_HISTORY_MAX_PAGES	32768
+
+struct ra_history {
+	struct hlist_node hash;
+	struct list_head lru;		/* most recently opened at the head */
+	dev_t dev;
+	unsigned long ino;
+	loff_t size;
+	struct timespec mtime;
+
+	int count;			/* open files using this history */
+	int recording;			/* a window is open */
+	int has_pattern;		/* pattern holds a completed window */
+	int replayed;			/* pattern was read ahead for this window */
+	unsigned long deadline;		/* jiffies at which the window closes */
+
+	unsigned long nr_bits;
+	unsigned long *pattern;		/* pages touched in the last window */
+	unsigned long *seen;		/* pages touched in this window */
+};
+
+/* Protects the hash, the lru and the window state of every history */
+static DEFINE_SPINLOCK(ra_history_lock);
+static struct hlist_head ra_history_hash[1 << RA_HISTORY_HASH_SHIFT];
+static LIST_HEAD(ra_history_lru);
+static unsigned long ra_history_bytes;
+static unsigned long ra_history_count;
+
+/* Tunables */
+static unsigned int ra_history_enabled = 1;
+static unsigned int ra_history_window_ms = 5000;
+static unsigned long ra_history_max_kb = 1024;
+
+/* Statistics for sysfs */
+static unsigned long ra_history_replays;
+static unsigned long ra_history_replay_pages;
+static unsigned long ra_history_hit_pages;
+static unsigned long ra_history_waste_pages;
+static unsigned long ra_history_miss_pages;
+
+static struct hlist_head *ra_history_bucket(dev_t dev, unsigned long ino)
+{
+	return &ra_history_hash[hash_long(ino ^ dev, RA_HISTORY_HASH_SHIFT)];
+}
+
+static struct ra_history *ra_history_find(dev_t dev, unsigned long ino)
+{
+	struct ra_history *history;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(history, node, ra_history_bucket(dev, ino), hash)
+		if (history->dev == dev && history->ino == ino)
+			return history;
+	return NULL;
+}
+
+static size_t ra_history_size(struct ra_history *history)
+{
+	return sizeof(*history) + 2 * BITS_TO_LONGS(history->nr_bits) *
+					sizeof(unsigned long);
+}
+
+static struct ra_history *ra_history_alloc(struct inode *inode,
+					unsigned long nr_bits)
+{
+	struct ra_history *history;
+	size_t bytes = BITS_TO_LONGS(nr_bits) * sizeof(unsigned long);
+
+	history = kzalloc(sizeof(*history), GFP_KERNEL);
+	if (!history)
+		return NULL;
+	history->pattern = kzalloc(bytes, GFP_KERNEL);
+	history->seen = kzalloc(bytes, GFP_KERNEL);
+	if (!history->pattern || !history->seen) {
+		kfree(history->pattern);
+		kfree(history->seen);
+		kfree(history);
+		return NULL;
+	}
+	history->dev = inode->i_sb->s_dev;
+	history->ino = inode->i_ino;
+	history->size = i_size_read(inode);
+	history->mtime = inode->i_mtime;
+	history->nr_bits = nr_bits;
+	return history;
+}
+
+static void ra_history_free(struct ra_history *history)
+{
+	kfree(history->pattern);
+	kfree(history->seen);
+	kfree(history);
+}
+
+/* Unhash an unused history: the caller frees it after dropping the lock */
+static void ra_history_unlink(struct ra_history *history)
+{
+	hlist_del(&history->hash);
+	list_del(&history->lru);
+	ra_history_bytes -= ra_history_size(history);
+	ra_history_count--;
+}
+
+/*
+ * Close the recording window: account how well the replayed pattern
+ * predicted this window's accesses, then make this window the pattern for
+ * the next open, unless nothing at all was touched.
+ */
+static void ra_history_close(struct ra_history *history)
+{
+	unsigned long i, nr_longs = BITS_TO_LONGS(history->nr_bits);
+	unsigned long hit = 0, waste = 0, miss = 0, touched = 0;
+
+	for (i = 0; i < nr_longs; i++) {
+		unsigned long seen = history->seen[i];
+		unsigned long pattern = history->replayed ?
+					history->pattern[i] : 0;
+
+		hit += hweight_long(seen & pattern);
+		waste += hweight_long(pattern & ~seen);
+		miss += hweight_long(seen & ~pattern);
+		touched |= seen;
+	}
+	ra_history_hit_pages += hit;
+	ra_history_waste_pages += waste;
+	ra_history_miss_pages += miss;
+
+	if (touched) {
+		unsigned long *pattern = history->pattern;
+
+		history->pattern = history->seen;
+		history->seen = pattern;
+		history->has_pattern = 1;
+	}
+	bitmap_zero(history->seen, history->nr_bits);
+	history->recording = 0;
+	history->replayed = 0;
+}
+
+/* Drop unused histories, oldest first, until we are back under max_kb */
+static void ra_history_shrink(struct list_head *list)
+{
+	struct ra_history *history, *next;
+
+	list_for_each_entry_safe_reverse(history, next, &ra_history_lru, lru) {
+		if (ra_history_bytes <= ra_history_max_kb << 10)
+			break;
+		if (history->count)
+			continue;
+		ra_history_unlink(history);
+		list_add(&history->lru, list);
+	}
+}
+
+static void ra_history_free_list(struct list_head *list)
+{
+	struct ra_history *history, *next;
+
+	list_for_each_entry_safe(history, next, list, lru)
+		ra_history_free(history);
+}
+
+/* Read ahead each run of pages in the pattern */
+static void ra_history_replay(struct file *file, struct ra_history *history)
+{
+	struct address_space *mapping = file->f_mapping;
+	unsigned long start, end;
+	int nr = 0;
+
+	start = find_first_bit(history->pattern, history->nr_bits);
+	while (start < history->nr_bits) {
+		int ret;
+
+		end = find_next_zero_bit(history->pattern,
+					 history->nr_bits, start);
+		ret = force_page_cache_readahead(mapping, file,
+						 start, end - start);
+		if (ret < 0)
+			break;
+		nr += ret;
+		start = find_next_bit(history->pattern, history->nr_bits, end);
+	}
+
+	ra_history_replays++;
+	ra_history_replay_pages += nr;
+}
+
+/**
+ * ra_history_open - look up or create the history of a newly opened file
+ * @file: the file, from __dentry_open()
+ *
+ * If the last recording window of the file has closed, replays it and
+ * starts a new one.
+ */
+void ra_history_open(struct file *file)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct ra_history *history, *new = NULL;
+	unsigned long nr_bits;
+	LIST_HEAD(victims);
+	int replay = 0;
+
+	if (!ra_history_enabled || !S_ISREG(inode->i_mode) ||
+	    !inode->i_sb->s_bdev)
+		return;
+	if ((file->f_mode & FMODE_WRITE) || (file->f_flags & O_DIRECT))
+		return;
+	if (!file->f_mapping->a_ops->readpage &&
+	    !file->f_mapping->a_ops->readpages)
+		return;
+
+	nr_bits = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
+							PAGE_CACHE_SHIFT;
+	if (!nr_bits)
+		return;
+	nr_bits = min_t(unsigned long, nr_bits, RA_HISTORY_MAX_PAGES);
+
+again:
+	spin_lock(&ra_history_lock);
+	history = ra_history_find(inode->i_sb->s_dev, inode->i_ino);
+	if (history && (history->size != i_size_read(inode) ||
+			!timespec_equal(&history->mtime, &inode->i_mtime))) {
+		/* The file has changed: its history is no good any more */
+		if (history->count)
+			goto out_unlock;
+		ra_history_unlink(history);
+		list_add(&history->lru, &victims);
+		history = NULL;
+	}
+	if (!history) {
+		if (!new) {
+			spin_unlock(&ra_history_lock);
+			new = ra_history_alloc(inode, nr_bits);
+			if (!new)
+				goto out;
+			goto again;
+		}
+		history = new;
+		new = NULL;
+		hlist_add_head(&history->hash, ra_history_bucket(history->dev,
+								 history->ino));
+		list_add(&history->lru, &ra_history_lru);
+		ra_history_bytes += ra_history_size(history);
+		ra_history_count++;
+	}
+
+	if (history->recording && time_after(jiffies, history->deadline))
+		ra_history_close(history);
+	if (!history->recording) {
+		history->recording = 1;
+		history->deadline = jiffies +
+				msecs_to_jiffies(ra_history_window_ms);
+		history->replayed = replay = history->has_pattern;
+	}
+	history->count++;
+	list_move(&history->lru, &ra_history_lru);
+	file->f_ra_history = history;
+
+	ra_history_shrink(&victims);
+out_unlock:
+	spin_unlock(&ra_history_lock);
+out:
+	if (new)
+		ra_history_free(new);
+	ra_history_free_list(&victims);
+
+	if (replay)
+		ra_history_replay(file, history);
+}
+
+/**
+ * ra_history_release - drop the file's reference to its history
+ * @file: the file, from __fput()
+ */
+void ra_history_release(struct file *file)
+{
+	struct ra_history *history = file->f_ra_history;
+
+	if (!history)
+		return;
+
+	spin_lock(&ra_history_lock);
+	if (!--history->count && history->recording &&
+	    time_after(jiffies, history->deadline))
+		ra_history_close(history);
+	spin_unlock(&ra_history_lock);
+	file->f_ra_history = NULL;
+}
+
+/*
+ * Note an access to page index.  The window state is read without the
+ * lock: a bit set just as the window closes is either counted in the old
+ * window or leaks into the next one, which is harmless.
+ */
+void __ra_history_access(struct ra_history *history, pgoff_t index)
+{
+	if (!history->recording || index >= history->nr_bits)
+		return;
+	if (time_after(jiffies, history->deadline))
+		return;
+	if (!test_bit(index, history->seen))
+		set_bit(index, history->seen);
+}
+
+/* Forget everything, as when the feature is turned off */
+static void ra_history_flush(void)
+{
+	struct ra_history *history, *next;
+	LIST_HEAD(victims);
+
+	spin_lock(&ra_history_lock);
+	list_for_each_entry_safe(history, next, &ra_history_lru, lru) {
+		if (history->count)
+			continue;
+		ra_history_unlink(history);
+		list_add(&history->lru, &victims);
+	}
+	spin_unlock(&ra_history_lock);
+	ra_history_free_list(&victims);
+}
+
+#ifdef CONFIG_SYSFS
+#define RA_HISTORY_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define RA_HISTORY_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_history_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long enabled;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enabled);
+	if (err || enabled > 1)
+		return -EINVAL;
+
+	ra_history_enabled = enabled;
+	if (!enabled)
+		ra_history_flush();
+
+	return count;
+}
+RA_HISTORY_ATTR(enabled);
+
+static ssize_t window_ms_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_history_window_ms);
+}
+
+static ssize_t window_ms_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || !msecs || msecs > UINT_MAX)
+		return -EINVAL;
+
+	ra_history_window_ms = msecs;
+
+	return count;
+}
+RA_HISTORY_ATTR(window_ms);
+
+static ssize_t max_kb_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ra_history_max_kb);
+}
+
+static ssize_t max_kb_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	LIST_HEAD(victims);
+	unsigned long kb;
+	int err;
+
+	err = strict_strtoul(buf, 10, &kb);
+	if (err || kb > (totalram_pages << (PAGE_SHIFT - 10)) / 4)
+		return -EINVAL;
+
+	spin_lock(&ra_history_lock);
+	ra_history_max_kb = kb;
+	ra_history_shrink(&victims);
+	spin_unlock(&ra_history_lock);
+	ra_history_free_list(&victims);
+
+	return count;
+}
+RA_HISTORY_ATTR(max_kb);
+
+#define RA_HISTORY_STAT(_name, _value)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%lu\n", (unsigned long)(_value));		\
+}									\
+RA_HISTORY_ATTR_RO(_name)
+
+RA_HISTORY_STAT(histories, ra_history_count);
+RA_HISTORY_STAT(used_kb, DIV_ROUND_UP(ra_history_bytes, 1024));
+RA_HISTORY_STAT(replays, ra_history_replays);
+RA_HISTORY_STAT(replay_pages, ra_history_replay_pages);
+RA_HISTORY_STAT(hit_pages, ra_history_hit_pages);
+RA_HISTORY_STAT(waste_pages, ra_history_waste_pages);
+RA_HISTORY_STAT(miss_pages, ra_history_miss_pages);
+
+static struct attribute *ra_history_attrs[] = {
+	&enabled_attr.attr,
+	&window_ms_attr.attr,
+	&max_kb_attr.attr,
+	&histories_attr.attr,
+	&used_kb_attr.attr,
+	&replays_attr.attr,
+	&replay_pages_attr.attr,
+	&hit_pages_attr.attr,
+	&waste_pages_attr.attr,
+	&miss_pages_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ra_history_attr_group = {
+	.attrs = ra_history_attrs,
+	.name = "ra_history",
+};
+
+static int __init ra_history_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &ra_history_attr_group);
+	if (err)
+		printk(KERN_ERR "ra_history: register sysfs failed\n");
+	return err;
+}
+module_init(ra_history_init)
+#endif /* CONFIG_SYSFS */
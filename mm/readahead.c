@@ -17,6 +17,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/ccache.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -112,6 +113,10 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 	unsigned page_idx;
 	int ret;
 
+	ccache_read_pages(mapping, pages, &nr_pages);
+	if (!nr_pages)
+		return 0;
+
 	if (mapping->a_ops->readpages) {
 		ret = mapping->a_ops->readpages(filp, mapping, pages, nr_pages);
 		/* Clean up the remaining pages */
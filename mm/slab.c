@@ -3829,6 +3829,59 @@ void kmem_cache_free(struct kmem_cache *cachep, void *objp)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_free_bulk - Deallocate an array of objects
+ * @cachep: The cache the allocations were from.
+ * @nr: The number of objects.
+ * @p: The previously allocated objects.
+ *
+ * Like kmem_cache_free() on each object, with interrupts disabled only once.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *cachep, size_t nr, void **p)
+{
+	unsigned long flags;
+	size_t i;
+
+	local_irq_save(flags);
+	for (i = 0; i < nr; i++) {
+		debug_check_no_locks_freed(p[i], obj_size(cachep));
+		if (!(cachep->flags & SLAB_DEBUG_OBJECTS))
+			debug_check_no_obj_freed(p[i], obj_size(cachep));
+		__cache_free(cachep, p[i]);
+	}
+	local_irq_restore(flags);
+
+	for (i = 0; i < nr; i++)
+		trace_kmem_cache_free(_RET_IP_, p[i]);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/**
+ * kmem_cache_alloc_bulk - Allocate an array of objects
+ * @cachep: The cache to allocate from.
+ * @flags: See kmalloc().
+ * @nr: The number of objects.
+ * @p: Array receiving the objects.
+ *
+ * Returns @nr on success. On failure nothing is left allocated and 0 is
+ * returned.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *cachep, gfp_t flags,
+			size_t nr, void **p)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++) {
+		p[i] = kmem_cache_alloc(cachep, flags);
+		if (unlikely(!p[i])) {
+			kmem_cache_free_bulk(cachep, i, p);
+			return 0;
+		}
+	}
+	return nr;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /**
  * kfree - free previously allocated memory
  * @objp: pointer returned by kmalloc.
@@ -810,42 +810,6 @@ static void remove_full(struct kmem_cache *s, struct page *page)
 	spin_unlock(&n->list_lock);
 }
 
-/* Tracking of the number of slabs for debugging purposes */
-static inline unsigned long slabs_node(struct kmem_cache *s, int node)
-{
-	struct kmem_cache_node *n = get_node(s, node);
-
-	return atomic_long_read(&n->nr_slabs);
-}
-
-static inline unsigned long node_nr_slabs(struct kmem_cache_node *n)
-{
-	return atomic_long_read(&n->nr_slabs);
-}
-
-static inline void inc_slabs_node(struct kmem_cache *s, int node, int objects)
-{
-	struct kmem_cache_node *n = get_node(s, node);
-
-	/*
-	 * May be called early in order to allocate a slab for the
-	 * kmem_cache_node structure. Solve the chicken-egg
-	 * dilemma by deferring the increment of the count during
-	 * bootstrap (see early_kmem_cache_node_alloc).
-	 */
-	if (!NUMA_BUILD || n) {
-		atomic_long_inc(&n->nr_slabs);
-		atomic_long_add(objects, &n->total_objects);
-	}
-}
-static inline void dec_slabs_node(struct kmem_cache *s, int node, int objects)
-{
-	struct kmem_cache_node *n = get_node(s, node);
-
-	atomic_long_dec(&n->nr_slabs);
-	atomic_long_sub(objects, &n->total_objects);
-}
-
 /* Object debug checks for alloc/free paths */
 static void setup_object_debug(struct kmem_cache *s, struct page *page,
 								void *object)
@@ -1052,7 +1016,45 @@ static inline unsigned long kmem_cache_flags(unsigned long objsize,
 #define slub_debug 0
 
 #define disable_higher_order_debug 0
+#endif
+
+#if defined(CONFIG_SLUB_DEBUG) || defined(CONFIG_SLUB_STATS)
+/* Tracking of the number of slabs for debugging and statistics */
+static inline unsigned long slabs_node(struct kmem_cache *s, int node)
+{
+	struct kmem_cache_node *n = get_node(s, node);
+
+	return atomic_long_read(&n->nr_slabs);
+}
+
+static inline unsigned long node_nr_slabs(struct kmem_cache_node *n)
+{
+	return atomic_long_read(&n->nr_slabs);
+}
+
+static inline void inc_slabs_node(struct kmem_cache *s, int node, int objects)
+{
+	struct kmem_cache_node *n = get_node(s, node);
+
+	/*
+	 * May be called early in order to allocate a slab for the
+	 * kmem_cache_node structure. Solve the chicken-egg
+	 * dilemma by deferring the increment of the count during
+	 * bootstrap (see early_kmem_cache_node_alloc).
+	 */
+	if (!NUMA_BUILD || n) {
+		atomic_long_inc(&n->nr_slabs);
+		atomic_long_add(objects, &n->total_objects);
+	}
+}
+static inline void dec_slabs_node(struct kmem_cache *s, int node, int objects)
+{
+	struct kmem_cache_node *n = get_node(s, node);
 
+	atomic_long_dec(&n->nr_slabs);
+	atomic_long_sub(objects, &n->total_objects);
+}
+#else
 static inline unsigned long slabs_node(struct kmem_cache *s, int node)
 							{ return 0; }
 static inline unsigned long node_nr_slabs(struct kmem_cache_node *n)
@@ -1542,7 +1544,7 @@ static unsigned long count_partial(struct kmem_cache_node *n,
 
 static inline unsigned long node_nr_objs(struct kmem_cache_node *n)
 {
-#ifdef CONFIG_SLUB_DEBUG
+#if defined(CONFIG_SLUB_DEBUG) || defined(CONFIG_SLUB_STATS)
 	return atomic_long_read(&n->total_objects);
 #else
 	return 0;
@@ -1773,12 +1775,15 @@ EXPORT_SYMBOL(kmem_cache_alloc_node_notrace);
  * So we still attempt to reduce cache line usage. Just take the slab
  * lock and free the item. If there is no additional partial page
  * handling required then we can return immediately.
+ *
+ * A chain of cnt objects from the same slab, linked through their free
+ * pointers from head to tail, is freed under a single slab lock. Chains
+ * longer than one object must not be built for debug slabs.
  */
-static void __slab_free(struct kmem_cache *s, struct page *page,
-			void *x, unsigned long addr)
+static void __slab_free_chain(struct kmem_cache *s, struct page *page,
+			void *head, void *tail, int cnt, unsigned long addr)
 {
 	void *prior;
-	void **object = (void *)x;
 
 	stat(s, FREE_SLOWPATH);
 	slab_lock(page);
@@ -1788,9 +1793,9 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 checks_ok:
 	prior = page->freelist;
-	set_freepointer(s, object, prior);
-	page->freelist = object;
-	page->inuse--;
+	set_freepointer(s, tail, prior);
+	page->freelist = head;
+	page->inuse -= cnt;
 
 	if (unlikely(PageSlubFrozen(page))) {
 		stat(s, FREE_FROZEN);
@@ -1827,11 +1832,18 @@ slab_empty:
 	return;
 
 debug:
-	if (!free_debug_processing(s, page, x, addr))
+	VM_BUG_ON(cnt != 1);
+	if (!free_debug_processing(s, page, head, addr))
 		goto out_unlock;
 	goto checks_ok;
 }
 
+static void __slab_free(struct kmem_cache *s, struct page *page,
+			void *x, unsigned long addr)
+{
+	__slab_free_chain(s, page, x, x, 1, addr);
+}
+
 /*
  * Fastpath with forced inlining to produce a kfree and kmem_cache_free that
  * can perform fastpath freeing without additional function calls.
@@ -1879,6 +1891,125 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/*
+ * Free nr objects of cache s in one pass. Objects belonging to the cpu slab
+ * go straight onto its freelist. Runs of objects from the same other slab
+ * are chained together and handed to the slow path under one slab lock.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t nr, void **p)
+{
+	struct kmem_cache_cpu *c;
+	struct page *page = NULL;
+	void *head = NULL;
+	void *tail = NULL;
+	int cnt = 0;
+	unsigned long flags;
+	size_t i;
+
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	for (i = 0; i < nr; i++) {
+		void **object = p[i];
+		struct page *opage = virt_to_head_page(object);
+
+		kmemleak_free_recursive(object, s->flags);
+		kmemcheck_slab_free(s, object, s->objsize);
+		debug_check_no_locks_freed(object, s->objsize);
+		if (!(s->flags & SLAB_DEBUG_OBJECTS))
+			debug_check_no_obj_freed(object, s->objsize);
+		trace_kmem_cache_free(_RET_IP_, object);
+
+		if (likely(opage == c->page && c->node >= 0)) {
+			set_freepointer(s, object, c->freelist);
+			c->freelist = object;
+			stat(s, FREE_FASTPATH);
+			continue;
+		}
+
+		if (opage == page) {
+			set_freepointer(s, object, head);
+			head = object;
+			cnt++;
+			continue;
+		}
+
+		if (cnt)
+			__slab_free_chain(s, page, head, tail, cnt, _RET_IP_);
+		cnt = 0;
+		page = NULL;
+
+		if (unlikely(SLABDEBUG && PageSlubDebug(opage))) {
+			__slab_free(s, opage, object, _RET_IP_);
+			continue;
+		}
+		page = opage;
+		head = tail = object;
+		cnt = 1;
+	}
+	if (cnt)
+		__slab_free_chain(s, page, head, tail, cnt, _RET_IP_);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/*
+ * Allocate nr objects of cache s into p in one pass, refilling the cpu slab
+ * as often as needed. Returns nr on success. On failure the objects already
+ * allocated are freed again and 0 is returned.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t gfpflags,
+			size_t nr, void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	size_t i, j;
+
+	gfpflags &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(gfpflags);
+	might_sleep_if(gfpflags & __GFP_WAIT);
+
+	if (should_failslab(s->objsize, gfpflags, s->flags))
+		return 0;
+
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	for (i = 0; i < nr; i++) {
+		void **object = c->freelist;
+
+		if (unlikely(!object)) {
+			object = __slab_alloc(s, gfpflags, -1, _RET_IP_, c);
+			if (unlikely(!object))
+				break;
+			/* __slab_alloc may have enabled interrupts */
+			c = __this_cpu_ptr(s->cpu_slab);
+		} else {
+			c->freelist = get_freepointer(s, object);
+			stat(s, ALLOC_FASTPATH);
+		}
+		p[i] = object;
+	}
+	local_irq_restore(flags);
+
+	for (j = 0; j < i; j++) {
+		if (unlikely(gfpflags & __GFP_ZERO))
+			memset(p[j], 0, s->objsize);
+
+		kmemcheck_slab_alloc(s, gfpflags, p[j], s->objsize);
+		kmemleak_alloc_recursive(p[j], s->objsize, 1, s->flags,
+					 gfpflags);
+		trace_kmem_cache_alloc(_RET_IP_, p[j], s->objsize, s->size,
+				       gfpflags);
+	}
+
+	if (unlikely(i < nr)) {
+		kmem_cache_free_bulk(s, i, p);
+		return 0;
+	}
+	return nr;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /* Figure out on which slab page the object resides */
 static struct page *get_object_page(const void *x)
 {
@@ -2055,9 +2186,11 @@ init_kmem_cache_node(struct kmem_cache_node *n, struct kmem_cache *s)
 	n->nr_partial = 0;
 	spin_lock_init(&n->list_lock);
 	INIT_LIST_HEAD(&n->partial);
-#ifdef CONFIG_SLUB_DEBUG
+#if defined(CONFIG_SLUB_DEBUG) || defined(CONFIG_SLUB_STATS)
 	atomic_long_set(&n->nr_slabs, 0);
 	atomic_long_set(&n->total_objects, 0);
+#endif
+#ifdef CONFIG_SLUB_DEBUG
 	INIT_LIST_HEAD(&n->full);
 #endif
 }
@@ -4679,3 +4812,116 @@ static int __init slab_proc_init(void)
 }
 module_init(slab_proc_init);
 #endif /* CONFIG_SLABINFO */
+
+/*
+ * /proc/slabstats: the SLUB_STATS counters and partial list state of every
+ * cache in one place, for kernels that have no slab sysfs directory.
+ */
+#if defined(CONFIG_SLUB_STATS) && defined(CONFIG_PROC_FS)
+static void print_slabstats_header(struct seq_file *m)
+{
+	seq_puts(m, "slabstats - version: 1.0\n");
+	seq_puts(m, "# name            <alloc_fast> <alloc_slow> "
+		 "<free_fast> <free_slow>");
+	seq_puts(m, " : slabs <alloc_from_partial> <alloc_slab> <free_slab>");
+	seq_puts(m, " : partial <nr_partial> <partial_free> <partial_objs>");
+	seq_putc(m, '\n');
+}
+
+static void *ss_start(struct seq_file *m, loff_t *pos)
+{
+	loff_t n = *pos;
+
+	down_read(&slub_lock);
+	if (!n)
+		print_slabstats_header(m);
+
+	return seq_list_start(&slab_caches, *pos);
+}
+
+static void *ss_next(struct seq_file *m, void *p, loff_t *pos)
+{
+	return seq_list_next(p, &slab_caches, pos);
+}
+
+static unsigned long sum_stat(struct kmem_cache *s, enum stat_item si)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		sum += per_cpu_ptr(s->cpu_slab, cpu)->stat[si];
+
+	return sum;
+}
+
+static int ss_show(struct seq_file *m, void *p)
+{
+	unsigned long nr_partials = 0;
+	unsigned long partial_free = 0;
+	unsigned long partial_objs = 0;
+	struct kmem_cache *s;
+	int node;
+
+	s = list_entry(p, struct kmem_cache, list);
+
+	for_each_online_node(node) {
+		struct kmem_cache_node *n = get_node(s, node);
+		struct page *page;
+		unsigned long flags;
+
+		if (!n)
+			continue;
+
+		spin_lock_irqsave(&n->list_lock, flags);
+		nr_partials += n->nr_partial;
+		list_for_each_entry(page, &n->partial, lru) {
+			partial_free += page->objects - page->inuse;
+			partial_objs += page->objects;
+		}
+		spin_unlock_irqrestore(&n->list_lock, flags);
+	}
+
+	seq_printf(m, "%-17s %10lu %10lu %10lu %10lu", s->name,
+		   sum_stat(s, ALLOC_FASTPATH), sum_stat(s, ALLOC_SLOWPATH),
+		   sum_stat(s, FREE_FASTPATH), sum_stat(s, FREE_SLOWPATH));
+	seq_printf(m, " : slabs %8lu %8lu %8lu",
+		   sum_stat(s, ALLOC_FROM_PARTIAL), sum_stat(s, ALLOC_SLAB),
+		   sum_stat(s, FREE_SLAB));
+	seq_printf(m, " : partial %6lu %8lu %8lu", nr_partials,
+		   partial_free, partial_objs);
+	seq_putc(m, '\n');
+	return 0;
+}
+
+static void ss_stop(struct seq_file *m, void *p)
+{
+	up_read(&slub_lock);
+}
+
+static const struct seq_operations slabstats_op = {
+	.start = ss_start,
+	.next = ss_next,
+	.stop = ss_stop,
+	.show = ss_show,
+};
+
+static int slabstats_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &slabstats_op);
+}
+
+static const struct file_operations proc_slabstats_operations = {
+	.open		= slabstats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init slab_stats_proc_init(void)
+{
+	proc_create("slabstats", S_IRUGO, NULL, &proc_slabstats_operations);
+	return 0;
+}
+module_init(slab_stats_proc_init);
+#endif /* CONFIG_SLUB_STATS && CONFIG_PROC_FS */
@@ -37,9 +37,65 @@
 /* How many pages do we try to swap or page in/out together? */
 int page_cluster;
 
-static DEFINE_PER_CPU(struct pagevec[NR_LRU_LISTS], lru_add_pvecs);
+/*
+ * Pages are added to the LRU lists, and activated on them, in per-cpu
+ * batches so that zone->lru_lock is taken once per batch rather than once
+ * per page.  A batch starts out at PAGEVEC_SIZE pages and doubles, up to
+ * LRU_BATCH_MAX, whenever its drain has to wait for lru_lock.  It shrinks
+ * back a page at a time while drains go uncontended, so pages are only
+ * kept off the LRU for as long as the contention warrants.
+ */
+#define LRU_BATCH_MAX	64
+
+struct lru_batch {
+	unsigned int nr;
+	unsigned int limit;		/* 0 means PAGEVEC_SIZE */
+	struct page *pages[LRU_BATCH_MAX];
+};
+
+static DEFINE_PER_CPU(struct lru_batch[NR_LRU_LISTS], lru_add_batches);
+static DEFINE_PER_CPU(struct lru_batch, lru_activate_batch);
 static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);
 
+static inline unsigned int lru_batch_limit(struct lru_batch *batch)
+{
+	return batch->limit ? batch->limit : PAGEVEC_SIZE;
+}
+
+/* Returns true if the batch is now full and must be drained */
+static inline bool lru_batch_add(struct lru_batch *batch, struct page *page)
+{
+	batch->pages[batch->nr++] = page;
+	return batch->nr >= lru_batch_limit(batch);
+}
+
+/* Take lru_lock with interrupts off; returns 1 if we had to wait for it */
+static int lru_lock_irq(struct zone *zone)
+{
+	if (spin_trylock_irq(&zone->lru_lock))
+		return 0;
+	spin_lock_irq(&zone->lru_lock);
+	return 1;
+}
+
+/* Finish a drain of @batch: release its pages and resize it */
+static void lru_batch_done(struct lru_batch *batch, int contended)
+{
+	unsigned int limit = lru_batch_limit(batch);
+
+	count_vm_event(LRU_BATCH_DRAIN);
+	count_vm_events(LRU_BATCH_PAGES, batch->nr);
+	if (contended) {
+		count_vm_event(LRU_BATCH_CONTENDED);
+		limit = min(limit * 2, (unsigned int)LRU_BATCH_MAX);
+	} else if (limit > PAGEVEC_SIZE)
+		limit--;
+	batch->limit = limit;
+
+	release_pages(batch->pages, batch->nr, 0);
+	batch->nr = 0;
+}
+
 /*
  * This path almost never happens for VM activity - pages are normally
  * freed via pagevecs.  But it gets used by networking.
@@ -172,14 +228,9 @@ static void update_page_reclaim_stat(struct zone *zone, struct page *page,
 		memcg_reclaim_stat->recent_rotated[file]++;
 }
 
-/*
- * FIXME: speed this up?
- */
-void activate_page(struct page *page)
+/* Must be called with zone->lru_lock held */
+static void __activate_page(struct zone *zone, struct page *page)
 {
-	struct zone *zone = page_zone(page);
-
-	spin_lock_irq(&zone->lru_lock);
 	if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
 		int file = page_is_file_cache(page);
 		int lru = page_lru_base_type(page);
@@ -192,7 +243,46 @@ void activate_page(struct page *page)
 
 		update_page_reclaim_stat(zone, page, file, 1);
 	}
-	spin_unlock_irq(&zone->lru_lock);
+}
+
+static void lru_activate_batch_drain(struct lru_batch *batch)
+{
+	struct zone *zone = NULL;
+	int contended = 0;
+	int i;
+
+	for (i = 0; i < batch->nr; i++) {
+		struct page *page = batch->pages[i];
+		struct zone *pagezone = page_zone(page);
+
+		if (pagezone != zone) {
+			if (zone)
+				spin_unlock_irq(&zone->lru_lock);
+			zone = pagezone;
+			contended |= lru_lock_irq(zone);
+		}
+		__activate_page(zone, page);
+	}
+	if (zone)
+		spin_unlock_irq(&zone->lru_lock);
+	lru_batch_done(batch, contended);
+}
+
+/*
+ * Activation is deferred to a per-cpu batch: the page is moved to the
+ * active list when the batch is drained, if it is still on the inactive
+ * list then.
+ */
+void activate_page(struct page *page)
+{
+	if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
+		struct lru_batch *batch = &get_cpu_var(lru_activate_batch);
+
+		page_cache_get(page);
+		if (lru_batch_add(batch, page))
+			lru_activate_batch_drain(batch);
+		put_cpu_var(lru_activate_batch);
+	}
 }
 
 /*
@@ -215,14 +305,21 @@ void mark_page_accessed(struct page *page)
 
 EXPORT_SYMBOL(mark_page_accessed);
 
+static int __lru_add_pages(struct page **pages, int nr, enum lru_list lru);
+
+static void lru_add_batch_drain(struct lru_batch *batch, enum lru_list lru)
+{
+	lru_batch_done(batch, __lru_add_pages(batch->pages, batch->nr, lru));
+}
+
 void __lru_cache_add(struct page *page, enum lru_list lru)
 {
-	struct pagevec *pvec = &get_cpu_var(lru_add_pvecs)[lru];
+	struct lru_batch *batch = &get_cpu_var(lru_add_batches)[lru];
 
 	page_cache_get(page);
-	if (!pagevec_add(pvec, page))
-		____pagevec_lru_add(pvec, lru);
-	put_cpu_var(lru_add_pvecs);
+	if (lru_batch_add(batch, page))
+		lru_add_batch_drain(batch, lru);
+	put_cpu_var(lru_add_batches);
 }
 EXPORT_SYMBOL(__lru_cache_add);
 
@@ -273,16 +370,21 @@ void add_page_to_unevictable_list(struct page *page)
  */
 static void drain_cpu_pagevecs(int cpu)
 {
-	struct pagevec *pvecs = per_cpu(lru_add_pvecs, cpu);
+	struct lru_batch *batches = per_cpu(lru_add_batches, cpu);
+	struct lru_batch *batch;
 	struct pagevec *pvec;
 	int lru;
 
 	for_each_lru(lru) {
-		pvec = &pvecs[lru - LRU_BASE];
-		if (pagevec_count(pvec))
-			____pagevec_lru_add(pvec, lru);
+		batch = &batches[lru - LRU_BASE];
+		if (batch->nr)
+			lru_add_batch_drain(batch, lru);
 	}
 
+	batch = &per_cpu(lru_activate_batch, cpu);
+	if (batch->nr)
+		lru_activate_batch_drain(batch);
+
 	pvec = &per_cpu(lru_rotate_pvecs, cpu);
 	if (pagevec_count(pvec)) {
 		unsigned long flags;
@@ -399,18 +501,19 @@ void __pagevec_release(struct pagevec *pvec)
 EXPORT_SYMBOL(__pagevec_release);
 
 /*
- * Add the passed pages to the LRU, then drop the caller's refcount
- * on them.  Reinitialises the caller's pagevec.
+ * Add the passed pages to the LRU, leaving the caller's refcount on them.
+ * Returns 1 if lru_lock was contended.
  */
-void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru)
+static int __lru_add_pages(struct page **pages, int nr, enum lru_list lru)
 {
 	int i;
 	struct zone *zone = NULL;
+	int contended = 0;
 
 	VM_BUG_ON(is_unevictable_lru(lru));
 
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
 		struct zone *pagezone = page_zone(page);
 		int file;
 		int active;
@@ -419,7 +522,7 @@ void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru)
 			if (zone)
 				spin_unlock_irq(&zone->lru_lock);
 			zone = pagezone;
-			spin_lock_irq(&zone->lru_lock);
+			contended |= lru_lock_irq(zone);
 		}
 		VM_BUG_ON(PageActive(page));
 		VM_BUG_ON(PageUnevictable(page));
@@ -434,6 +537,16 @@ void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru)
 	}
 	if (zone)
 		spin_unlock_irq(&zone->lru_lock);
+	return contended;
+}
+
+/*
+ * Add the passed pages to the LRU, then drop the caller's refcount
+ * on them.  Reinitialises the caller's pagevec.
+ */
+void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru)
+{
+	__lru_add_pages(pvec->pages, pagevec_count(pvec), lru);
 	release_pages(pvec->pages, pvec->nr, pvec->cold);
 	pagevec_reinit(pvec);
 }
@@ -16,6 +16,7 @@
 #include <linux/pagemap.h>
 #include <linux/highmem.h>
 #include <linux/pagevec.h>
+#include <linux/ccache.h>
 #include <linux/task_io_accounting_ops.h>
 #include <linux/buffer_head.h>	/* grr. try_to_release_page,
 				   do_invalidatepage */
@@ -216,7 +217,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	int i;
 
 	if (mapping->nrpages == 0)
-		return;
+		goto out;
 
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
 	end = (lend >> PAGE_CACHE_SHIFT);
@@ -290,6 +291,10 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		pagevec_release(&pvec);
 		mem_cgroup_uncharge_end();
 	}
+out:
+	/* Includes any partial page: its copy still has the old tail */
+	ccache_invalidate_range(mapping, lstart >> PAGE_CACHE_SHIFT,
+				lend >> PAGE_CACHE_SHIFT);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
 
@@ -361,6 +366,7 @@ unsigned long invalidate_mapping_pages(struct address_space *mapping,
 		mem_cgroup_uncharge_end();
 		cond_resched();
 	}
+	ccache_invalidate_range(mapping, start, end);
 	return ret;
 }
 EXPORT_SYMBOL(invalidate_mapping_pages);
@@ -486,6 +492,7 @@ int invalidate_inode_pages2_range(struct address_space *mapping,
 		mem_cgroup_uncharge_end();
 		cond_resched();
 	}
+	ccache_invalidate_range(mapping, start, end);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(invalidate_inode_pages2_range);
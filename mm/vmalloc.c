@@ -266,6 +266,17 @@ static struct rb_root vmap_area_root = RB_ROOT;
 static LIST_HEAD(vmap_area_list);
 static unsigned long vmap_area_pcpu_hole;
 
+/*
+ * Where the last allocation was made, so that the next search can start
+ * from there instead of from vstart.  cached_hole_size is the largest
+ * hole seen below free_vmap_cache: a request that fits in it searches
+ * from vstart again.  All protected by vmap_area_lock.
+ */
+static struct rb_node *free_vmap_cache;
+static unsigned long cached_hole_size;
+static unsigned long cached_vstart;
+static unsigned long cached_align;
+
 static struct vmap_area *__find_vmap_area(unsigned long addr)
 {
 	struct rb_node *n = vmap_area_root.rb_node;
@@ -329,6 +340,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				int node, gfp_t gfp_mask)
 {
 	struct vmap_area *va;
+	struct vmap_area *first;
 	struct rb_node *n;
 	unsigned long addr;
 	int purged = 0;
@@ -342,56 +354,73 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 		return ERR_PTR(-ENOMEM);
 
 retry:
-	addr = ALIGN(vstart, align);
-
 	spin_lock(&vmap_area_lock);
-	if (addr + size - 1 < addr)
-		goto overflow;
-
-	/* XXX: could have a last_hole cache */
-	n = vmap_area_root.rb_node;
-	if (n) {
-		struct vmap_area *first = NULL;
-
-		do {
+	/*
+	 * Drop the cache if this request is more permissive than the one
+	 * which set it up, or fits into a hole left below it.
+	 */
+	if (!free_vmap_cache ||
+			size < cached_hole_size ||
+			vstart < cached_vstart ||
+			align < cached_align) {
+nocache:
+		cached_hole_size = 0;
+		free_vmap_cache = NULL;
+	}
+	cached_vstart = vstart;
+	cached_align = align;
+
+	if (free_vmap_cache) {
+		first = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
+		addr = ALIGN(first->va_end + PAGE_SIZE, align);
+		if (addr < vstart)
+			goto nocache;
+		if (addr + size - 1 < addr)
+			goto overflow;
+	} else {
+		addr = ALIGN(vstart, align);
+		if (addr + size - 1 < addr)
+			goto overflow;
+
+		/* find the lowest area ending at or above addr */
+		n = vmap_area_root.rb_node;
+		first = NULL;
+		while (n) {
 			struct vmap_area *tmp;
 			tmp = rb_entry(n, struct vmap_area, rb_node);
 			if (tmp->va_end >= addr) {
-				if (!first && tmp->va_start < addr + size)
-					first = tmp;
-				n = n->rb_left;
-			} else {
 				first = tmp;
+				if (tmp->va_start <= addr)
+					break;
+				n = n->rb_left;
+			} else
 				n = n->rb_right;
-			}
-		} while (n);
+		}
 
 		if (!first)
 			goto found;
+	}
 
-		if (first->va_end < addr) {
-			n = rb_next(&first->rb_node);
-			if (n)
-				first = rb_entry(n, struct vmap_area, rb_node);
-			else
-				goto found;
-		}
-
-		while (addr + size > first->va_start && addr + size <= vend) {
-			addr = ALIGN(first->va_end + PAGE_SIZE, align);
-			if (addr + size - 1 < addr)
-				goto overflow;
-
-			n = rb_next(&first->rb_node);
-			if (n)
-				first = rb_entry(n, struct vmap_area, rb_node);
-			else
-				goto found;
-		}
+	/* walk up from there until a big enough hole turns up */
+	while (addr + size > first->va_start && addr + size <= vend) {
+		if (addr + cached_hole_size < first->va_start)
+			cached_hole_size = first->va_start - addr;
+		addr = ALIGN(first->va_end + PAGE_SIZE, align);
+		if (addr + size - 1 < addr)
+			goto overflow;
+
+		n = rb_next(&first->rb_node);
+		if (n)
+			first = rb_entry(n, struct vmap_area, rb_node);
+		else
+			goto found;
 	}
 found:
 	if (addr + size > vend) {
 overflow:
+		/* there may yet be room below where the cache started us */
+		if (free_vmap_cache)
+			goto nocache;
 		spin_unlock(&vmap_area_lock);
 		if (!purged) {
 			purge_vmap_area_lazy();
@@ -412,6 +441,7 @@ overflow:
 	va->va_end = addr + size;
 	va->flags = 0;
 	__insert_vmap_area(va);
+	free_vmap_cache = &va->rb_node;
 	spin_unlock(&vmap_area_lock);
 
 	return va;
@@ -427,6 +457,19 @@ static void rcu_free_va(struct rcu_head *head)
 static void __free_vmap_area(struct vmap_area *va)
 {
 	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
+
+	if (free_vmap_cache) {
+		if (va->va_end < cached_vstart) {
+			free_vmap_cache = NULL;
+		} else {
+			struct vmap_area *cache;
+			cache = rb_entry(free_vmap_cache, struct vmap_area,
+					 rb_node);
+			/* cached_hole_size is left stale: it only costs a search */
+			if (va->va_start <= cache->va_start)
+				free_vmap_cache = rb_prev(&va->rb_node);
+		}
+	}
 	rb_erase(&va->rb_node, &vmap_area_root);
 	RB_CLEAR_NODE(&va->rb_node);
 	list_del_rcu(&va->list);
@@ -501,14 +544,45 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
+	unsigned long pages;
 
 	log = fls(num_online_cpus());
-
-	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
+	pages = log * (32UL * 1024 * 1024 / PAGE_SIZE);
+#ifdef CONFIG_VMAP_PERCPU
+	/*
+	 * With vmap() going through the per-cpu blocks, most of what gets
+	 * lazily freed is whole blocks: let half the vmalloc area build up
+	 * before flushing.  Running out of space purges early regardless.
+	 */
+	pages = max(pages, (VMALLOC_END - VMALLOC_START) / 2 / PAGE_SIZE);
+#endif
+	return pages;
 }
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
+#ifdef CONFIG_VMAP_PERCPU
+/*
+ * A purge spans lazily freed areas scattered over the vmalloc space, and
+ * an architecture may well flush such a range page by page (ARM does):
+ * beyond this many pages, flushing the whole TLB is cheaper.
+ */
+#define VMAP_FLUSH_ALL_PAGES	512
+
+static void vmap_flush_tlb_range(unsigned long start, unsigned long end)
+{
+	if ((end - start) >> PAGE_SHIFT > VMAP_FLUSH_ALL_PAGES)
+		flush_tlb_all();
+	else
+		flush_tlb_kernel_range(start, end);
+}
+#else
+static void vmap_flush_tlb_range(unsigned long start, unsigned long end)
+{
+	flush_tlb_kernel_range(start, end);
+}
+#endif
+
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
 
@@ -565,7 +639,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 		atomic_sub(nr, &vmap_lazy_nr);
 
 	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+		vmap_flush_tlb_range(*start, *end);
 
 	if (nr) {
 		spin_lock(&vmap_area_lock);
@@ -682,6 +756,10 @@ struct vmap_block {
 	unsigned long free, dirty;
 	DECLARE_BITMAP(alloc_map, VMAP_BBMAP_BITS);
 	DECLARE_BITMAP(dirty_map, VMAP_BBMAP_BITS);
+#ifdef CONFIG_VMAP_PERCPU
+	/* order of each allocation, by first page, for vunmap() */
+	unsigned char order[VMAP_BBMAP_BITS];
+#endif
 	struct list_head free_list;
 	struct rcu_head rcu_head;
 	struct list_head purge;
@@ -873,6 +951,9 @@ again:
 		addr = vb->va->va_start + (i << PAGE_SHIFT);
 		BUG_ON(addr_to_vb_idx(addr) !=
 				addr_to_vb_idx(vb->va->va_start));
+#ifdef CONFIG_VMAP_PERCPU
+		vb->order[i] = order;
+#endif
 		vb->free -= 1UL << order;
 		if (vb->free == 0) {
 			spin_lock(&vbq->lock);
@@ -935,6 +1016,32 @@ static void vb_free(const void *addr, unsigned long size)
 		spin_unlock(&vb->lock);
 }
 
+#ifdef CONFIG_VMAP_PERCPU
+/*
+ * Unmap addr if vmap() took it from a per-cpu block.  Blocks are aligned
+ * to their size, so any address inside one belongs to one of its
+ * allocations, and the allocation cannot be freed while we look.
+ */
+static int vb_vunmap(const void *addr)
+{
+	unsigned long offset;
+	struct vmap_block *vb;
+	unsigned int order;
+
+	rcu_read_lock();
+	vb = radix_tree_lookup(&vmap_block_tree,
+			       addr_to_vb_idx((unsigned long)addr));
+	rcu_read_unlock();
+	if (!vb)
+		return 0;
+
+	offset = (unsigned long)addr & (VMAP_BLOCK_SIZE - 1);
+	order = vb->order[offset >> PAGE_SHIFT];
+	vm_unmap_ram(addr, 1U << order);
+	return 1;
+}
+#endif
+
 /**
  * vm_unmap_aliases - unmap outstanding lazy aliases in the vmap layer
  *
@@ -1425,6 +1532,10 @@ void vunmap(const void *addr)
 {
 	BUG_ON(in_interrupt());
 	might_sleep();
+#ifdef CONFIG_VMAP_PERCPU
+	if (addr && vb_vunmap(addr))
+		return;
+#endif
 	__vunmap(addr, 0);
 }
 EXPORT_SYMBOL(vunmap);
@@ -1449,6 +1560,11 @@ void *vmap(struct page **pages, unsigned int count,
 	if (count > totalram_pages)
 		return NULL;
 
+#ifdef CONFIG_VMAP_PERCPU
+	if (flags == VM_MAP && count && count <= VMAP_MAX_ALLOC)
+		return vm_map_ram(pages, count, -1, prot);
+#endif
+
 	area = get_vm_area_caller((count << PAGE_SHIFT), flags,
 					__builtin_return_address(0));
 	if (!area)
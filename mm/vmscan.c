@@ -40,6 +40,7 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/ccache.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -127,6 +128,12 @@ struct scan_control {
 int vm_swappiness = 60;
 long vm_total_pages;	/* The total number of pages which the VM controls */
 
+/*
+ * How many milliseconds of the recent allocation rate kswapd should keep
+ * free on top of the normal low and high watermarks. 0 disables.
+ */
+int watermark_headroom_ms;
+
 static LIST_HEAD(shrinker_list);
 static DECLARE_RWSEM(shrinker_rwsem);
 
@@ -637,6 +644,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		struct address_space *mapping;
 		struct page *page;
 		int may_enter_fs;
+		int cached;
 
 		cond_resched();
 
@@ -649,6 +657,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		VM_BUG_ON(PageActive(page));
 
 		sc->nr_scanned++;
+		mem_cgroup_note_reclaim(page, false);
 
 		if (unlikely(!page_evictable(page, NULL)))
 			goto cull_mlocked;
@@ -793,8 +802,26 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping)
+			goto keep_locked;
+
+		/*
+		 * Counted before __remove_mapping() uncharges the page: the
+		 * rare failure there is not worth correcting the count for.
+		 */
+		mem_cgroup_note_reclaim(page, true);
+
+		/*
+		 * Keep a compressed copy of a clean file page while we still
+		 * hold its lock, and drop it again if the page stays put.
+		 */
+		cached = ccache_put_page(page);
+		if (!__remove_mapping(mapping, page)) {
+			if (cached)
+				ccache_invalidate_range(mapping, page->index,
+							page->index);
 			goto keep_locked;
+		}
 
 		/*
 		 * At this point, we have no other references and there is
@@ -2251,6 +2278,47 @@ out:
 	return sc.nr_reclaimed;
 }
 
+/*
+ * Sample how fast each zone of pgdat has been allocated from since the
+ * last time kswapd woke, and raise or lower the zone's watermarks so that
+ * kswapd wakes early enough, and frees far enough ahead, to absorb
+ * watermark_headroom_ms of allocations at that rate. The boost is capped
+ * at 1/16th of the zone.
+ */
+static void kswapd_update_headroom(pg_data_t *pgdat)
+{
+	unsigned long now = jiffies;
+	int i;
+
+	for (i = 0; i < pgdat->nr_zones; i++) {
+		struct zone *zone = pgdat->node_zones + i;
+		unsigned long events, elapsed, rate, boost = 0;
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (watermark_headroom_ms) {
+			events = sum_vm_event(PGALLOC_NORMAL - ZONE_NORMAL + i);
+			elapsed = now - zone->alloc_stamp;
+			if (elapsed < HZ / 10)
+				continue;
+
+			rate = div_u64((u64)(events - zone->alloc_events) * HZ,
+				       elapsed);
+			zone->alloc_events = events;
+			zone->alloc_stamp = now;
+			zone->alloc_rate = (zone->alloc_rate + rate) / 2;
+
+			boost = div_u64((u64)zone->alloc_rate *
+					watermark_headroom_ms, MSEC_PER_SEC);
+			boost = min(boost, zone->present_pages / 16);
+		}
+
+		if (boost != zone->watermark_boost)
+			set_zone_watermark_boost(zone, boost);
+	}
+}
+
 /*
  * The background pageout daemon, started as a kernel thread
  * from the init process.
@@ -2348,8 +2416,10 @@ static int kswapd(void *p)
 		 * We can speed up thawing tasks if we don't call balance_pgdat
 		 * after returning from the refrigerator
 		 */
-		if (!ret)
+		if (!ret) {
+			kswapd_update_headroom(pgdat);
 			balance_pgdat(pgdat, order);
+		}
 	}
 	return 0;
 }
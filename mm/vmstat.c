@@ -17,6 +17,7 @@
 #include <linux/vmstat.h>
 #include <linux/sched.h>
 #include <linux/math64.h>
+#include <linux/compaction.h>
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 DEFINE_PER_CPU(struct vm_event_state, vm_event_states) = {{0}};
@@ -50,6 +51,21 @@ void all_vm_events(unsigned long *ret)
 }
 EXPORT_SYMBOL_GPL(all_vm_events);
 
+/*
+ * Accumulate a single vm event counter across all online CPUs.
+ */
+unsigned long sum_vm_event(enum vm_event_item item)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		sum += per_cpu(vm_event_states, cpu).event[item];
+	put_online_cpus();
+	return sum;
+}
+
 #ifdef CONFIG_HOTPLUG
 /*
  * Fold the foreign cpu events into our own.
@@ -344,7 +360,7 @@ void refresh_cpu_vm_stats(int cpu)
 		 * Check if there are pages remaining in this pageset
 		 * if not then there is nothing to expire.
 		 */
-		if (!p->expire || !p->pcp.count)
+		if (!p->expire || !(p->pcp.count || p->pcp.high_count))
 			continue;
 
 		/*
@@ -359,7 +375,7 @@ void refresh_cpu_vm_stats(int cpu)
 		if (p->expire)
 			continue;
 
-		if (p->pcp.count)
+		if (p->pcp.count || p->pcp.high_count)
 			drain_zone_pages(zone, &p->pcp);
 #endif
 	}
@@ -745,6 +761,8 @@ static const char * const vmstat_text[] = {
 	"nr_isolated_anon",
 	"nr_isolated_file",
 	"nr_shmem",
+	"direct_stall",
+	"direct_stall_ms",
 #ifdef CONFIG_NUMA
 	"numa_hit",
 	"numa_miss",
@@ -786,8 +804,18 @@ static const char * const vmstat_text[] = {
 	"kswapd_skip_congestion_wait",
 	"pageoutrun",
 	"allocstall",
+	"allocstall_lt_1ms",
+	"allocstall_lt_4ms",
+	"allocstall_lt_16ms",
+	"allocstall_lt_64ms",
+	"allocstall_lt_256ms",
+	"allocstall_lt_1024ms",
+	"allocstall_ge_1024ms",
 
 	"pgrotated",
+	"lru_batch_drain",
+	"lru_batch_pages",
+	"lru_batch_contended",
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
@@ -796,6 +824,11 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_stall_usecs",
+	"compact_daemon_wake",
+	"compact_daemon_pages_moved",
+	"compact_daemon_success",
+	"compact_daemon_usecs",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -854,11 +887,13 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   "\n    cpu: %i"
 			   "\n              count: %i"
 			   "\n              high:  %i"
-			   "\n              batch: %i",
+			   "\n              batch: %i"
+			   "\n              high order count: %i",
 			   i,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
-			   pageset->pcp.batch);
+			   pageset->pcp.batch,
+			   pageset->pcp.high_count);
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
@@ -873,6 +908,14 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 		   zone->prev_priority,
 		   zone->zone_start_pfn,
 		   zone->inactive_ratio);
+#ifdef CONFIG_COMPACTION
+	if (sysctl_compact_proactive_order)
+		seq_printf(m,
+			   "\n  extfrag_index:     %d (order %d)",
+			   fragmentation_index(zone,
+					sysctl_compact_proactive_order),
+			   sysctl_compact_proactive_order);
+#endif
 	seq_putc(m, '\n');
 }
 
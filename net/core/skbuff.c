@@ -430,6 +430,42 @@ void __kfree_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(__kfree_skb);
 
+#define SKB_FREE_BULK	16
+
+/**
+ *	__kfree_skb_list - free a list of sk_buffs
+ *	@skb: first buffer of a NULL terminated ->next list
+ *
+ *	Like __kfree_skb() on every buffer of the list, which must no longer
+ *	be referenced. Heads of buffers that are not fast clones are handed
+ *	back to the slab allocator in bulk.
+ */
+void __kfree_skb_list(struct sk_buff *skb)
+{
+	void *heads[SKB_FREE_BULK];
+	int nr = 0;
+
+	while (skb) {
+		struct sk_buff *next = skb->next;
+
+		WARN_ON(atomic_read(&skb->users));
+		skb_release_all(skb);
+		if (skb->fclone == SKB_FCLONE_UNAVAILABLE) {
+			heads[nr++] = skb;
+			if (nr == SKB_FREE_BULK) {
+				kmem_cache_free_bulk(skbuff_head_cache, nr,
+						     heads);
+				nr = 0;
+			}
+		} else
+			kfree_skbmem(skb);
+		skb = next;
+	}
+	if (nr)
+		kmem_cache_free_bulk(skbuff_head_cache, nr, heads);
+}
+EXPORT_SYMBOL(__kfree_skb_list);
+
 /**
  *	kfree_skb - free an sk_buff
  *	@skb: buffer to free